@@ -0,0 +1,578 @@
+// воспроизводимые замеры производительности поискового сервера
+// корпус и запросы строятся генератором с заданной затравкой: слова документов распределены по закону Ципфа,
+// длины документов -- логарифмически равномерно между --min-document-words и --max-document-words, каждое слово
+// запроса с вероятностью --minus-rate становится минус-словом; при одинаковых параметрах и стандартной
+// библиотеке корпус одинаков от запуска к запуску
+// каждый замер выполняется --warmup раз без записи и --repetitions раз с записью; результат -- JSON
+// (по замеру на строку), который можно сравнить с сохраненным результатом прошлого запуска (--baseline):
+// замеры, медиана которых выросла больше чем на --threshold процентов, отмечаются как регрессии,
+// и программа завершается с кодом 2
+// с --disk-index FILE вместо замеров сервера в памяти индекс записывается в FILE и замеряется поиск с диска
+// (DiskSearchServer) с кэшем блоков --cache-mb МБ: с пустыми кэшами, включая страничный кэш ядра, и с прогретым;
+// --memory-limit-mb ограничивает адресное пространство процесса (setrlimit) сверх занятого к началу поиска,
+// а к замерам добавляются доля попаданий в кэш, число прочитанных блоков на запрос и память поиска
+#include "disk_index.h"
+#include "process_queries.h"
+#include "query_trace.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <execution>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    uint64_t seed = 42;
+    size_t documents = 20'000;
+    size_t dictionary = 20'000;
+    double zipf_exponent = 1.0;
+    size_t min_document_words = 5;
+    size_t max_document_words = 200;
+    size_t queries = 2'000;
+    size_t max_query_words = 6;
+    double minus_rate = 0.1;
+    // самые частые слова словаря становятся стоп-словами
+    size_t stop_words = 20;
+    size_t warmup = 1;
+    size_t repetitions = 3;
+    double threshold = 10.0;
+    string output_path;
+    string baseline_path;
+    string disk_index_path;
+    size_t cache_mb = 16;
+    size_t prefetch_blocks = 4;
+    size_t memory_limit_mb = 0;
+};
+
+// генератор корпуса: собственные преобразования случайных битов вместо стандартных распределений,
+// результат которых зависит от реализации библиотеки, -- корпус зависит только от затравки
+class CorpusGenerator {
+public:
+    CorpusGenerator(const Options& options)
+        : generator_(options.seed)
+        , options_(options)
+    {
+        set<string> words;
+        while (words.size() < options.dictionary) {
+            string word;
+            const size_t length = 2 + GetIndex(9);
+            for (size_t i = 0; i < length; ++i) {
+                word.push_back(static_cast<char>('a' + GetIndex(26)));
+            }
+            words.insert(move(word));
+        }
+        // ранг слова в законе Ципфа не зависит от его написания
+        dictionary_.assign(words.begin(), words.end());
+        for (size_t i = dictionary_.size(); i > 1; --i) {
+            swap(dictionary_[i - 1], dictionary_[GetIndex(i)]);
+        }
+        double sum = 0.0;
+        for (size_t rank = 1; rank <= dictionary_.size(); ++rank) {
+            sum += 1.0 / pow(static_cast<double>(rank), options.zipf_exponent);
+            cumulative_weights_.push_back(sum);
+        }
+    }
+
+    string GetStopWords() const {
+        string text;
+        for (size_t i = 0; i < min(options_.stop_words, dictionary_.size()); ++i) {
+            text += dictionary_[i] + ' ';
+        }
+        return text;
+    }
+
+    string GenerateDocument() {
+        const double log_min = log(static_cast<double>(options_.min_document_words));
+        const double log_max = log(static_cast<double>(options_.max_document_words));
+        const size_t word_count = static_cast<size_t>(exp(log_min + (log_max - log_min) * GetUnit()));
+        string text;
+        for (size_t i = 0; i < max<size_t>(word_count, 1); ++i) {
+            if (!text.empty()) {
+                text.push_back(' ');
+            }
+            text += GetZipfWord();
+        }
+        return text;
+    }
+
+    string GenerateQuery() {
+        const size_t word_count = 1 + GetIndex(options_.max_query_words);
+        string text;
+        for (size_t i = 0; i < word_count; ++i) {
+            if (!text.empty()) {
+                text.push_back(' ');
+            }
+            if (GetUnit() < options_.minus_rate) {
+                text.push_back('-');
+            }
+            text += GetZipfWord();
+        }
+        return text;
+    }
+
+    size_t GetIndex(size_t size) {
+        return static_cast<size_t>(GetUnit() * size);
+    }
+
+private:
+    // равномерно в [0, 1) по старшим 53 битам
+    double GetUnit() {
+        return static_cast<double>(generator_() >> 11) * 0x1.0p-53;
+    }
+
+    const string& GetZipfWord() {
+        const double value = GetUnit() * cumulative_weights_.back();
+        const size_t rank = upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), value) - cumulative_weights_.begin();
+        return dictionary_[min(rank, dictionary_.size() - 1)];
+    }
+
+    mt19937_64 generator_;
+    const Options& options_;
+    vector<string> dictionary_;
+    vector<double> cumulative_weights_;
+};
+
+struct BenchmarkResult {
+    string name;
+    // длительности замеренных операций, нс; операция замера может охватывать несколько элементов
+    vector<uint64_t> samples;
+    // обработанные элементы (документы, запросы) за все повторы
+    size_t items = 0;
+    uint64_t total_duration = 0;
+    // дополнительные показатели замера, выводятся после длительностей
+    vector<pair<string, double>> counters;
+
+    void Record(Clock::duration duration, size_t item_count) {
+        const uint64_t value = chrono::duration_cast<chrono::nanoseconds>(duration).count();
+        samples.push_back(value);
+        total_duration += value;
+        items += item_count;
+    }
+};
+
+uint64_t Percentile(const vector<uint64_t>& sorted_values, double percentile) {
+    if (sorted_values.empty()) {
+        return 0;
+    }
+    const size_t index = min(sorted_values.size() - 1, static_cast<size_t>(percentile / 100.0 * sorted_values.size()));
+    return sorted_values[index];
+}
+
+// замер: run(record) выполняет один повтор и передает каждую операцию в record; первые warmup повторов не записываются
+void RunBenchmark(vector<BenchmarkResult>& results, const Options& options, const string& name,
+                  const function<void(const function<void(Clock::duration, size_t)>&)>& run) {
+    BenchmarkResult result;
+    result.name = name;
+    for (size_t i = 0; i < options.warmup; ++i) {
+        run([](Clock::duration, size_t) {});
+    }
+    for (size_t i = 0; i < options.repetitions; ++i) {
+        run([&result](Clock::duration duration, size_t item_count) {
+            result.Record(duration, item_count);
+        });
+    }
+    cerr << name << ": "s << result.samples.size() << " samples"s << endl;
+    results.push_back(move(result));
+}
+
+template <typename Function>
+Clock::duration MeasureDuration(Function function) {
+    const auto start = Clock::now();
+    function();
+    return Clock::now() - start;
+}
+
+// строка JSON с результатом замера; длительности в микросекундах
+string FormatResult(const BenchmarkResult& result) {
+    vector<uint64_t> samples = result.samples;
+    sort(samples.begin(), samples.end());
+    const auto to_us = [](uint64_t value) {
+        return value / 1000.0;
+    };
+    ostringstream out;
+    out << fixed << setprecision(3);
+    out << "{\"name\": \""s << result.name << "\", \"samples\": "s << samples.size() << ", \"items\": "s << result.items
+        << ", \"mean_us\": "s << (samples.empty() ? 0.0 : to_us(result.total_duration) / samples.size())
+        << ", \"p50_us\": "s << to_us(Percentile(samples, 50)) << ", \"p90_us\": "s << to_us(Percentile(samples, 90))
+        << ", \"p99_us\": "s << to_us(Percentile(samples, 99)) << ", \"max_us\": "s << to_us(samples.empty() ? 0 : samples.back())
+        << ", \"throughput_per_s\": "s << (result.total_duration == 0 ? 0.0 : result.items * 1e9 / result.total_duration);
+    for (const auto& [name, value] : result.counters) {
+        out << ", \""s << name << "\": "s << value;
+    }
+    out << "}"s;
+    return out.str();
+}
+
+string FormatConfig(const Options& options) {
+    ostringstream out;
+    out << "{\"seed\": "s << options.seed << ", \"documents\": "s << options.documents << ", \"dictionary\": "s << options.dictionary
+        << ", \"zipf_exponent\": "s << options.zipf_exponent << ", \"min_document_words\": "s << options.min_document_words
+        << ", \"max_document_words\": "s << options.max_document_words << ", \"queries\": "s << options.queries
+        << ", \"max_query_words\": "s << options.max_query_words << ", \"minus_rate\": "s << options.minus_rate
+        << ", \"stop_words\": "s << options.stop_words << ", \"warmup\": "s << options.warmup
+        << ", \"repetitions\": "s << options.repetitions << ", \"tracing\": "s << (TRACING_ENABLED ? "true"s : "false"s);
+    if (!options.disk_index_path.empty()) {
+        out << ", \"cache_mb\": "s << options.cache_mb << ", \"prefetch_blocks\": "s << options.prefetch_blocks
+            << ", \"memory_limit_mb\": "s << options.memory_limit_mb;
+    }
+    out << "}"s;
+    return out.str();
+}
+
+void WriteJson(ostream& out, const Options& options, const vector<BenchmarkResult>& results) {
+    out << "{\n\"config\": "s << FormatConfig(options) << ",\n\"benchmarks\": [\n"s;
+    for (size_t i = 0; i < results.size(); ++i) {
+        out << FormatResult(results[i]) << (i + 1 < results.size() ? ",\n"s : "\n"s);
+    }
+    out << "]\n}\n"s;
+}
+
+// значение поля key из строки JSON, записанной WriteJson
+string ExtractField(const string& line, const string& key) {
+    const string pattern = "\""s + key + "\": "s;
+    const size_t start = line.find(pattern);
+    if (start == string::npos) {
+        return {};
+    }
+    size_t begin = start + pattern.size();
+    size_t end = begin;
+    if (line[begin] == '"') {
+        end = line.find('"', ++begin);
+    } else {
+        end = line.find_first_of(",}"s, begin);
+    }
+    return line.substr(begin, end - begin);
+}
+
+// сравнивает медианы с прошлым запуском; возвращает число регрессий
+size_t CompareWithBaseline(ostream& out, const Options& options, const vector<BenchmarkResult>& results) {
+    ifstream input(options.baseline_path);
+    if (!input) {
+        throw runtime_error("Cannot open baseline "s + options.baseline_path);
+    }
+    map<string, double> baseline_medians;
+    string line;
+    while (getline(input, line)) {
+        if (line.rfind("\"config\": "s, 0) == 0 && line.find(FormatConfig(options)) == string::npos) {
+            out << "warning: baseline was recorded with a different configuration"s << endl;
+        }
+        const string name = ExtractField(line, "name"s);
+        if (!name.empty()) {
+            baseline_medians[name] = stod(ExtractField(line, "p50_us"s));
+        }
+    }
+    size_t regression_count = 0;
+    out << fixed << setprecision(1);
+    for (const BenchmarkResult& result : results) {
+        const auto it = baseline_medians.find(result.name);
+        if (it == baseline_medians.end()) {
+            out << result.name << ": no baseline"s << endl;
+            continue;
+        }
+        const double median = stod(ExtractField(FormatResult(result), "p50_us"s));
+        const double change = it->second > 0.0 ? 100.0 * (median - it->second) / it->second : 0.0;
+        const bool is_regression = change > options.threshold;
+        regression_count += is_regression;
+        out << result.name << ": p50 "s << it->second << " -> "s << median << " us ("s << showpos << change << noshowpos
+            << "%)"s << (is_regression ? " REGRESSION"s : ""s) << endl;
+    }
+    return regression_count;
+}
+
+// замеры сервера в памяти
+void RunMemoryBenchmarks(vector<BenchmarkResult>& results, const Options& options, const string& stop_words, const vector<string>& documents,
+                         const vector<string>& queries, const vector<pair<size_t, int>>& matches, const vector<int>& removed_ids) {
+    const auto build_server = [&](const function<void(Clock::duration, size_t)>& record) {
+        SearchServer search_server(stop_words);
+        for (size_t id = 0; id < documents.size(); ++id) {
+            record(MeasureDuration([&] {
+                search_server.AddDocument(static_cast<int>(id), documents[id], DocumentStatus::ACTUAL, {1, 2, 3});
+            }), 1);
+        }
+        return search_server;
+    };
+
+    RunBenchmark(results, options, "index"s, [&](const auto& record) {
+        build_server(record);
+    });
+    const SearchServer search_server = build_server([](Clock::duration, size_t) {});
+
+    RunBenchmark(results, options, "find_top_documents_seq"s, [&](const auto& record) {
+        for (const string& query : queries) {
+            record(MeasureDuration([&] {
+                search_server.FindTopDocuments(execution::seq, query);
+            }), 1);
+        }
+    });
+    RunBenchmark(results, options, "find_top_documents_par"s, [&](const auto& record) {
+        for (const string& query : queries) {
+            record(MeasureDuration([&] {
+                search_server.FindTopDocuments(execution::par, query);
+            }), 1);
+        }
+    });
+    RunBenchmark(results, options, "find_top_documents_fuzzy"s, [&](const auto& record) {
+        // те же запросы с нечетким поиском: плюс-слова раскрываются словами словаря в пределах одной правки
+        SearchServer fuzzy_server(search_server);
+        fuzzy_server.SetFuzzySearch(1, 0.5);
+        for (const string& query : queries) {
+            record(MeasureDuration([&] {
+                fuzzy_server.FindTopDocuments(execution::seq, query);
+            }), 1);
+        }
+    });
+    RunBenchmark(results, options, "match_document"s, [&](const auto& record) {
+        for (const auto& [query_index, document_id] : matches) {
+            record(MeasureDuration([&] {
+                search_server.MatchDocument(queries[query_index], document_id);
+            }), 1);
+        }
+    });
+    RunBenchmark(results, options, "process_queries"s, [&](const auto& record) {
+        record(MeasureDuration([&] {
+            ProcessQueries(search_server, queries);
+        }), queries.size());
+    });
+    RunBenchmark(results, options, "remove_document"s, [&](const auto& record) {
+        SearchServer server_copy(search_server);
+        for (const int document_id : removed_ids) {
+            record(MeasureDuration([&] {
+                server_copy.RemoveDocument(document_id);
+            }), 1);
+        }
+    });
+    RunBenchmark(results, options, "remove_duplicates"s, [&](const auto& record) {
+        // копии каждого десятого документа с новыми id
+        SearchServer server_copy(search_server);
+        for (const int document_id : removed_ids) {
+            server_copy.AddDocument(static_cast<int>(documents.size()) + document_id, documents[document_id], DocumentStatus::ACTUAL, {1});
+        }
+        // RemoveDuplicates сообщает о каждом дубликате в cout, где может быть JSON
+        ostringstream messages;
+        streambuf* const cout_buffer = cout.rdbuf(messages.rdbuf());
+        record(MeasureDuration([&] {
+            RemoveDuplicates(server_copy);
+        }), documents.size() + removed_ids.size());
+        cout.rdbuf(cout_buffer);
+    });
+}
+
+// убирает страницы файла из страничного кэша ядра, чтобы поиск читал блоки с диска
+void DropFileCache(const string& path) {
+#if defined(__unix__)
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+// ограничивает адресное пространство процесса: limit_mb МБ сверх уже занятого
+void ApplyMemoryLimit(size_t limit_mb) {
+#if defined(__linux__)
+    ifstream statm("/proc/self/statm"s);
+    size_t page_count = 0;
+    statm >> page_count;
+    rlimit limit {};
+    getrlimit(RLIMIT_AS, &limit);
+    limit.rlim_cur = page_count * sysconf(_SC_PAGESIZE) + (limit_mb << 20);
+    if (setrlimit(RLIMIT_AS, &limit) != 0) {
+        throw runtime_error("Cannot set memory limit"s);
+    }
+#else
+    cerr << "warning: memory limit is supported only on Linux"s << endl;
+#endif
+}
+
+// показатели кэша между двумя снимками: доля попаданий, блоки, прочитанные на запрос, и прочитанные мегабайты
+void AddCacheCounters(BenchmarkResult& result, const PostingCacheStats& before, const PostingCacheStats& after, size_t query_count) {
+    PostingCacheStats stats;
+    stats.hits = after.hits - before.hits;
+    stats.misses = after.misses - before.misses;
+    const size_t block_count = stats.misses + after.prefetched_blocks - before.prefetched_blocks;
+    result.counters.emplace_back("cache_hit_rate"s, stats.GetHitRate());
+    result.counters.emplace_back("blocks_read_per_query"s, static_cast<double>(block_count) / query_count);
+    result.counters.emplace_back("read_mb"s, (after.read_bytes - before.read_bytes) / 1048576.0);
+}
+
+// замеры поиска с диска: индекс строится в памяти, записывается в файл, и сервер в памяти вместе с текстами
+// документов освобождается до начала поиска
+void RunDiskBenchmarks(vector<BenchmarkResult>& results, const Options& options, const string& stop_words, vector<string>& documents,
+                       const vector<string>& queries) {
+    {
+        SearchServer search_server(stop_words);
+        for (size_t id = 0; id < documents.size(); ++id) {
+            search_server.AddDocument(static_cast<int>(id), documents[id], DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        BenchmarkResult result;
+        result.name = "disk_index_write"s;
+        result.Record(MeasureDuration([&] {
+            search_server.WriteDiskIndex(options.disk_index_path);
+        }), documents.size());
+        results.push_back(move(result));
+    }
+    documents.clear();
+    documents.shrink_to_fit();
+    DropFileCache(options.disk_index_path);
+    if (options.memory_limit_mb > 0) {
+        ApplyMemoryLimit(options.memory_limit_mb);
+    }
+
+    DiskSearchOptions search_options;
+    search_options.cache_bytes = options.cache_mb << 20;
+    search_options.prefetch_blocks = options.prefetch_blocks;
+    DiskSearchServer disk_server(options.disk_index_path, search_options);
+    PostingCacheStats before;
+    RunBenchmark(results, options, "disk_find_top_documents_cold"s, [&](const auto& record) {
+        disk_server.ClearCache();
+        DropFileCache(options.disk_index_path);
+        for (const string& query : queries) {
+            record(MeasureDuration([&] {
+                disk_server.FindTopDocuments(query);
+            }), 1);
+        }
+    });
+    // после очистки кэша показатели считаются заново, поэтому это показатели последнего повтора
+    AddCacheCounters(results.back(), before, disk_server.GetCacheStats(), queries.size());
+    before = disk_server.GetCacheStats();
+    RunBenchmark(results, options, "disk_find_top_documents"s, [&](const auto& record) {
+        for (const string& query : queries) {
+            record(MeasureDuration([&] {
+                disk_server.FindTopDocuments(query);
+            }), 1);
+        }
+    });
+    AddCacheCounters(results.back(), before, disk_server.GetCacheStats(), queries.size() * (options.warmup + options.repetitions));
+    results.back().counters.emplace_back("resident_kb"s, disk_server.GetMemoryStats().GetTotal().GetTotalBytes() / 1024.0);
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string argument = argv[i];
+        const string value = argv[i + 1];
+        if (argument == "--seed"s) {
+            options.seed = stoull(value);
+        } else if (argument == "--documents"s) {
+            options.documents = stoul(value);
+        } else if (argument == "--dictionary"s) {
+            options.dictionary = stoul(value);
+        } else if (argument == "--zipf"s) {
+            options.zipf_exponent = stod(value);
+        } else if (argument == "--min-document-words"s) {
+            options.min_document_words = stoul(value);
+        } else if (argument == "--max-document-words"s) {
+            options.max_document_words = stoul(value);
+        } else if (argument == "--queries"s) {
+            options.queries = stoul(value);
+        } else if (argument == "--max-query-words"s) {
+            options.max_query_words = stoul(value);
+        } else if (argument == "--minus-rate"s) {
+            options.minus_rate = stod(value);
+        } else if (argument == "--stop-words"s) {
+            options.stop_words = stoul(value);
+        } else if (argument == "--warmup"s) {
+            options.warmup = stoul(value);
+        } else if (argument == "--repetitions"s) {
+            options.repetitions = stoul(value);
+        } else if (argument == "--threshold"s) {
+            options.threshold = stod(value);
+        } else if (argument == "--output"s) {
+            options.output_path = value;
+        } else if (argument == "--baseline"s) {
+            options.baseline_path = value;
+        } else if (argument == "--disk-index"s) {
+            options.disk_index_path = value;
+        } else if (argument == "--cache-mb"s) {
+            options.cache_mb = stoul(value);
+        } else if (argument == "--prefetch-blocks"s) {
+            options.prefetch_blocks = stoul(value);
+        } else if (argument == "--memory-limit-mb"s) {
+            options.memory_limit_mb = stoul(value);
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && options.documents > 0 && options.queries > 0 && options.dictionary > options.stop_words
+        && options.min_document_words > 0 && options.min_document_words <= options.max_document_words
+        && options.max_query_words > 0 && options.repetitions > 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: search-server-bench [--seed N] [--documents N] [--dictionary N] [--zipf S]"s
+             << " [--min-document-words N] [--max-document-words N] [--queries N] [--max-query-words N]"s
+             << " [--minus-rate P] [--stop-words N] [--warmup N] [--repetitions N] [--output FILE.json]"s
+             << " [--baseline FILE.json] [--threshold PERCENT]"s
+             << " [--disk-index FILE] [--cache-mb N] [--prefetch-blocks N] [--memory-limit-mb N]"s << endl;
+        return 1;
+    }
+    try {
+        CorpusGenerator generator(options);
+        const string stop_words = generator.GetStopWords();
+        vector<string> documents;
+        for (size_t i = 0; i < options.documents; ++i) {
+            documents.push_back(generator.GenerateDocument());
+        }
+        vector<string> queries;
+        for (size_t i = 0; i < options.queries; ++i) {
+            queries.push_back(generator.GenerateQuery());
+        }
+        vector<pair<size_t, int>> matches;
+        for (size_t i = 0; i < options.queries; ++i) {
+            matches.emplace_back(i, static_cast<int>(generator.GetIndex(options.documents)));
+        }
+        // каждый десятый документ удаляется; доля меньше порога уплотнения, поэтому замеряется само удаление
+        vector<int> removed_ids;
+        for (size_t id = 0; id < options.documents; id += 10) {
+            removed_ids.push_back(static_cast<int>(id));
+        }
+
+        vector<BenchmarkResult> results;
+        if (options.disk_index_path.empty()) {
+            RunMemoryBenchmarks(results, options, stop_words, documents, queries, matches, removed_ids);
+        } else {
+            RunDiskBenchmarks(results, options, stop_words, documents, queries);
+        }
+
+        if (options.output_path.empty()) {
+            WriteJson(cout, options, results);
+        } else {
+            ofstream output(options.output_path);
+            WriteJson(output, options, results);
+        }
+        if (!options.baseline_path.empty() && CompareWithBaseline(cerr, options, results) > 0) {
+            return 2;
+        }
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,461 @@
+#include "corpus_loader.h"
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+struct ParsedDocument {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    vector<string_view> words;
+    // смещение строки документа в корпусе, нужно только для сообщений об ошибках
+    size_t offset = 0;
+};
+
+struct ParsedChunk {
+    vector<ParsedDocument> documents;
+    // строки JSON, в которых пришлось раскрыть escape-последовательности; deque не перемещает
+    // элементы ни при добавлении, ни при перемещении самой очереди, поэтому слова остаются действительными
+    deque<string> unescaped_strings;
+    exception_ptr error;
+};
+
+// номер строки по смещению считается только при ошибке, поэтому разбор не подсчитывает строки
+string DescribeLine(string_view data, size_t offset) {
+    return "line "s + to_string(count(data.begin(), data.begin() + offset, '\n') + 1);
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc() || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number: "s + string(text));
+    }
+    return value;
+}
+
+// отделяет очередное поле строки TSV
+string_view NextTsvField(string_view& line) {
+    const size_t end = line.find('\t');
+    if (end == string_view::npos) {
+        throw invalid_argument("Expected id, status, ratings and text separated by tabs"s);
+    }
+    const string_view field = line.substr(0, end);
+    line.remove_prefix(end + 1);
+    return field;
+}
+
+ParsedDocument ParseTsvLine(const SearchServer& search_server, string_view line) {
+    ParsedDocument document;
+    document.id = ParseInt(NextTsvField(line));
+    document.status = ParseDocumentStatus(NextTsvField(line));
+    string_view ratings = NextTsvField(line);
+    while (!ratings.empty()) {
+        const size_t end = ratings.find(',');
+        document.ratings.push_back(ParseInt(ratings.substr(0, end)));
+        ratings.remove_prefix(end == string_view::npos ? ratings.size() : end + 1);
+    }
+    document.words = search_server.TokenizeDocument(line);
+    return document;
+}
+
+// разбор одной строки JSONL; поддерживается подмножество JSON, достаточное для описания документа:
+// значения известных полей -- целые числа, строки и массивы целых чисел, значения остальных полей пропускаются
+class JsonLineParser {
+public:
+    JsonLineParser(string_view line, deque<string>& unescaped_strings)
+        : line_(line)
+        , unescaped_strings_(unescaped_strings) {
+    }
+
+    ParsedDocument Parse(const SearchServer& search_server) {
+        ParsedDocument document;
+        optional<int> id;
+        optional<string_view> text;
+        Expect('{');
+        if (!TryConsume('}')) {
+            do {
+                const string_view key = ParseString();
+                Expect(':');
+                if (key == "id"sv) {
+                    id = ParseInt(ParseNumber());
+                } else if (key == "status"sv) {
+                    document.status = ParseDocumentStatus(ParseString());
+                } else if (key == "ratings"sv) {
+                    Expect('[');
+                    if (!TryConsume(']')) {
+                        do {
+                            document.ratings.push_back(ParseInt(ParseNumber()));
+                        } while (TryConsume(','));
+                        Expect(']');
+                    }
+                } else if (key == "text"sv) {
+                    text = ParseString();
+                } else {
+                    SkipValue();
+                }
+            } while (TryConsume(','));
+            Expect('}');
+        }
+        SkipSpaces();
+        if (position_ != line_.size()) {
+            throw invalid_argument("Unexpected data after JSON object"s);
+        }
+        if (!id || !text) {
+            throw invalid_argument("Document must have id and text"s);
+        }
+        document.id = *id;
+        document.words = search_server.TokenizeDocument(*text);
+        return document;
+    }
+
+private:
+    void SkipSpaces() {
+        while (position_ < line_.size() && (line_[position_] == ' ' || line_[position_] == '\t')) {
+            ++position_;
+        }
+    }
+
+    bool TryConsume(char symbol) {
+        SkipSpaces();
+        if (position_ < line_.size() && line_[position_] == symbol) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char symbol) {
+        if (!TryConsume(symbol)) {
+            throw invalid_argument("Expected '"s + symbol + "' at position "s + to_string(position_));
+        }
+    }
+
+    string_view ParseNumber() {
+        SkipSpaces();
+        const size_t begin = position_;
+        while (position_ < line_.size() && (isalnum(static_cast<unsigned char>(line_[position_]))
+                                            || line_[position_] == '-' || line_[position_] == '+' || line_[position_] == '.')) {
+            ++position_;
+        }
+        if (position_ == begin) {
+            throw invalid_argument("Expected value at position "s + to_string(position_));
+        }
+        return line_.substr(begin, position_ - begin);
+    }
+
+    // строка без escape-последовательностей возвращается как часть исходной строки, без копирования
+    string_view ParseString() {
+        Expect('"');
+        const size_t begin = position_;
+        while (position_ < line_.size() && line_[position_] != '"' && line_[position_] != '\\') {
+            ++position_;
+        }
+        if (position_ == line_.size()) {
+            throw invalid_argument("Unterminated string"s);
+        }
+        if (line_[position_] == '"') {
+            return line_.substr(begin, position_++ - begin);
+        }
+        string& result = unescaped_strings_.emplace_back(line_.substr(begin, position_ - begin));
+        while (true) {
+            if (position_ == line_.size()) {
+                throw invalid_argument("Unterminated string"s);
+            }
+            const char symbol = line_[position_++];
+            if (symbol == '"') {
+                return result;
+            }
+            if (symbol != '\\') {
+                result.push_back(symbol);
+                continue;
+            }
+            if (position_ == line_.size()) {
+                throw invalid_argument("Unterminated string"s);
+            }
+            switch (const char escaped = line_[position_++]) {
+            case '"':
+            case '\\':
+            case '/':
+                result.push_back(escaped);
+                break;
+            case 'b':
+                result.push_back('\b');
+                break;
+            case 'f':
+                result.push_back('\f');
+                break;
+            case 'n':
+                result.push_back('\n');
+                break;
+            case 'r':
+                result.push_back('\r');
+                break;
+            case 't':
+                result.push_back('\t');
+                break;
+            case 'u':
+                result += EncodeUtf8(ParseUnicodeEscape());
+                break;
+            default:
+                throw invalid_argument("Invalid escape sequence \\"s + escaped);
+            }
+        }
+    }
+
+    // \uXXXX уже без "\u"; суррогатная пара UTF-16 записывается двумя последовательностями подряд
+    char32_t ParseUnicodeEscape() {
+        char32_t symbol = ParseHex4();
+        if (symbol >= 0xD800 && symbol < 0xDC00 && line_.substr(position_, 2) == "\\u"sv) {
+            position_ += 2;
+            const char32_t low = ParseHex4();
+            if (low < 0xDC00 || low >= 0xE000) {
+                throw invalid_argument("Invalid surrogate pair"s);
+            }
+            symbol = 0x10000 + ((symbol - 0xD800) << 10) + (low - 0xDC00);
+        }
+        return symbol;
+    }
+
+    char32_t ParseHex4() {
+        uint32_t value = 0;
+        const char* begin = line_.data() + position_;
+        const char* end = line_.data() + min(position_ + 4, line_.size());
+        const auto [parsed_end, error] = from_chars(begin, end, value, 16);
+        if (error != errc() || parsed_end != begin + 4) {
+            throw invalid_argument("Invalid \\u escape sequence"s);
+        }
+        position_ += 4;
+        return value;
+    }
+
+    void SkipValue() {
+        SkipSpaces();
+        if (position_ == line_.size()) {
+            throw invalid_argument("Expected value at position "s + to_string(position_));
+        }
+        const char symbol = line_[position_];
+        if (symbol == '"') {
+            ParseString();
+        } else if (symbol == '[' || symbol == '{') {
+            const char closing = symbol == '[' ? ']' : '}';
+            ++position_;
+            if (TryConsume(closing)) {
+                return;
+            }
+            do {
+                if (symbol == '{') {
+                    ParseString();
+                    Expect(':');
+                }
+                SkipValue();
+            } while (TryConsume(','));
+            Expect(closing);
+        } else {
+            ParseNumber();
+        }
+    }
+
+    string_view line_;
+    size_t position_ = 0;
+    deque<string>& unescaped_strings_;
+};
+
+// разбирает часть корпуса [begin, end); ошибка сохраняется в части и бросается при ее индексации,
+// чтобы документы до ошибочной строки были добавлены так же, как при последовательной загрузке
+ParsedChunk ParseChunk(const SearchServer& search_server, string_view data, size_t begin, size_t end, CorpusFormat format) {
+    ParsedChunk chunk;
+    try {
+        size_t line_begin = begin;
+        while (line_begin < end) {
+            const size_t line_end = min(data.find('\n', line_begin), end);
+            string_view line = data.substr(line_begin, line_end - line_begin);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty()) {
+                try {
+                    ParsedDocument document = format == CorpusFormat::TSV
+                        ? ParseTsvLine(search_server, line)
+                        : JsonLineParser(line, chunk.unescaped_strings).Parse(search_server);
+                    document.offset = line_begin;
+                    chunk.documents.push_back(move(document));
+                } catch (const invalid_argument& e) {
+                    throw invalid_argument("Invalid corpus "s + DescribeLine(data, line_begin) + ": "s + e.what());
+                }
+            }
+            line_begin = line_end + 1;
+        }
+    } catch (...) {
+        chunk.error = current_exception();
+    }
+    return chunk;
+}
+
+// делит корпус на части примерно по chunk_size байт, не разрывая строк
+vector<pair<size_t, size_t>> SplitIntoChunks(string_view data, size_t chunk_size) {
+    vector<pair<size_t, size_t>> chunks;
+    size_t begin = 0;
+    while (begin < data.size()) {
+        size_t end = min(begin + max(chunk_size, size_t{1}), data.size());
+        if (end < data.size()) {
+            const size_t newline = data.find('\n', end - 1);
+            end = newline == string_view::npos ? data.size() : newline + 1;
+        }
+        chunks.emplace_back(begin, end);
+        begin = end;
+    }
+    return chunks;
+}
+
+// очередь разобранных частей ограниченной емкости: часть начинают разбирать, только когда для нее
+// есть место, а индексация забирает части строго по порядку
+class ChunkQueue {
+public:
+    explicit ChunkQueue(size_t capacity)
+        : slots_(max(capacity, size_t{1})) {
+    }
+
+    // ждет, пока часть index поместится в очередь; false, если загрузка прервана
+    bool WaitForSpace(size_t index) {
+        unique_lock lock(mutex_);
+        space_available_.wait(lock, [&] {
+            return stopped_ || index < next_index_ + slots_.size();
+        });
+        return !stopped_;
+    }
+
+    void Push(size_t index, ParsedChunk chunk) {
+        {
+            lock_guard lock(mutex_);
+            slots_[index % slots_.size()] = move(chunk);
+        }
+        chunk_ready_.notify_one();
+    }
+
+    ParsedChunk PopNext() {
+        unique_lock lock(mutex_);
+        optional<ParsedChunk>& slot = slots_[next_index_ % slots_.size()];
+        chunk_ready_.wait(lock, [&] {
+            return slot.has_value();
+        });
+        ParsedChunk chunk = move(*slot);
+        slot.reset();
+        ++next_index_;
+        lock.unlock();
+        space_available_.notify_all();
+        return chunk;
+    }
+
+    void Stop() {
+        {
+            lock_guard lock(mutex_);
+            stopped_ = true;
+        }
+        space_available_.notify_all();
+    }
+
+private:
+    mutex mutex_;
+    condition_variable space_available_;
+    condition_variable chunk_ready_;
+    vector<optional<ParsedChunk>> slots_;
+    size_t next_index_ = 0;
+    bool stopped_ = false;
+};
+
+}  // namespace
+
+CorpusFormat GetCorpusFormat(const string& path) {
+    const auto has_suffix = [&path](string_view suffix) {
+        return path.size() >= suffix.size() && string_view(path).substr(path.size() - suffix.size()) == suffix;
+    };
+    return has_suffix(".jsonl"sv) || has_suffix(".json"sv) ? CorpusFormat::JSONL : CorpusFormat::TSV;
+}
+
+double CorpusLoadStats::GetMegabytesPerSecond() const {
+    return seconds > 0.0 ? byte_count / 1e6 / seconds : 0.0;
+}
+
+ostream& operator<<(ostream& out, const CorpusLoadStats& stats) {
+    out << stats.document_count << " documents, "s << stats.byte_count / 1e6 << " MB in "s
+        << stats.seconds << " s ("s << stats.GetMegabytesPerSecond() << " MB/s)"s;
+    return out;
+}
+
+CorpusLoadStats LoadCorpus(SearchServer& search_server, string_view data, const CorpusLoadOptions& options) {
+    const auto start_time = chrono::steady_clock::now();
+    const auto chunks = SplitIntoChunks(data, options.chunk_size);
+    size_t parser_count = options.parser_count > 0 ? options.parser_count : max(thread::hardware_concurrency(), 1u);
+    parser_count = min(parser_count, chunks.size());
+
+    CorpusLoadStats stats;
+    stats.byte_count = data.size();
+    ChunkQueue queue(options.max_queued_chunks);
+    atomic<size_t> next_chunk = 0;
+    // потоки разбора только читают сервер (стоп-слова), поэтому работают одновременно с индексацией
+    const SearchServer& parsing_server = search_server;
+    vector<thread> parsers;
+    try {
+        for (size_t i = 0; i < parser_count; ++i) {
+            parsers.emplace_back([&] {
+                for (size_t index = next_chunk++; index < chunks.size(); index = next_chunk++) {
+                    if (!queue.WaitForSpace(index)) {
+                        return;
+                    }
+                    queue.Push(index, ParseChunk(parsing_server, data, chunks[index].first, chunks[index].second, options.format));
+                }
+            });
+        }
+        for (size_t index = 0; index < chunks.size(); ++index) {
+            const ParsedChunk chunk = queue.PopNext();
+            // документы части лежат до ее ошибочной строки, поэтому добавляются до того, как ошибка брошена
+            for (const ParsedDocument& document : chunk.documents) {
+                try {
+                    search_server.AddTokenizedDocument(document.id, document.words, document.status, document.ratings);
+                } catch (const invalid_argument& e) {
+                    throw invalid_argument("Invalid corpus "s + DescribeLine(data, document.offset) + ": "s + e.what());
+                }
+                ++stats.document_count;
+            }
+            if (chunk.error) {
+                rethrow_exception(chunk.error);
+            }
+        }
+    } catch (...) {
+        queue.Stop();
+        for (thread& parser : parsers) {
+            parser.join();
+        }
+        throw;
+    }
+    for (thread& parser : parsers) {
+        parser.join();
+    }
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    return stats;
+}
+
+CorpusLoadStats LoadCorpusFile(SearchServer& search_server, const string& path, size_t parser_count) {
+    const MappedFile file(path);
+    CorpusLoadOptions options;
+    options.format = GetCorpusFormat(path);
+    options.parser_count = parser_count;
+    return LoadCorpus(search_server, file.GetData(), options);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <string>
+#include <string_view>
+
+// форматы файлов корпуса, по одному документу на строку:
+// * TSV: id<TAB>статус<TAB>рейтинги через запятую<TAB>текст, например "7\tACTUAL\t1,2,3\tбелый кот";
+// * JSONL: {"id": 7, "status": "ACTUAL", "ratings": [1, 2, 3], "text": "белый кот"},
+//   статус и рейтинги необязательны (по умолчанию ACTUAL и пустой список)
+// статусы записываются так же, как в GetDocumentStatusName; пустые строки пропускаются
+enum class CorpusFormat {
+    TSV,
+    JSONL,
+};
+
+// формат по расширению файла: .jsonl и .json -- JSONL, остальные -- TSV
+CorpusFormat GetCorpusFormat(const std::string& path);
+
+struct CorpusLoadOptions {
+    CorpusFormat format = CorpusFormat::TSV;
+    // число потоков разбора; 0 -- по числу ядер
+    size_t parser_count = 0;
+    // корпус делится на части примерно такого размера по границам строк
+    size_t chunk_size = 4 << 20;
+    // сколько разобранных частей может ждать индексации; ограничивает потребление памяти,
+    // если разбор опережает индексацию
+    size_t max_queued_chunks = 8;
+};
+
+struct CorpusLoadStats {
+    size_t byte_count = 0;
+    size_t document_count = 0;
+    double seconds = 0.0;
+
+    double GetMegabytesPerSecond() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStats& stats);
+
+// загружает корпус в сервер: части корпуса разбираются параллельно (вместе с разбиением текста на слова),
+// а текущий поток добавляет разобранные документы в сервер в порядке следования в корпусе, так что
+// разбор и индексация идут одновременно
+// текст документов не копируется: слова ссылаются прямо в data, пока документ не добавлен в сервер;
+// копируются только строки JSON с escape-последовательностями
+// при ошибке бросается std::invalid_argument с номером строки; документы до нее остаются добавленными
+CorpusLoadStats LoadCorpus(SearchServer& search_server, std::string_view data, const CorpusLoadOptions& options = {});
+// отображает файл в память и загружает его, формат определяется по расширению
+CorpusLoadStats LoadCorpusFile(SearchServer& search_server, const std::string& path, size_t parser_count = 0);
@@ -0,0 +1,83 @@
+#include "corpus_loader.h"
+#include "query_daemon.h"
+#include "query_trace.h"
+
+#include <csignal>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+QueryDaemon* running_daemon = nullptr;
+
+void HandleStopSignal(int) {
+    if (running_daemon) {
+        running_daemon->Stop();
+    }
+}
+
+void PrintUsage() {
+    cerr << "Usage: search-server-daemon [--port N] [--host ADDRESS] [--unix PATH]"s
+         << " [--threads N] [--pipeline N] [--stop-words \"WORDS\"] [--corpus FILE.tsv|FILE.jsonl]"s << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    DaemonOptions options;
+    options.tcp_port = 7000;
+    string stop_words;
+    string corpus_path;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        const string value = argv[++i];
+        if (argument == "--port"s) {
+            options.tcp_port = static_cast<uint16_t>(stoi(value));
+        } else if (argument == "--host"s) {
+            options.tcp_host = value;
+        } else if (argument == "--unix"s) {
+            options.unix_socket_path = value;
+        } else if (argument == "--threads"s) {
+            options.worker_count = stoul(value);
+        } else if (argument == "--pipeline"s) {
+            options.max_pipeline_depth = stoul(value);
+        } else if (argument == "--stop-words"s) {
+            stop_words = value;
+        } else if (argument == "--corpus"s) {
+            corpus_path = value;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    try {
+        SearchServer search_server(stop_words);
+        if (!corpus_path.empty()) {
+            cerr << "Loaded "s << LoadCorpusFile(search_server, corpus_path) << endl;
+        }
+        QueryProtocol protocol(search_server);
+        QueryDaemon daemon(protocol, options);
+        running_daemon = &daemon;
+        signal(SIGINT, HandleStopSignal);
+        signal(SIGTERM, HandleStopSignal);
+        if (options.unix_socket_path.empty()) {
+            cerr << "Listening on "s << options.tcp_host << ':' << daemon.GetTcpPort() << endl;
+        } else {
+            cerr << "Listening on "s << options.unix_socket_path << endl;
+        }
+        daemon.Run();
+        running_daemon = nullptr;
+        // время этапов поиска за время работы
+        PrintTraceSnapshot(cerr, TakeTraceSnapshot());
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,654 @@
+#include "disk_index.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define SEARCH_SERVER_HAS_PREAD
+#endif
+
+using namespace std;
+
+namespace {
+
+const char DISK_INDEX_MAGIC[8] = {'S', 'S', 'D', 'I', 'S', 'K', '0', '1'};
+// блок: частоты (double) и порядковые номера (int) элементов
+const size_t DISK_POSTING_ENTRY_SIZE = sizeof(double) + sizeof(int);
+
+// число double в массиве слота для блока из size элементов
+size_t GetSlotDoubleCount(size_t size) {
+    return (size * DISK_POSTING_ENTRY_SIZE + sizeof(double) - 1) / sizeof(double);
+}
+
+template <typename Value>
+void ReadValue(istream& input, Value& value) {
+    input.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+string ReadString(istream& input) {
+    uint32_t size = 0;
+    ReadValue(input, size);
+    string result(size, '\0');
+    input.read(result.data(), size);
+    return result;
+}
+
+}  // namespace
+
+size_t DiskPostingList::GetBlockCount() const {
+    return block_last_ordinals.size();
+}
+
+size_t DiskPostingList::GetBlockSize(size_t block) const {
+    return min(DISK_POSTING_BLOCK_SIZE, posting_count - block * DISK_POSTING_BLOCK_SIZE);
+}
+
+uint64_t DiskPostingList::GetBlockOffset(size_t block) const {
+    return offset + block * DISK_POSTING_BLOCK_SIZE * DISK_POSTING_ENTRY_SIZE;
+}
+
+DiskIndexWriter::DiskIndexWriter(const string& path)
+    : path_(path)
+    , output_(path, ios::binary | ios::trunc) {
+    if (!output_) {
+        throw system_error(errno, generic_category(), "Cannot create "s + path);
+    }
+    Write(DISK_INDEX_MAGIC, sizeof(DISK_INDEX_MAGIC));
+    const uint64_t block_size = DISK_POSTING_BLOCK_SIZE;
+    Write(&block_size, sizeof(block_size));
+}
+
+void DiskIndexWriter::AddStopWord(string_view word) {
+    stop_words_.emplace_back(word);
+}
+
+void DiskIndexWriter::AddDocument(int document_id, DocumentStatus status, int rating, double inv_word_count) {
+    documents_.push_back({document_id, status, rating, inv_word_count});
+}
+
+// блоки списка пишутся сразу, в памяти остается только запись словаря
+void DiskIndexWriter::AddPostingList(string_view word, const vector<int>& ordinals, const vector<double>& term_freqs) {
+    DiskPostingList postings;
+    postings.offset = offset_;
+    postings.posting_count = ordinals.size();
+    for (size_t start = 0; start < ordinals.size(); start += DISK_POSTING_BLOCK_SIZE) {
+        const size_t size = min(DISK_POSTING_BLOCK_SIZE, ordinals.size() - start);
+        Write(term_freqs.data() + start, size * sizeof(double));
+        Write(ordinals.data() + start, size * sizeof(int));
+        postings.block_last_ordinals.push_back(ordinals[start + size - 1]);
+    }
+    dictionary_.emplace_back(string(word), move(postings));
+}
+
+void DiskIndexWriter::Finish(long long total_word_count) {
+    const uint64_t metadata_offset = offset_;
+    const uint64_t document_count = documents_.size();
+    Write(&document_count, sizeof(document_count));
+    for (const DocumentInfo& document : documents_) {
+        const int32_t status = static_cast<int32_t>(document.status);
+        Write(&document.id, sizeof(document.id));
+        Write(&status, sizeof(status));
+        Write(&document.rating, sizeof(document.rating));
+        Write(&document.inv_word_count, sizeof(document.inv_word_count));
+    }
+    Write(&total_word_count, sizeof(total_word_count));
+    const auto write_string = [this](const string& text) {
+        const uint32_t size = static_cast<uint32_t>(text.size());
+        Write(&size, sizeof(size));
+        Write(text.data(), text.size());
+    };
+    const uint64_t stop_word_count = stop_words_.size();
+    Write(&stop_word_count, sizeof(stop_word_count));
+    for (const string& word : stop_words_) {
+        write_string(word);
+    }
+    const uint64_t word_count = dictionary_.size();
+    Write(&word_count, sizeof(word_count));
+    for (const auto& [word, postings] : dictionary_) {
+        write_string(word);
+        const uint64_t posting_count = postings.posting_count;
+        Write(&postings.offset, sizeof(postings.offset));
+        Write(&posting_count, sizeof(posting_count));
+        Write(postings.block_last_ordinals.data(), postings.block_last_ordinals.size() * sizeof(int));
+    }
+    Write(&metadata_offset, sizeof(metadata_offset));
+    Write(DISK_INDEX_MAGIC, sizeof(DISK_INDEX_MAGIC));
+    output_.close();
+    if (!output_) {
+        throw system_error(errno, generic_category(), "Cannot write "s + path_);
+    }
+}
+
+void DiskIndexWriter::Write(const void* data, size_t size) {
+    output_.write(static_cast<const char*>(data), size);
+    if (!output_) {
+        throw system_error(errno, generic_category(), "Cannot write "s + path_);
+    }
+    offset_ += size;
+}
+
+double PostingCacheStats::GetHitRate() const {
+    return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses);
+}
+
+PostingBlockCache::Handle::Handle(Handle&& other) noexcept
+    : cache_(other.cache_)
+    , slot_(other.slot_)
+    , size_(other.size_)
+    , term_freqs_(other.term_freqs_)
+    , ordinals_(other.ordinals_) {
+    other.cache_ = nullptr;
+}
+
+PostingBlockCache::Handle& PostingBlockCache::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        Release();
+        cache_ = other.cache_;
+        slot_ = other.slot_;
+        size_ = other.size_;
+        term_freqs_ = other.term_freqs_;
+        ordinals_ = other.ordinals_;
+        other.cache_ = nullptr;
+    }
+    return *this;
+}
+
+PostingBlockCache::Handle::~Handle() {
+    Release();
+}
+
+size_t PostingBlockCache::Handle::size() const {
+    return size_;
+}
+
+const double* PostingBlockCache::Handle::GetTermFreqs() const {
+    return term_freqs_;
+}
+
+const int* PostingBlockCache::Handle::GetOrdinals() const {
+    return ordinals_;
+}
+
+void PostingBlockCache::Handle::Release() {
+    if (cache_ != nullptr) {
+        cache_->Unpin(slot_);
+        cache_ = nullptr;
+    }
+}
+
+PostingBlockCache::PostingBlockCache(const string& path, size_t capacity_bytes, size_t prefetch_blocks)
+    : path_(path)
+    , capacity_bytes_(capacity_bytes)
+    , prefetch_blocks_(prefetch_blocks) {
+#ifdef SEARCH_SERVER_HAS_PREAD
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw system_error(errno, generic_category(), "Cannot open "s + path);
+    }
+#ifdef POSIX_FADV_RANDOM
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_RANDOM);
+#endif
+#else
+    input_.open(path, ios::binary);
+    if (!input_) {
+        throw system_error(make_error_code(errc::no_such_file_or_directory), "Cannot open "s + path);
+    }
+#endif
+}
+
+PostingBlockCache::~PostingBlockCache() {
+#ifdef SEARCH_SERVER_HAS_PREAD
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+#endif
+}
+
+// при промахе следующие блоки списка, которых нет в кэше, читаются вместе с запрошенным
+PostingBlockCache::Handle PostingBlockCache::Acquire(const DiskPostingList& postings, size_t block) {
+    unique_lock lock(mutex_);
+    const uint64_t offset = postings.GetBlockOffset(block);
+    auto it = offset_to_slot_.find(offset);
+    if (it != offset_to_slot_.end()) {
+        ++stats_.hits;
+        Slot& slot = slots_[it->second];
+        if (slot.is_prefetched) {
+            ++stats_.prefetch_hits;
+            slot.is_prefetched = false;
+        }
+    } else {
+        ++stats_.misses;
+        vector<size_t> read_slots;
+        // слоты не перемещаются, а занятые читающим потоком никто больше не изменяет, поэтому данные слотов
+        // доступны без блокировки
+        vector<Slot*> read_blocks;
+        for (size_t next_block = block; next_block < postings.GetBlockCount() && next_block <= block + prefetch_blocks_; ++next_block) {
+            const uint64_t next_offset = postings.GetBlockOffset(next_block);
+            if (offset_to_slot_.count(next_offset) > 0) {
+                break;
+            }
+            // упреждающее чтение не увеличивает кэш сверх емкости
+            const size_t slot_index = AllocateSlot(postings.GetBlockSize(next_block), next_block == block);
+            if (slot_index == SIZE_MAX) {
+                break;
+            }
+            Slot& slot = slots_[slot_index];
+            slot.offset = next_offset;
+            slot.state = SlotState::LOADING;
+            slot.is_referenced = false;
+            slot.is_prefetched = next_block != block;
+            // слоты закрепляются на время чтения, чтобы следующие блоки не вытеснили предыдущие
+            ++slot.pin_count;
+            offset_to_slot_[next_offset] = slot_index;
+            read_slots.push_back(slot_index);
+            read_blocks.push_back(&slot);
+        }
+        stats_.prefetched_blocks += read_slots.size() - 1;
+
+        lock.unlock();
+        exception_ptr error;
+        size_t read_count = 0;
+        try {
+            read_count = ReadBlocks(offset, read_blocks);
+            for (size_t i = 0; i < read_blocks.size(); ++i) {
+                CheckBlock(postings, block + i, *read_blocks[i]);
+            }
+        } catch (...) {
+            error = current_exception();
+        }
+        lock.lock();
+
+        stats_.read_count += read_count;
+        for (const size_t slot_index : read_slots) {
+            Slot& slot = slots_[slot_index];
+            if (!error) {
+                stats_.read_bytes += slot.size * DISK_POSTING_ENTRY_SIZE;
+            }
+            slot.state = error ? SlotState::FAILED : SlotState::LOADED;
+            slot.error = error;
+            ReleasePin(slot_index);
+        }
+        slot_loaded_.notify_all();
+        if (error) {
+            rethrow_exception(error);
+        }
+        it = offset_to_slot_.find(offset);
+    }
+    const size_t slot_index = it->second;
+    Slot& slot = slots_[slot_index];
+    slot.is_referenced = true;
+    // закрепленный слот не вытесняется, пока поток ждет, когда другой поток дочитает блок
+    ++slot.pin_count;
+    slot_loaded_.wait(lock, [&slot] {
+        return slot.state != SlotState::LOADING;
+    });
+    if (slot.state == SlotState::FAILED) {
+        const exception_ptr error = slot.error;
+        ReleasePin(slot_index);
+        rethrow_exception(error);
+    }
+    Handle handle;
+    handle.cache_ = this;
+    handle.slot_ = slot_index;
+    handle.size_ = slot.size;
+    handle.term_freqs_ = slot.data.data();
+    handle.ordinals_ = reinterpret_cast<const int*>(slot.data.data() + slot.size);
+    return handle;
+}
+
+PostingCacheStats PostingBlockCache::GetStats() const {
+    lock_guard guard(mutex_);
+    return stats_;
+}
+
+void PostingBlockCache::Clear() {
+    lock_guard guard(mutex_);
+    for (size_t slot_index = 0; slot_index < slots_.size(); ++slot_index) {
+        if (slots_[slot_index].pin_count == 0 && slots_[slot_index].offset != UINT64_MAX) {
+            FreeSlot(slot_index);
+        }
+    }
+    stats_ = {};
+}
+
+MemoryUsage PostingBlockCache::GetMemoryUsage() const {
+    lock_guard guard(mutex_);
+    MemoryUsage usage;
+    for (const Slot& slot : slots_) {
+        const MemoryUsage slot_usage = GetVectorMemoryUsage(slot.data);
+        const size_t payload_bytes = slot.offset == UINT64_MAX ? 0 : slot.size * DISK_POSTING_ENTRY_SIZE;
+        usage.payload_bytes += payload_bytes;
+        usage.overhead_bytes += slot_usage.GetTotalBytes() - payload_bytes;
+    }
+    usage.overhead_bytes += slots_.size() * sizeof(Slot) + GetVectorMemoryUsage(free_slots_).GetTotalBytes()
+        + GetHashMapMemoryUsage(offset_to_slot_).GetTotalBytes();
+    return usage;
+}
+
+// слот для блока из size элементов; пока блок не помещается в емкость, стрелка CLOCK вытесняет блоки
+// если вытеснить нечего (все блоки закреплены), емкость превышается, когда это разрешено (may_exceed),
+// иначе возвращается SIZE_MAX
+size_t PostingBlockCache::AllocateSlot(size_t size, bool may_exceed) {
+    const size_t bytes = GetSlotDoubleCount(size) * sizeof(double);
+    while (used_bytes_ + bytes > capacity_bytes_) {
+        if (!EvictSlot()) {
+            if (!may_exceed) {
+                return SIZE_MAX;
+            }
+            break;
+        }
+    }
+    size_t slot_index = slots_.size();
+    if (free_slots_.empty()) {
+        slots_.emplace_back();
+    } else {
+        slot_index = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    Slot& slot = slots_[slot_index];
+    slot.size = size;
+    slot.data.resize(GetSlotDoubleCount(size));
+    used_bytes_ += bytes;
+    return slot_index;
+}
+
+// за два оборота стрелка находит незакрепленный блок, если он есть: на первом снимаются биты обращения
+bool PostingBlockCache::EvictSlot() {
+    for (size_t step = 0; step < 2 * slots_.size(); ++step) {
+        const size_t slot_index = clock_hand_;
+        clock_hand_ = (clock_hand_ + 1) % slots_.size();
+        Slot& slot = slots_[slot_index];
+        if (slot.pin_count > 0 || slot.offset == UINT64_MAX) {
+            continue;
+        }
+        if (slot.is_referenced) {
+            slot.is_referenced = false;
+            continue;
+        }
+        FreeSlot(slot_index);
+        ++stats_.evictions;
+        return true;
+    }
+    return false;
+}
+
+// память блока возвращается сразу: блоки разных списков различаются размером
+void PostingBlockCache::FreeSlot(size_t slot_index) {
+    Slot& slot = slots_[slot_index];
+    offset_to_slot_.erase(slot.offset);
+    used_bytes_ -= slot.data.size() * sizeof(double);
+    slot.offset = UINT64_MAX;
+    slot.error = nullptr;
+    slot.data = vector<double>();
+    free_slots_.push_back(slot_index);
+}
+
+// блоки слотов лежат в файле подряд и читаются одним обращением
+size_t PostingBlockCache::ReadBlocks(uint64_t offset, const vector<Slot*>& slots) {
+    size_t read_count = 0;
+#ifdef SEARCH_SERVER_HAS_PREAD
+    vector<iovec> buffers;
+    size_t total_size = 0;
+    for (Slot* slot : slots) {
+        buffers.push_back({slot->data.data(), slot->size * DISK_POSTING_ENTRY_SIZE});
+        total_size += buffers.back().iov_len;
+    }
+    size_t read_size = 0;
+    size_t buffer_index = 0;
+    while (read_size < total_size) {
+        const ssize_t result = preadv(fd_, buffers.data() + buffer_index, static_cast<int>(buffers.size() - buffer_index), offset + read_size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw system_error(result < 0 ? errno : EIO, generic_category(), "Cannot read posting blocks"s);
+        }
+        read_size += result;
+        ++read_count;
+        // короткое чтение: продолжаем с недочитанного буфера
+        for (size_t consumed = result; consumed > 0;) {
+            const size_t step = min(consumed, buffers[buffer_index].iov_len);
+            buffers[buffer_index].iov_base = static_cast<char*>(buffers[buffer_index].iov_base) + step;
+            buffers[buffer_index].iov_len -= step;
+            consumed -= step;
+            if (buffers[buffer_index].iov_len == 0) {
+                ++buffer_index;
+            }
+        }
+    }
+#else
+    lock_guard guard(input_mutex_);
+    input_.clear();
+    input_.seekg(offset);
+    for (Slot* slot : slots) {
+        input_.read(reinterpret_cast<char*>(slot->data.data()), slot->size * DISK_POSTING_ENTRY_SIZE);
+    }
+    if (!input_) {
+        throw system_error(make_error_code(errc::io_error), "Cannot read posting blocks"s);
+    }
+    ++read_count;
+#endif
+    return read_count;
+}
+
+// номера блока лежат после последнего номера предыдущего блока, и последний номер блока совпадает со словарем,
+// который при загрузке проверен по числу документов, поэтому все номера блока -- действительные номера документов
+void PostingBlockCache::CheckBlock(const DiskPostingList& postings, size_t block, const Slot& slot) const {
+    const int* ordinals = reinterpret_cast<const int*>(slot.data.data() + slot.size);
+    const int first_ordinal = block == 0 ? 0 : postings.block_last_ordinals[block - 1] + 1;
+    const bool is_increasing = adjacent_find(ordinals, ordinals + slot.size, [](int lhs, int rhs) {
+        return lhs >= rhs;
+    }) == ordinals + slot.size;
+    if (ordinals[0] < first_ordinal || ordinals[slot.size - 1] != postings.block_last_ordinals[block] || !is_increasing) {
+        throw invalid_argument("Invalid disk index "s + path_);
+    }
+}
+
+void PostingBlockCache::Unpin(size_t slot) {
+    lock_guard guard(mutex_);
+    ReleasePin(slot);
+}
+
+void PostingBlockCache::ReleasePin(size_t slot) {
+    if (--slots_[slot].pin_count == 0 && slots_[slot].state == SlotState::FAILED) {
+        FreeSlot(slot);
+    }
+}
+
+DiskPostingCursor::DiskPostingCursor(PostingBlockCache& cache, const DiskPostingList& postings)
+    : cache_(&cache)
+    , postings_(&postings) {
+    LoadBlock(0);
+}
+
+int DiskPostingCursor::GetOrdinal() const {
+    return block_ < postings_->GetBlockCount() ? handle_.GetOrdinals()[position_] : END_ORDINAL;
+}
+
+double DiskPostingCursor::GetTermFreq() const {
+    return handle_.GetTermFreqs()[position_];
+}
+
+void DiskPostingCursor::Next() {
+    if (++position_ == handle_.size()) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void DiskPostingCursor::SeekTo(int ordinal) {
+    if (GetOrdinal() >= ordinal) {
+        return;
+    }
+    const auto& last_ordinals = postings_->block_last_ordinals;
+    if (last_ordinals[block_] < ordinal) {
+        LoadBlock(lower_bound(last_ordinals.begin() + block_, last_ordinals.end(), ordinal) - last_ordinals.begin());
+        if (block_ == postings_->GetBlockCount()) {
+            return;
+        }
+    }
+    const int* ordinals = handle_.GetOrdinals();
+    position_ = lower_bound(ordinals + position_, ordinals + handle_.size(), ordinal) - ordinals;
+}
+
+// за последним блоком курсор отпускает блок и указывает на конец списка
+void DiskPostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+    handle_ = block < postings_->GetBlockCount() ? cache_->Acquire(*postings_, block) : PostingBlockCache::Handle();
+}
+
+DiskSearchServer::DiskSearchServer(const string& path, const DiskSearchOptions& options)
+    : cache_(path, options.cache_bytes, options.prefetch_blocks) {
+    ifstream input(path, ios::binary);
+    const auto check = [&input, &path](bool condition) {
+        if (!input || !condition) {
+            throw invalid_argument("Invalid disk index "s + path);
+        }
+    };
+    char magic[sizeof(DISK_INDEX_MAGIC)] = {};
+    uint64_t block_size = 0;
+    input.read(magic, sizeof(magic));
+    ReadValue(input, block_size);
+    check(memcmp(magic, DISK_INDEX_MAGIC, sizeof(magic)) == 0 && block_size == DISK_POSTING_BLOCK_SIZE);
+    uint64_t metadata_offset = 0;
+    input.seekg(-static_cast<streamoff>(sizeof(metadata_offset) + sizeof(magic)), ios::end);
+    ReadValue(input, metadata_offset);
+    input.read(magic, sizeof(magic));
+    check(memcmp(magic, DISK_INDEX_MAGIC, sizeof(magic)) == 0);
+
+    input.seekg(metadata_offset);
+    uint64_t document_count = 0;
+    ReadValue(input, document_count);
+    check(document_count <= static_cast<uint64_t>(numeric_limits<int>::max()));
+    ordinal_to_document_id_.resize(document_count);
+    document_statuses_.resize(document_count);
+    document_ratings_.resize(document_count);
+    document_inv_word_counts_.resize(document_count);
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        int32_t status = 0;
+        ReadValue(input, ordinal_to_document_id_[ordinal]);
+        ReadValue(input, status);
+        ReadValue(input, document_ratings_[ordinal]);
+        ReadValue(input, document_inv_word_counts_[ordinal]);
+        document_statuses_[ordinal] = static_cast<DocumentStatus>(status);
+    }
+    ReadValue(input, total_word_count_);
+    uint64_t stop_word_count = 0;
+    ReadValue(input, stop_word_count);
+    vector<string> stop_words;
+    for (size_t i = 0; i < stop_word_count && input; ++i) {
+        stop_words.push_back(ReadString(input));
+    }
+    check(stop_words.size() == stop_word_count);
+    stop_words_ = StopWordSet(stop_words);
+    uint64_t word_count = 0;
+    ReadValue(input, word_count);
+    for (size_t i = 0; i < word_count && input; ++i) {
+        string word = ReadString(input);
+        DiskPostingList postings;
+        uint64_t posting_count = 0;
+        ReadValue(input, postings.offset);
+        ReadValue(input, posting_count);
+        check(posting_count > 0 && posting_count <= document_count);
+        postings.posting_count = posting_count;
+        postings.block_last_ordinals.resize((posting_count + DISK_POSTING_BLOCK_SIZE - 1) / DISK_POSTING_BLOCK_SIZE);
+        input.read(reinterpret_cast<char*>(postings.block_last_ordinals.data()), postings.block_last_ordinals.size() * sizeof(int));
+        // курсоры ищут блоки по последним номерам, а номера блоков проверяются по ним при чтении (см. PostingBlockCache)
+        const auto& last_ordinals = postings.block_last_ordinals;
+        check(adjacent_find(last_ordinals.begin(), last_ordinals.end(), [](int lhs, int rhs) {
+            return lhs >= rhs;
+        }) == last_ordinals.end());
+        check(last_ordinals.front() >= 0 && static_cast<uint64_t>(last_ordinals.back()) < document_count);
+        check(postings.GetBlockOffset(postings.GetBlockCount() - 1) + postings.GetBlockSize(postings.GetBlockCount() - 1) * DISK_POSTING_ENTRY_SIZE
+              <= metadata_offset);
+        word_to_postings_.emplace(move(word), move(postings));
+    }
+    check(word_to_postings_.size() == word_count);
+}
+
+int DiskSearchServer::GetDocumentCount() const {
+    return static_cast<int>(ordinal_to_document_id_.size());
+}
+
+MemoryStats DiskSearchServer::GetMemoryStats() const {
+    using namespace memory_usage_detail;
+    MemoryStats stats;
+    stats.dictionary = GetTreeNodesMemoryUsage<decltype(word_to_postings_)::value_type>(word_to_postings_.size());
+    for (const auto& [word, postings] : word_to_postings_) {
+        stats.dictionary += GetStringMemoryUsage(word);
+        stats.dictionary += GetVectorMemoryUsage(postings.block_last_ordinals);
+    }
+    stats.postings = cache_.GetMemoryUsage();
+    stats.document_metadata = GetVectorMemoryUsage(ordinal_to_document_id_);
+    stats.document_metadata += GetVectorMemoryUsage(document_statuses_);
+    stats.document_metadata += GetVectorMemoryUsage(document_ratings_);
+    stats.document_metadata += GetVectorMemoryUsage(document_inv_word_counts_);
+    stats.stop_words = stop_words_.GetMemoryStats();
+    return stats;
+}
+
+PostingCacheStats DiskSearchServer::GetCacheStats() const {
+    return cache_.GetStats();
+}
+
+void DiskSearchServer::ClearCache() {
+    cache_.Clear();
+}
+
+// разбор запроса по правилам SearchServer: -слово исключает документы, +слово обязательно, стоп-слова
+// пропускаются, повторы слов удаляются
+DiskSearchServer::Query DiskSearchServer::ParseQuery(const string_view raw_query) const {
+    Query result;
+    for (string_view word : SplitIntoWords(raw_query)) {
+        if (word.empty()) {
+            throw invalid_argument("Query word is empty"s);
+        }
+        const bool is_minus = word[0] == '-';
+        const bool is_required = word[0] == '+';
+        if (is_minus || is_required) {
+            word.remove_prefix(1);
+        }
+        const bool is_invalid = any_of(word.begin(), word.end(), [](char c) {
+            return c >= '\0' && c < ' ';
+        });
+        if (word.empty() || word[0] == '-' || (is_required && word[0] == '+') || is_invalid) {
+            throw invalid_argument("Query word "s + string(word) + " is invalid"s);
+        }
+        if (stop_words_.Contains(word)) {
+            continue;
+        }
+        if (is_minus) {
+            result.minus_words.push_back(word);
+        } else {
+            result.plus_words.push_back(word);
+            if (is_required) {
+                result.required_words.push_back(word);
+            }
+        }
+    }
+    for (auto* words : {&result.plus_words, &result.minus_words, &result.required_words}) {
+        sort(words->begin(), words->end());
+        words->erase(unique(words->begin(), words->end()), words->end());
+    }
+    return result;
+}
+
+const DiskPostingList* DiskSearchServer::FindPostings(string_view word) const {
+    const auto it = word_to_postings_.find(word);
+    return it == word_to_postings_.end() ? nullptr : &it->second;
+}
+
+CollectionStatistics DiskSearchServer::GetCollectionStatistics() const {
+    CollectionStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    if (statistics.document_count > 0) {
+        statistics.average_document_length = total_word_count_ * 1.0 / statistics.document_count;
+    }
+    return statistics;
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// индекс на диске для коллекций, которые не помещаются в память (см. SearchServer::WriteDiskIndex)
+// в памяти остаются только словарь, сведения о документах и стоп-слова, а списки документов читаются из файла
+// блоками по DISK_POSTING_BLOCK_SIZE элементов через кэш ограниченного размера
+// формат файла: заголовок, блоки списков документов (слово за словом, в каждом блоке сначала частоты, затем
+// порядковые номера), сведения о документах, стоп-слова, словарь со смещениями списков и последними номерами
+// их блоков и в конце -- смещение сведений; числа записываются в порядке байтов машины, на которой создан файл
+
+// число элементов списка документов в блоке: блок занимает 3 КБ
+const size_t DISK_POSTING_BLOCK_SIZE = 256;
+
+// список документов слова в файле; все блоки, кроме последнего, полные
+struct DiskPostingList {
+    uint64_t offset = 0;
+    size_t posting_count = 0;
+    // последний порядковый номер каждого блока: по ним курсор пропускает блоки, не читая их
+    std::vector<int> block_last_ordinals;
+
+    size_t GetBlockCount() const;
+    size_t GetBlockSize(size_t block) const;
+    uint64_t GetBlockOffset(size_t block) const;
+};
+
+// записывает файл индекса; документы добавляются по возрастанию порядковых номеров, списки документов --
+// по возрастанию номеров, файл готов только после Finish
+class DiskIndexWriter {
+public:
+    explicit DiskIndexWriter(const std::string& path);
+
+    void AddStopWord(std::string_view word);
+    void AddDocument(int document_id, DocumentStatus status, int rating, double inv_word_count);
+    void AddPostingList(std::string_view word, const std::vector<int>& ordinals, const std::vector<double>& term_freqs);
+    // total_word_count -- суммарное число слов документов, по нему вычисляется средняя длина документа
+    void Finish(long long total_word_count);
+
+private:
+    struct DocumentInfo {
+        int id;
+        DocumentStatus status;
+        int rating;
+        double inv_word_count;
+    };
+
+    std::string path_;
+    std::ofstream output_;
+    uint64_t offset_ = 0;
+    std::vector<std::string> stop_words_;
+    std::vector<DocumentInfo> documents_;
+    std::vector<std::pair<std::string, DiskPostingList>> dictionary_;
+
+    void Write(const void* data, size_t size);
+};
+
+// показатели кэша блоков списков документов
+struct PostingCacheStats {
+    // запросы блоков, найденных в кэше и прочитанных с диска
+    size_t hits = 0;
+    size_t misses = 0;
+    // блоки, прочитанные с упреждением вслед за запрошенным, и те из них, которые потом были запрошены
+    size_t prefetched_blocks = 0;
+    size_t prefetch_hits = 0;
+    size_t evictions = 0;
+    // обращения к файлу и прочитанные байты
+    size_t read_count = 0;
+    size_t read_bytes = 0;
+
+    double GetHitRate() const;
+};
+
+// кэш блоков списков документов ограниченного размера с вытеснением CLOCK: у каждого блока есть бит обращения,
+// стрелка обходит блоки по кругу, снимает биты и вытесняет первый блок без бита; блоки, прочитанные с упреждением,
+// попадают в кэш без бита и вытесняются первыми, если к ним так и не обратились
+// емкость ограничивает память под данные блоков: короткий последний блок списка занимает меньше полного
+// при промахе вместе с запрошенным блоком одним чтением читаются до prefetch_blocks следующих блоков того же
+// списка, которых нет в кэше; упреждающее чтение ядра для файла выключено -- кэш читает с упреждением сам
+// блок закреплен, пока жив Handle, и не вытесняется; если закреплены все блоки, запрошенный блок
+// помещается в кэш сверх емкости
+// безопасен для одновременных запросов из разных потоков: слоты занимаются и закрепляются под блокировкой кэша,
+// а блоки читаются с диска без нее, поэтому промахи разных потоков читают одновременно; поток, которому нужен
+// блок, читаемый другим потоком, ждет только этот блок
+class PostingBlockCache {
+public:
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        ~Handle();
+
+        size_t size() const;
+        const double* GetTermFreqs() const;
+        const int* GetOrdinals() const;
+
+    private:
+        friend class PostingBlockCache;
+
+        PostingBlockCache* cache_ = nullptr;
+        size_t slot_ = 0;
+        size_t size_ = 0;
+        const double* term_freqs_ = nullptr;
+        const int* ordinals_ = nullptr;
+
+        void Release();
+    };
+
+    PostingBlockCache(const std::string& path, size_t capacity_bytes, size_t prefetch_blocks);
+    ~PostingBlockCache();
+
+    PostingBlockCache(const PostingBlockCache&) = delete;
+    PostingBlockCache& operator=(const PostingBlockCache&) = delete;
+
+    Handle Acquire(const DiskPostingList& postings, size_t block);
+
+    PostingCacheStats GetStats() const;
+    // вытесняет все незакрепленные блоки и обнуляет показатели
+    void Clear();
+    MemoryUsage GetMemoryUsage() const;
+
+private:
+    enum class SlotState {
+        LOADING,
+        LOADED,
+        // чтение или проверка блока не удались: запросы блока получают ту же ошибку, пока слот не отпустят все,
+        // кто его закрепил
+        FAILED,
+    };
+
+    struct Slot {
+        // смещение блока в файле, UINT64_MAX -- слот свободен
+        uint64_t offset = UINT64_MAX;
+        size_t size = 0;
+        int pin_count = 0;
+        SlotState state = SlotState::LOADED;
+        std::exception_ptr error;
+        bool is_referenced = false;
+        bool is_prefetched = false;
+        // частоты, затем порядковые номера: массив double выравнивает частоты
+        std::vector<double> data;
+    };
+
+    std::string path_;
+    mutable std::mutex mutex_;
+    // сообщает о завершении чтения блоков
+    std::condition_variable slot_loaded_;
+    // дескриптор файла для pread; на платформах без него файл читается потоком под отдельной блокировкой
+    int fd_ = -1;
+    std::ifstream input_;
+    std::mutex input_mutex_;
+    size_t capacity_bytes_;
+    size_t prefetch_blocks_;
+    size_t used_bytes_ = 0;
+    // слоты не перемещаются, поэтому Handle хранит указатели на их данные
+    std::deque<Slot> slots_;
+    std::vector<size_t> free_slots_;
+    std::unordered_map<uint64_t, size_t> offset_to_slot_;
+    size_t clock_hand_ = 0;
+    PostingCacheStats stats_;
+
+    size_t AllocateSlot(size_t size, bool may_exceed);
+    bool EvictSlot();
+    void FreeSlot(size_t slot_index);
+    // читает блоки без блокировки кэша, возвращает число обращений к файлу
+    size_t ReadBlocks(uint64_t offset, const std::vector<Slot*>& slots);
+    // std::invalid_argument, если порядковые номера блока не возрастают или не сходятся с последними номерами
+    // блоков из словаря
+    void CheckBlock(const DiskPostingList& postings, size_t block, const Slot& slot) const;
+    void Unpin(size_t slot);
+    // то же под уже взятой блокировкой; слот с неудачным чтением освобождается вместе с последним закреплением
+    void ReleasePin(size_t slot);
+};
+
+// курсор по списку документов на диске; блоки читаются через кэш по мере продвижения
+class DiskPostingCursor {
+public:
+    static constexpr int END_ORDINAL = std::numeric_limits<int>::max();
+
+    DiskPostingCursor(PostingBlockCache& cache, const DiskPostingList& postings);
+
+    // текущий порядковый номер, END_ORDINAL -- список пройден
+    int GetOrdinal() const;
+    double GetTermFreq() const;
+    void Next();
+    // переходит к первому документу с номером не меньше ordinal; блоки, целиком лежащие раньше, не читаются
+    void SeekTo(int ordinal);
+
+private:
+    PostingBlockCache* cache_;
+    const DiskPostingList* postings_;
+    size_t block_ = 0;
+    size_t position_ = 0;
+    PostingBlockCache::Handle handle_;
+
+    void LoadBlock(size_t block);
+};
+
+struct DiskSearchOptions {
+    // размер кэша блоков списков документов
+    size_t cache_bytes = 64 << 20;
+    // сколько следующих блоков списка читается вместе с блоком, которого нет в кэше
+    size_t prefetch_blocks = 4;
+};
+
+// поиск по индексу на диске, только для чтения; выдача FindTopDocuments совпадает с выдачей сервера, записавшего
+// индекс, для тех же запросов (без нечеткого поиска): списки документов сливаются документ за документом,
+// вклады слов суммируются в порядке запроса, минус-слова и обязательные слова проверяются курсорами по их спискам
+class DiskSearchServer {
+public:
+    explicit DiskSearchServer(const std::string& path, const DiskSearchOptions& options = {});
+
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    // память в разбивке SearchServer::GetMemoryStats: postings -- кэш блоков, прямого индекса нет
+    MemoryStats GetMemoryStats() const;
+    PostingCacheStats GetCacheStats() const;
+    void ClearCache();
+
+private:
+    struct Query {
+        std::vector<std::string_view> plus_words;
+        std::vector<std::string_view> minus_words;
+        std::vector<std::string_view> required_words;
+    };
+
+    StopWordSet stop_words_;
+    std::map<std::string, DiskPostingList, std::less<>> word_to_postings_;
+    std::vector<int> ordinal_to_document_id_;
+    std::vector<DocumentStatus> document_statuses_;
+    std::vector<int> document_ratings_;
+    std::vector<double> document_inv_word_counts_;
+    long long total_word_count_ = 0;
+    mutable PostingBlockCache cache_;
+
+    Query ParseQuery(const std::string_view raw_query) const;
+    const DiskPostingList* FindPostings(std::string_view word) const;
+    CollectionStatistics GetCollectionStatistics() const;
+};
+
+template <typename Scorer, typename DocumentPredicate>
+std::vector<Document> DiskSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const Query query = ParseQuery(raw_query);
+    const Scorer scorer(GetCollectionStatistics());
+
+    struct PlusTerm {
+        DiskPostingCursor cursor;
+        double inverse_document_freq;
+        bool is_required;
+    };
+    std::vector<PlusTerm> plus_terms;
+    size_t required_count = 0;
+    for (const std::string_view word : query.plus_words) {
+        const bool is_required = std::binary_search(query.required_words.begin(), query.required_words.end(), word);
+        const DiskPostingList* postings = FindPostings(word);
+        if (postings == nullptr) {
+            if (is_required) {
+                return {};
+            }
+            continue;
+        }
+        plus_terms.push_back({DiskPostingCursor(cache_, *postings), scorer.ComputeInverseDocumentFreq(postings->posting_count), is_required});
+        required_count += is_required;
+    }
+    std::vector<DiskPostingCursor> minus_cursors;
+    for (const std::string_view word : query.minus_words) {
+        if (const DiskPostingList* postings = FindPostings(word)) {
+            minus_cursors.emplace_back(cache_, *postings);
+        }
+    }
+
+    std::vector<Document> matched_documents;
+    while (true) {
+        int ordinal = DiskPostingCursor::END_ORDINAL;
+        if (required_count == 0) {
+            for (const PlusTerm& term : plus_terms) {
+                ordinal = std::min(ordinal, term.cursor.GetOrdinal());
+            }
+        } else {
+            // курсоры обязательных слов догоняют друг друга, пока не встанут на один документ; остальные списки
+            // проверяются только на этих документах, и их блоки между ними не читаются
+            ordinal = 0;
+            for (const PlusTerm& term : plus_terms) {
+                if (term.is_required) {
+                    ordinal = std::max(ordinal, term.cursor.GetOrdinal());
+                }
+            }
+            for (bool is_aligned = false; !is_aligned && ordinal != DiskPostingCursor::END_ORDINAL;) {
+                is_aligned = true;
+                for (PlusTerm& term : plus_terms) {
+                    if (!term.is_required) {
+                        continue;
+                    }
+                    term.cursor.SeekTo(ordinal);
+                    if (term.cursor.GetOrdinal() != ordinal) {
+                        ordinal = term.cursor.GetOrdinal();
+                        is_aligned = false;
+                    }
+                }
+            }
+        }
+        if (ordinal == DiskPostingCursor::END_ORDINAL) {
+            break;
+        }
+        double relevance = 0.0;
+        for (PlusTerm& term : plus_terms) {
+            term.cursor.SeekTo(ordinal);
+            if (term.cursor.GetOrdinal() != ordinal) {
+                continue;
+            }
+            relevance += scorer.ComputeTermScore(term.cursor.GetTermFreq(), document_inv_word_counts_[ordinal], term.inverse_document_freq);
+            term.cursor.Next();
+        }
+        const bool is_excluded = std::any_of(minus_cursors.begin(), minus_cursors.end(), [ordinal](DiskPostingCursor& cursor) {
+            cursor.SeekTo(ordinal);
+            return cursor.GetOrdinal() == ordinal;
+        });
+        if (is_excluded || !document_predicate(ordinal_to_document_id_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal])) {
+            continue;
+        }
+        matched_documents.emplace_back(ordinal_to_document_id_[ordinal], relevance, document_ratings_[ordinal]);
+    }
+    SelectTopRanked(matched_documents, MAX_RESULT_DOCUMENT_COUNT);
+    return matched_documents;
+}
+
+template <typename Scorer>
+std::vector<Document> DiskSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments<Scorer>(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+template <typename Scorer>
+std::vector<Document> DiskSearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments<Scorer>(raw_query, DocumentStatus::ACTUAL);
+}
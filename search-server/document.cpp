@@ -1,7 +1,32 @@
 #include "document.h"
 
+#include <stdexcept>
+
 using namespace std;
 
+string_view GetDocumentStatusName(DocumentStatus status) {
+    switch (status) {
+    case DocumentStatus::ACTUAL:
+        return "ACTUAL"sv;
+    case DocumentStatus::IRRELEVANT:
+        return "IRRELEVANT"sv;
+    case DocumentStatus::BANNED:
+        return "BANNED"sv;
+    case DocumentStatus::REMOVED:
+        return "REMOVED"sv;
+    }
+    return "UNKNOWN"sv;
+}
+
+DocumentStatus ParseDocumentStatus(string_view name) {
+    for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED}) {
+        if (name == GetDocumentStatusName(status)) {
+            return status;
+        }
+    }
+    throw invalid_argument("Invalid status: "s + string(name));
+}
+
 Document::Document(int id, double relevance, int rating)
     : id(id)
     , relevance(relevance)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 
 // возможные статусы документов
 enum class DocumentStatus {
@@ -10,6 +11,10 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// имя статуса в текстовых форматах (протокол демона, файлы корпуса): ACTUAL, IRRELEVANT, BANNED, REMOVED
+std::string_view GetDocumentStatusName(DocumentStatus status);
+DocumentStatus ParseDocumentStatus(std::string_view name);
+
 // формат, в котором  возвращаются результаты поиска
 struct Document {
     Document() = default;
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "posting_intersection.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// множество документов, исключаемых из выдачи минус-словами запроса
+// проверяется прямо во время оценки документов, поэтому исключенные документы не оцениваются вовсе
+// способ хранения выбирается по размерам списков:
+// * список длиннее суммарной длины списков плюс-слов не копируется, а проверяется "лениво":
+//   двигаться по нему курсором дешевле, чем переписать его целиком;
+// * остальные списки объединяются в битовую карту, если они достаточно плотные,
+//   или в упорядоченный массив номеров, если разреженные
+template <typename Container>
+class ExclusionFilter {
+public:
+    ExclusionFilter(const std::vector<const Container*>& lists, size_t ordinal_count, size_t plus_postings_count) {
+        std::vector<const Container*> materialized_lists;
+        size_t materialized_count = 0;
+        for (const Container* list : lists) {
+            if (list->size() > plus_postings_count) {
+                lazy_lists_.push_back(list);
+            } else {
+                materialized_lists.push_back(list);
+                materialized_count += list->size();
+            }
+        }
+        if (materialized_count * BITMAP_DENSITY >= ordinal_count) {
+            bitmap_.assign((ordinal_count + 63) / 64, 0);
+            for (const Container* list : materialized_lists) {
+                for (const int ordinal : *list) {
+                    bitmap_[ordinal >> 6] |= uint64_t{1} << (ordinal & 63);
+                }
+            }
+        } else {
+            for (const Container* list : materialized_lists) {
+                sorted_ordinals_.insert(sorted_ordinals_.end(), list->begin(), list->end());
+            }
+            std::sort(sorted_ordinals_.begin(), sorted_ordinals_.end());
+        }
+    }
+
+    // проход по документам в порядке возрастания номеров: курсоры по спискам двигаются только вперед
+    class Scan {
+    public:
+        explicit Scan(const ExclusionFilter& filter)
+            : filter_(filter)
+            , lazy_positions_(filter.lazy_lists_.size(), 0) {
+        }
+
+        bool IsExcluded(int ordinal) {
+            if (!filter_.bitmap_.empty() && ((filter_.bitmap_[ordinal >> 6] >> (ordinal & 63)) & 1)) {
+                return true;
+            }
+            if (!filter_.sorted_ordinals_.empty() && Contains(filter_.sorted_ordinals_, sorted_position_, ordinal)) {
+                return true;
+            }
+            for (size_t i = 0; i < filter_.lazy_lists_.size(); ++i) {
+                if (Contains(*filter_.lazy_lists_[i], lazy_positions_[i], ordinal)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        template <typename Ordinals>
+        static bool Contains(const Ordinals& ordinals, size_t& position, int ordinal) {
+            position = AdvanceTo(ordinals, position, ordinal);
+            return position < ordinals.size() && ordinals[position] == ordinal;
+        }
+
+        const ExclusionFilter& filter_;
+        size_t sorted_position_ = 0;
+        std::vector<size_t> lazy_positions_;
+    };
+
+    // проверка в произвольном порядке номеров, без курсоров
+    bool Contains(int ordinal) const {
+        if (!bitmap_.empty() && ((bitmap_[ordinal >> 6] >> (ordinal & 63)) & 1)) {
+            return true;
+        }
+        if (std::binary_search(sorted_ordinals_.begin(), sorted_ordinals_.end(), ordinal)) {
+            return true;
+        }
+        for (const Container* list : lazy_lists_) {
+            if (std::binary_search(list->begin(), list->end(), ordinal)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool IsEmpty() const {
+        return bitmap_.empty() && sorted_ordinals_.empty() && lazy_lists_.empty();
+    }
+
+private:
+    // битовая карта выгоднее массива, если исключается хотя бы один документ из BITMAP_DENSITY
+    static constexpr size_t BITMAP_DENSITY = 64;
+
+    std::vector<uint64_t> bitmap_;
+    std::vector<int> sorted_ordinals_;
+    std::vector<const Container*> lazy_lists_;
+};
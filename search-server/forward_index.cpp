@@ -0,0 +1,200 @@
+#include "forward_index.h"
+
+#include "search_server.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+WordFrequencies::WordFrequencies(const int* term_ids, const double* term_freqs, size_t size, const string_view* term_words,
+    const SearchServer* server)
+    : term_ids_(term_ids)
+    , term_freqs_(term_freqs)
+    , size_(size)
+    , term_words_(term_words)
+    , server_(server) {
+}
+
+size_t WordFrequencies::size() const {
+    return size_;
+}
+
+bool WordFrequencies::empty() const {
+    return size_ == 0;
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    return Iterator(term_ids_, term_freqs_, term_words_);
+}
+
+WordFrequencies::Iterator WordFrequencies::end() const {
+    return Iterator(term_ids_ + size_, term_freqs_ + size_, term_words_);
+}
+
+WordFrequencies::Iterator WordFrequencies::find(string_view word) const {
+    if (size_ == 0) {
+        return end();
+    }
+    const int term_id = server_->FindTermId(word);
+    if (term_id < 0) {
+        return end();
+    }
+    const int* term_ids_end = term_ids_ + size_;
+    const int* it = lower_bound(term_ids_, term_ids_end, term_id);
+    if (it == term_ids_end || *it != term_id) {
+        return end();
+    }
+    return Iterator(it, term_freqs_ + (it - term_ids_), term_words_);
+}
+
+size_t WordFrequencies::count(string_view word) const {
+    return find(word) != end();
+}
+
+double WordFrequencies::at(string_view word) const {
+    const auto it = find(word);
+    if (it == end()) {
+        throw out_of_range("Word not found in document"s);
+    }
+    return (*it).second;
+}
+
+// виды одного сервера сравниваются по номерам слов без обращения к словарю
+bool operator==(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    if (lhs.server_ == rhs.server_) {
+        return equal(lhs.term_ids_, lhs.term_ids_ + lhs.size_, rhs.term_ids_)
+            && equal(lhs.term_freqs_, lhs.term_freqs_ + lhs.size_, rhs.term_freqs_);
+    }
+    for (const auto [word, term_freq] : lhs) {
+        const auto it = rhs.find(word);
+        if (it == rhs.end() || (*it).second != term_freq) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool operator!=(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    return !(lhs == rhs);
+}
+
+ForwardIndex::ForwardIndex(pmr::memory_resource* resource)
+    : term_ids_(resource)
+    , term_freqs_(resource)
+    , offsets_(resource)
+    , sizes_(resource) {
+}
+
+size_t ForwardIndex::GetDocumentCount() const {
+    return offsets_.size();
+}
+
+void ForwardIndex::AddDocument(const vector<pair<int, double>>& terms) {
+    offsets_.push_back(term_ids_.size());
+    sizes_.push_back(static_cast<uint32_t>(terms.size()));
+    for (const auto& [term_id, term_freq] : terms) {
+        term_ids_.push_back(term_id);
+        term_freqs_.push_back(term_freq);
+    }
+}
+
+// слова, которые помещаются на место прежних, записываются поверх них, остальные -- в конец массивов
+void ForwardIndex::ReplaceDocument(int ordinal, const vector<pair<int, double>>& terms) {
+    if (terms.size() > sizes_[ordinal]) {
+        unused_count_ += sizes_[ordinal];
+        offsets_[ordinal] = term_ids_.size();
+        term_ids_.resize(term_ids_.size() + terms.size());
+        term_freqs_.resize(term_freqs_.size() + terms.size());
+    } else {
+        unused_count_ += sizes_[ordinal] - terms.size();
+    }
+    sizes_[ordinal] = static_cast<uint32_t>(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        term_ids_[offsets_[ordinal] + i] = terms[i].first;
+        term_freqs_[offsets_[ordinal] + i] = terms[i].second;
+    }
+    if (unused_count_ > term_ids_.size() / 2) {
+        vector<int> new_ordinals(offsets_.size());
+        iota(new_ordinals.begin(), new_ordinals.end(), 0);
+        Compact(new_ordinals);
+    }
+}
+
+// документы переписываются в новые массивы в порядке новых номеров
+void ForwardIndex::Compact(const vector<int>& new_ordinals) {
+    if (offsets_.empty()) {
+        return;
+    }
+    const size_t live_count = count_if(new_ordinals.begin(), new_ordinals.end(), [](int ordinal) {
+        return ordinal >= 0;
+    });
+    pmr::vector<int> term_ids(term_ids_.get_allocator());
+    pmr::vector<double> term_freqs(term_freqs_.get_allocator());
+    term_ids.reserve(term_ids_.size() - unused_count_);
+    term_freqs.reserve(term_freqs_.size() - unused_count_);
+    pmr::vector<size_t> offsets(live_count, 0, offsets_.get_allocator());
+    pmr::vector<uint32_t> sizes(live_count, 0, sizes_.get_allocator());
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        const int new_ordinal = new_ordinals[ordinal];
+        if (new_ordinal < 0) {
+            continue;
+        }
+        offsets[new_ordinal] = term_ids.size();
+        sizes[new_ordinal] = sizes_[ordinal];
+        term_ids.insert(term_ids.end(), term_ids_.begin() + offsets_[ordinal], term_ids_.begin() + offsets_[ordinal] + sizes_[ordinal]);
+        term_freqs.insert(term_freqs.end(), term_freqs_.begin() + offsets_[ordinal], term_freqs_.begin() + offsets_[ordinal] + sizes_[ordinal]);
+    }
+    term_ids_.swap(term_ids);
+    term_freqs_.swap(term_freqs);
+    offsets_.swap(offsets);
+    sizes_.swap(sizes);
+    unused_count_ = 0;
+}
+
+void ForwardIndex::Clear() {
+    term_ids_ = pmr::vector<int>(term_ids_.get_allocator());
+    term_freqs_ = pmr::vector<double>(term_freqs_.get_allocator());
+    offsets_ = pmr::vector<size_t>(offsets_.get_allocator());
+    sizes_ = pmr::vector<uint32_t>(sizes_.get_allocator());
+    unused_count_ = 0;
+}
+
+size_t ForwardIndex::GetTermCount(int ordinal) const {
+    return sizes_[ordinal];
+}
+
+const int* ForwardIndex::GetTermIds(int ordinal) const {
+    return term_ids_.data() + offsets_[ordinal];
+}
+
+const double* ForwardIndex::GetTermFreqs(int ordinal) const {
+    return term_freqs_.data() + offsets_[ordinal];
+}
+
+const double* ForwardIndex::FindTermFreq(int ordinal, int term_id) const {
+    const int* begin = GetTermIds(ordinal);
+    const int* end = begin + sizes_[ordinal];
+    const int* it = lower_bound(begin, end, term_id);
+    if (it == end || *it != term_id) {
+        return nullptr;
+    }
+    return GetTermFreqs(ordinal) + (it - begin);
+}
+
+MemoryUsage ForwardIndex::GetMemoryStats() const {
+    MemoryUsage usage = GetVectorMemoryUsage(term_ids_);
+    usage += GetVectorMemoryUsage(term_freqs_);
+    usage += GetVectorMemoryUsage(offsets_);
+    usage += GetVectorMemoryUsage(sizes_);
+    // неиспользуемые элементы -- накладные расходы
+    const size_t unused_bytes = unused_count_ * (sizeof(int) + sizeof(double));
+    usage.payload_bytes -= unused_bytes;
+    usage.overhead_bytes += unused_bytes;
+    return usage;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class SearchServer;
+
+// частоты слов одного документа: вид на прямой индекс сервера, ничего не копирует
+// слова перечисляются по возрастанию их номеров в словаре сервера, поэтому одинаковые наборы слов
+// перечисляются одинаково; слово ищется по словарю сервера один раз, а затем его номер -- двоичным поиском
+// среди упорядоченных номеров слов документа
+// вид действителен до следующего изменения сервера
+class WordFrequencies {
+public:
+    using value_type = std::pair<std::string_view, double>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = WordFrequencies::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const int* term_id, const double* term_freq, const std::string_view* term_words)
+            : term_id_(term_id)
+            , term_freq_(term_freq)
+            , term_words_(term_words) {
+        }
+
+        value_type operator*() const {
+            return {term_words_[*term_id_], *term_freq_};
+        }
+
+        Iterator& operator++() {
+            ++term_id_;
+            ++term_freq_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return term_id_ == other.term_id_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return term_id_ != other.term_id_;
+        }
+
+    private:
+        // итератор не ссылается на вид и остается действительным вместе с прямым индексом
+        const int* term_id_;
+        const double* term_freq_;
+        const std::string_view* term_words_;
+    };
+
+    WordFrequencies() = default;
+    // term_words -- слова словаря по номерам; по словарю server слово переводится в номер
+    WordFrequencies(const int* term_ids, const double* term_freqs, size_t size, const std::string_view* term_words,
+        const SearchServer* server);
+
+    size_t size() const;
+    bool empty() const;
+    Iterator begin() const;
+    Iterator end() const;
+
+    Iterator find(std::string_view word) const;
+    size_t count(std::string_view word) const;
+    // частота слова; std::out_of_range, если слова в документе нет
+    double at(std::string_view word) const;
+
+private:
+    const int* term_ids_ = nullptr;
+    const double* term_freqs_ = nullptr;
+    size_t size_ = 0;
+    const std::string_view* term_words_ = nullptr;
+    const SearchServer* server_ = nullptr;
+
+    friend bool operator==(const WordFrequencies& lhs, const WordFrequencies& rhs);
+};
+
+// одинаковые наборы слов с одинаковыми частотами; виды могут относиться к разным серверам
+bool operator==(const WordFrequencies& lhs, const WordFrequencies& rhs);
+bool operator!=(const WordFrequencies& lhs, const WordFrequencies& rhs);
+
+// прямой индекс: номера слов каждого документа с частотами
+// слова всех документов лежат подряд в двух общих массивах, номера и частоты отдельно: 12 байт на слово
+// документа вместо узла дерева; документ ordinal занимает sizes_[ordinal] элементов начиная с offsets_[ordinal],
+// слова документа упорядочены по номеру
+// слова удаленных документов остаются до уплотнения сервера, а прежние слова замененных документов -- до уплотнения
+// самого индекса, которое запускается, когда неиспользуемых элементов становится больше половины
+class ForwardIndex {
+public:
+    explicit ForwardIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // число порядковых номеров, включая удаленные документы
+    size_t GetDocumentCount() const;
+
+    // добавляет документ со следующим порядковым номером; terms -- пары (номер слова, частота) по возрастанию номера
+    void AddDocument(const std::vector<std::pair<int, double>>& terms);
+    // заменяет слова документа
+    void ReplaceDocument(int ordinal, const std::vector<std::pair<int, double>>& terms);
+    // переносит документы на новые номера (-1 -- документ удален) и убирает неиспользуемые элементы
+    void Compact(const std::vector<int>& new_ordinals);
+    void Clear();
+
+    size_t GetTermCount(int ordinal) const;
+    const int* GetTermIds(int ordinal) const;
+    const double* GetTermFreqs(int ordinal) const;
+    // частота слова term_id в документе; nullptr, если слова в документе нет
+    const double* FindTermFreq(int ordinal, int term_id) const;
+
+    MemoryUsage GetMemoryStats() const;
+
+private:
+    std::pmr::vector<int> term_ids_;
+    std::pmr::vector<double> term_freqs_;
+    std::pmr::vector<size_t> offsets_;
+    std::pmr::vector<uint32_t> sizes_;
+    // элементы, не принадлежащие ни одному документу
+    size_t unused_count_ = 0;
+};
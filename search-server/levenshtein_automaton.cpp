@@ -0,0 +1,155 @@
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LevenshteinAutomaton::LevenshteinAutomaton(u32string symbols, int max_distance, size_t prefix_length, int prefix_max_distance)
+    : symbols_(move(symbols))
+    , alphabet_(symbols_)
+    , max_distance_(max_distance)
+    , prefix_length_(min(prefix_length, symbols_.size()))
+    , prefix_max_distance_(prefix_max_distance) {
+    sort(alphabet_.begin(), alphabet_.end());
+    alphabet_.erase(unique(alphabet_.begin(), alphabet_.end()), alphabet_.end());
+    small_symbol_classes_.assign(SMALL_SYMBOL_COUNT, static_cast<uint32_t>(alphabet_.size()));
+    for (size_t symbol_class = 0; symbol_class < alphabet_.size() && alphabet_[symbol_class] < SMALL_SYMBOL_COUNT; ++symbol_class) {
+        small_symbol_classes_[alphabet_[symbol_class]] = static_cast<uint32_t>(symbol_class);
+    }
+    // начальное состояние: расстояние от пустой строки до каждого префикса слова
+    row_buffer_.resize(symbols_.size() + 2);
+    for (size_t i = 0; i <= symbols_.size(); ++i) {
+        row_buffer_[i] = static_cast<char>(min(static_cast<int>(i), max_distance_ + 1));
+    }
+    row_buffer_.back() = row_buffer_[prefix_length_] <= prefix_max_distance_;
+    AddState(row_buffer_);
+}
+
+size_t LevenshteinAutomaton::GetLargeSymbolClass(char32_t symbol) const {
+    const auto it = lower_bound(alphabet_.begin(), alphabet_.end(), symbol);
+    return it != alphabet_.end() && *it == symbol ? it - alphabet_.begin() : alphabet_.size();
+}
+
+// переход по классу символа; при первом переходе пересчитывается строка матрицы расстояний
+LevenshteinAutomaton::State LevenshteinAutomaton::StepClass(State state, size_t symbol_class) {
+    const size_t transition = state * (alphabet_.size() + 1) + symbol_class;
+    if (transitions_[transition] >= 0) {
+        return transitions_[transition];
+    }
+    // символ класса "любой другой" не совпадает ни с одним символом слова
+    const char32_t symbol = symbol_class < alphabet_.size() ? alphabet_[symbol_class] : 0;
+    const bool is_other = symbol_class == alphabet_.size();
+    const size_t row_size = symbols_.size() + 1;
+    const char* row = rows_.data() + state * (row_size + 1);
+    const int limit = max_distance_ + 1;
+    row_buffer_[0] = static_cast<char>(min(row[0] + 1, limit));
+    for (size_t i = 1; i < row_size; ++i) {
+        const int replace_cost = row[i - 1] + (!is_other && symbols_[i - 1] == symbol ? 0 : 1);
+        row_buffer_[i] = static_cast<char>(min({replace_cost, row[i] + 1, row_buffer_[i - 1] + 1, limit}));
+    }
+    row_buffer_.back() = row[row_size] || row_buffer_[prefix_length_] <= prefix_max_distance_;
+    // AddState может перераспределить таблицу переходов, поэтому переход записывается после
+    const State next = AddState(row_buffer_);
+    transitions_[transition] = next;
+    return next;
+}
+
+// ячейка таблицы состояний, в которой лежит состояние со строкой row, или пустая ячейка, куда его можно добавить
+size_t LevenshteinAutomaton::FindStateSlot(const string& row) const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char value : row) {
+        hash = (hash ^ static_cast<unsigned char>(value)) * 1099511628211ULL;
+    }
+    const size_t mask = state_slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const State state = state_slots_[slot];
+        if (state < 0 || rows_.compare(state * row.size(), row.size(), row) == 0) {
+            return slot;
+        }
+    }
+}
+
+// до прочтения префикса продолжение возможно, только пока какой-то префикс прочитанного слова близок
+// к началу исходного
+LevenshteinAutomaton::State LevenshteinAutomaton::AddState(const string& row) {
+    // таблица заполнена не больше чем наполовину
+    if ((can_match_.size() + 1) * 2 > state_slots_.size()) {
+        state_slots_.assign(max<size_t>(16, state_slots_.size() * 2), -1);
+        string state_row;
+        for (State state = 0; state < static_cast<State>(can_match_.size()); ++state) {
+            state_row.assign(rows_, state * row.size(), row.size());
+            state_slots_[FindStateSlot(state_row)] = state;
+        }
+    }
+    const size_t slot = FindStateSlot(row);
+    if (state_slots_[slot] >= 0) {
+        return state_slots_[slot];
+    }
+    const State state = static_cast<State>(can_match_.size());
+    state_slots_[slot] = state;
+    rows_ += row;
+    transitions_.resize(transitions_.size() + alphabet_.size() + 1, -1);
+    const auto distances_end = row.begin() + symbols_.size() + 1;
+    const bool has_prefix = row.back() || *min_element(row.begin(), row.begin() + prefix_length_ + 1) <= prefix_max_distance_;
+    can_match_.push_back(has_prefix && *min_element(row.begin(), distances_end) <= max_distance_);
+    return state;
+}
+
+// декодирует один символ UTF-8; некорректные байты считаются отдельными символами
+pair<char32_t, size_t> DecodeUtf8(const string_view text) {
+    const auto lead = static_cast<unsigned char>(text[0]);
+    size_t length = 1;
+    char32_t symbol = lead;
+    if (lead >= 0xF0) {
+        length = 4;
+        symbol = lead & 0x07;
+    } else if (lead >= 0xE0) {
+        length = 3;
+        symbol = lead & 0x0F;
+    } else if (lead >= 0xC0) {
+        length = 2;
+        symbol = lead & 0x1F;
+    }
+    if (length > text.size()) {
+        return {lead, 1};
+    }
+    for (size_t i = 1; i < length; ++i) {
+        const auto byte = static_cast<unsigned char>(text[i]);
+        if ((byte & 0xC0) != 0x80) {
+            return {lead, 1};
+        }
+        symbol = (symbol << 6) | (byte & 0x3F);
+    }
+    return {symbol, length};
+}
+
+u32string DecodeUtf8String(string_view text) {
+    u32string result;
+    while (!text.empty()) {
+        const auto [symbol, length] = DecodeUtf8(text);
+        result.push_back(symbol);
+        text.remove_prefix(length);
+    }
+    return result;
+}
+
+string EncodeUtf8(char32_t symbol) {
+    string result;
+    if (symbol < 0x80) {
+        result.push_back(static_cast<char>(symbol));
+    } else if (symbol < 0x800) {
+        result.push_back(static_cast<char>(0xC0 | (symbol >> 6)));
+        result.push_back(static_cast<char>(0x80 | (symbol & 0x3F)));
+    } else if (symbol < 0x10000) {
+        result.push_back(static_cast<char>(0xE0 | (symbol >> 12)));
+        result.push_back(static_cast<char>(0x80 | ((symbol >> 6) & 0x3F)));
+        result.push_back(static_cast<char>(0x80 | (symbol & 0x3F)));
+    } else {
+        result.push_back(static_cast<char>(0xF0 | ((symbol >> 18) & 0x07)));
+        result.push_back(static_cast<char>(0x80 | ((symbol >> 12) & 0x3F)));
+        result.push_back(static_cast<char>(0x80 | ((symbol >> 6) & 0x3F)));
+        result.push_back(static_cast<char>(0x80 | (symbol & 0x3F)));
+    }
+    return result;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// автомат Левенштейна: принимает все слова, отстоящие от заданного не более чем на max_distance правок
+// состояние автомата -- строка матрицы расстояний, значения ограничены сверху max_distance + 1,
+// поэтому "мертвые" состояния (из которых допускающее уже недостижимо) определяются сразу
+// автомат детерминированный: различные строки матрицы нумеруются, а переходы между ними запоминаются в таблице
+// по классам символов (символы слова и "любой другой"), так что строка пересчитывается только при первом
+// переходе, а дальше шаг -- поиск класса символа и чтение таблицы без выделения памяти
+// таблица достраивается по мере обхода, поэтому Step не константный; автомат строится на одно слово запроса
+// prefix_length и prefix_max_distance дополнительно ограничивают правки в начале слова: принимаются только слова,
+// у которых есть префикс на расстоянии не больше prefix_max_distance от первых prefix_length символов исходного;
+// состояние тогда хранит еще и признак того, что такой префикс уже прочитан
+class LevenshteinAutomaton {
+public:
+    using State = int;
+
+    LevenshteinAutomaton(std::u32string symbols, int max_distance, size_t prefix_length = 0, int prefix_max_distance = 0);
+
+    // переходы выполняются для каждого символа обходимых слов, поэтому частые операции определены здесь же,
+    // чтобы встраиваться в обход
+    State Start() const {
+        return 0;
+    }
+
+    State Step(State state, char32_t symbol) {
+        const size_t symbol_class = GetSymbolClass(symbol);
+        const State next = transitions_[state * (alphabet_.size() + 1) + symbol_class];
+        return next >= 0 ? next : StepClass(state, symbol_class);
+    }
+
+    // можно ли из состояния дойти до допускающего
+    bool CanMatch(State state) const {
+        return can_match_[state];
+    }
+
+    // можно ли из состояния дойти до допускающего по символу, которого нет в слове; если нельзя, дальше
+    // годятся только символы слова (GetAlphabet)
+    bool CanMatchOtherSymbols(State state) {
+        return CanMatch(StepClass(state, alphabet_.size()));
+    }
+
+    // различные символы слова по возрастанию
+    const std::u32string& GetAlphabet() const {
+        return alphabet_;
+    }
+
+    // является ли состояние допускающим
+    bool IsMatch(State state) const {
+        const char* row = rows_.data() + state * (symbols_.size() + 2);
+        return row[symbols_.size()] <= max_distance_ && row[symbols_.size() + 1];
+    }
+
+    // расстояние от прочитанного слова до исходного (имеет смысл только для допускающего состояния)
+    int Distance(State state) const {
+        return rows_[state * (symbols_.size() + 2) + symbols_.size()];
+    }
+
+private:
+    // номер класса символа: позиция в alphabet_ или alphabet_.size() для символов, которых нет в слове
+    size_t GetSymbolClass(char32_t symbol) const {
+        if (symbol < SMALL_SYMBOL_COUNT) {
+            return small_symbol_classes_[symbol];
+        }
+        return GetLargeSymbolClass(symbol);
+    }
+    size_t GetLargeSymbolClass(char32_t symbol) const;
+    State StepClass(State state, size_t symbol_class);
+    State AddState(const std::string& row);
+    size_t FindStateSlot(const std::string& row) const;
+
+    std::u32string symbols_;
+    // различные символы слова по возрастанию; переходы по всем остальным символам одинаковы
+    std::u32string alphabet_;
+    int max_distance_;
+    size_t prefix_length_;
+    int prefix_max_distance_;
+    // строки матрицы состояний подряд, по symbols_.size() + 1 значений и признаку прочитанного префикса
+    std::string rows_;
+    // переходы: alphabet_.size() + 1 на состояние, -1 -- еще не вычислен
+    std::vector<State> transitions_;
+    std::vector<uint8_t> can_match_;
+    // номера состояний по хешу строки матрицы с открытой адресацией; -1 -- пустая ячейка
+    // обход одного слова запроса строит десятки состояний и почти каждый переход вычисляет впервые, поэтому
+    // поиск состояния не выделяет память, как выделял бы ключ-строка в std::unordered_map
+    std::vector<State> state_slots_;
+    std::string row_buffer_;
+    // классы символов латиницы и кириллицы ищутся по таблице, остальных -- двоичным поиском по alphabet_
+    static constexpr char32_t SMALL_SYMBOL_COUNT = 0x500;
+    std::vector<uint32_t> small_symbol_classes_;
+};
+
+// декодирует один символ UTF-8 с начала text, возвращает символ и длину его записи в байтах
+std::pair<char32_t, size_t> DecodeUtf8(const std::string_view text);
+
+// раскладывает строку UTF-8 на символы
+std::u32string DecodeUtf8String(std::string_view text);
+
+// записывает символ в UTF-8
+std::string EncodeUtf8(char32_t symbol);
@@ -0,0 +1,277 @@
+// нагрузочный клиент для search-server-daemon: наполняет сервер случайными документами,
+// затем отправляет поисковые запросы из нескольких соединений, держа в каждом до pipeline
+// неотвеченных запросов, и выводит пропускную способность и перцентили задержки
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    string host = "127.0.0.1"s;
+    uint16_t port = 7000;
+    string unix_socket_path;
+    size_t connections = 4;
+    size_t requests = 100'000;
+    size_t pipeline = 16;
+    size_t documents = 10'000;
+    size_t document_words = 70;
+    size_t query_words = 5;
+};
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+int Connect(const Options& options) {
+    int fd = -1;
+    if (!options.unix_socket_path.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, options.unix_socket_path.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("connect");
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+            throw invalid_argument("Invalid host address: "s + options.host);
+        }
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("connect");
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+    return fd;
+}
+
+void SendAll(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t size = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("send");
+        }
+        sent += size;
+    }
+}
+
+// читает ответы построчно
+class LineReader {
+public:
+    explicit LineReader(int fd)
+        : fd_(fd) {
+    }
+
+    string ReadLine() {
+        while (true) {
+            const size_t end = buffer_.find('\n', offset_);
+            if (end != string::npos) {
+                string line = buffer_.substr(offset_, end - offset_);
+                offset_ = end + 1;
+                return line;
+            }
+            buffer_.erase(0, offset_);
+            offset_ = 0;
+            char chunk[1 << 16];
+            const ssize_t size = recv(fd_, chunk, sizeof(chunk), 0);
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0) {
+                throw runtime_error("Connection closed by server"s);
+            }
+            buffer_.append(chunk, size);
+        }
+    }
+
+private:
+    int fd_;
+    string buffer_;
+    size_t offset_ = 0;
+};
+
+struct RunResult {
+    vector<int64_t> latencies_us;
+    size_t errors = 0;
+};
+
+// отправляет запросы, держа в соединении не больше pipeline неотвеченных
+RunResult RunPipelined(const Options& options, const vector<string>& requests, size_t pipeline) {
+    RunResult result;
+    result.latencies_us.reserve(requests.size());
+    const int fd = Connect(options);
+    LineReader reader(fd);
+    deque<Clock::time_point> send_times;
+    size_t next_request = 0;
+    while (result.latencies_us.size() < requests.size()) {
+        string batch;
+        while (next_request < requests.size() && send_times.size() < pipeline) {
+            batch += requests[next_request++];
+            batch += '\n';
+            send_times.push_back(Clock::now());
+        }
+        if (!batch.empty()) {
+            SendAll(fd, batch);
+        }
+        const string response = reader.ReadLine();
+        const auto latency = Clock::now() - send_times.front();
+        send_times.pop_front();
+        result.latencies_us.push_back(chrono::duration_cast<chrono::microseconds>(latency).count());
+        if (response.compare(0, 2, "OK"s) != 0) {
+            ++result.errors;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution(int('a'), int('z'))(generator));
+    }
+    return word;
+}
+
+string GenerateText(mt19937& generator, const vector<string>& dictionary, size_t word_count, double minus_prob) {
+    string text;
+    for (size_t i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        text += dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+    }
+    return text;
+}
+
+int64_t Percentile(const vector<int64_t>& sorted_values, double percentile) {
+    if (sorted_values.empty()) {
+        return 0;
+    }
+    const size_t index = min(sorted_values.size() - 1, static_cast<size_t>(percentile / 100.0 * sorted_values.size()));
+    return sorted_values[index];
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string argument = argv[i];
+        const string value = argv[i + 1];
+        if (argument == "--host"s) {
+            options.host = value;
+        } else if (argument == "--port"s) {
+            options.port = static_cast<uint16_t>(stoi(value));
+        } else if (argument == "--unix"s) {
+            options.unix_socket_path = value;
+        } else if (argument == "--connections"s) {
+            options.connections = stoul(value);
+        } else if (argument == "--requests"s) {
+            options.requests = stoul(value);
+        } else if (argument == "--pipeline"s) {
+            options.pipeline = stoul(value);
+        } else if (argument == "--documents"s) {
+            options.documents = stoul(value);
+        } else if (argument == "--query-words"s) {
+            options.query_words = stoul(value);
+        } else {
+            return false;
+        }
+    }
+    return argc % 2 == 1 && options.connections > 0 && options.pipeline > 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        cerr << "Usage: search-server-load-generator [--port N] [--host ADDRESS] [--unix PATH] [--connections N]"s
+             << " [--requests N] [--pipeline N] [--documents N] [--query-words N]"s << endl;
+        return 1;
+    }
+    try {
+        mt19937 generator;
+        vector<string> dictionary;
+        for (int i = 0; i < 1000; ++i) {
+            dictionary.push_back(GenerateWord(generator, 10));
+        }
+
+        vector<string> add_requests;
+        for (size_t id = 0; id < options.documents; ++id) {
+            add_requests.push_back("ADD "s + to_string(id) + " ACTUAL 1,2,3 "s
+                + GenerateText(generator, dictionary, options.document_words, 0.0));
+        }
+        const auto fill_start = Clock::now();
+        const RunResult fill_result = RunPipelined(options, add_requests, 64);
+        const chrono::duration<double> fill_duration = Clock::now() - fill_start;
+        cout << "documents added: "s << add_requests.size() - fill_result.errors << " in "s << fill_duration.count() << " s"s << endl;
+
+        vector<vector<string>> queries(options.connections);
+        for (size_t i = 0; i < options.requests; ++i) {
+            queries[i % options.connections].push_back("SEARCH "s + GenerateText(generator, dictionary, options.query_words, 0.1));
+        }
+        vector<RunResult> results(options.connections);
+        vector<thread> threads;
+        const auto start = Clock::now();
+        for (size_t i = 0; i < options.connections; ++i) {
+            threads.emplace_back([&, i] {
+                try {
+                    results[i] = RunPipelined(options, queries[i], options.pipeline);
+                } catch (const exception& e) {
+                    cerr << "Connection "s << i << ": "s << e.what() << endl;
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        const chrono::duration<double> duration = Clock::now() - start;
+
+        vector<int64_t> latencies;
+        size_t errors = 0;
+        for (const RunResult& result : results) {
+            latencies.insert(latencies.end(), result.latencies_us.begin(), result.latencies_us.end());
+            errors += result.errors;
+        }
+        sort(latencies.begin(), latencies.end());
+        cout << "requests: "s << latencies.size() << ", connections: "s << options.connections
+             << ", pipeline: "s << options.pipeline << ", errors: "s << errors << endl;
+        cout << "throughput: "s << static_cast<int64_t>(latencies.size() / duration.count()) << " req/s"s << endl;
+        cout << "latency, us: p50 "s << Percentile(latencies, 50) << ", p90 "s << Percentile(latencies, 90)
+             << ", p99 "s << Percentile(latencies, 99) << ", p99.9 "s << Percentile(latencies, 99.9)
+             << ", max "s << (latencies.empty() ? 0 : latencies.back()) << endl;
+    } catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        return 1;
+    }
+}
@@ -1,10 +1,13 @@
 #include "log_duration.h"
 #include "process_queries.h"
+#include "query_trace.h"
 #include "search_server.h"
+#include "stop_word_set.h"
 
 #include <execution>
 #include <iostream>
 #include <random>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -65,8 +68,106 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
     cout << total_relevance << endl;
 }
 
+// поиск стоп-слов: std::set против совершенной хэш-функции на одном и том же потоке слов
+template <typename StopWords>
+void TestStopWords(string_view mark, const StopWords& stop_words, const vector<string_view>& words) {
+    LOG_DURATION(mark);
+    size_t stop_word_count = 0;
+    for (const string_view word : words) {
+        if constexpr (is_same_v<StopWords, StopWordSet>) {
+            stop_word_count += stop_words.Contains(word);
+        } else {
+            stop_word_count += stop_words.count(word);
+        }
+    }
+    cout << stop_word_count << endl;
+}
+
+// сжатые частоты слов против точных: память под частоты в списках документов и совпадение выдачи
+// с точной -- доля запросов с той же выдачей и средняя доля документов точной выдачи, оставшихся в выдаче
+void TestTermFreqPrecision(const SearchServer& exact_server, TermFreqPrecision precision, const vector<string>& queries) {
+    SearchServer search_server(exact_server);
+    search_server.SetTermFreqPrecision(precision);
+    vector<vector<Document>> results;
+    {
+        LOG_DURATION("term freqs: "s + string(GetTermFreqPrecisionName(precision)));
+        for (const string_view query : queries) {
+            results.push_back(search_server.FindTopDocuments(query));
+        }
+    }
+    size_t same_count = 0;
+    double overlap_sum = 0.0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto exact_documents = exact_server.FindTopDocuments(queries[i]);
+        set<int> exact_ids;
+        for (const Document& document : exact_documents) {
+            exact_ids.insert(document.id);
+        }
+        size_t overlap = 0;
+        bool is_same = exact_documents.size() == results[i].size();
+        for (size_t j = 0; j < results[i].size(); ++j) {
+            overlap += exact_ids.count(results[i][j].id);
+            is_same = is_same && exact_documents[j].id == results[i][j].id;
+        }
+        same_count += is_same;
+        overlap_sum += exact_ids.empty() ? 1.0 : static_cast<double>(overlap) / exact_ids.size();
+    }
+    // у копии нет запаса емкости, накопленного при добавлении документов, как и у перекодированных списков
+    const size_t exact_memory = SearchServer(exact_server).GetTermFreqMemoryUsage();
+    const size_t memory = search_server.GetTermFreqMemoryUsage();
+    cout << GetTermFreqPrecisionName(precision) << ": "s << memory << " bytes of "s << exact_memory
+         << " ("s << 100.0 * (exact_memory - memory) / exact_memory << "% saved), same top: "s
+         << 100.0 * same_count / queries.size() << "%, top overlap: "s << 100.0 * overlap_sum / queries.size() << "%"s << endl;
+}
+
+// память индексов по частям: данные + накладные расходы, в килобайтах
+void PrintMemoryStats(string_view mark, const SearchServer& search_server) {
+    const MemoryStats stats = search_server.GetMemoryStats();
+    const auto print = [](string_view name, const MemoryUsage& usage) {
+        cout << ", "s << name << ": "s << usage.payload_bytes / 1024 << "+"s << usage.overhead_bytes / 1024;
+    };
+    cout << "memory: "s << mark << " -- total "s << stats.GetTotal().GetTotalBytes() / 1024 << " KB"s;
+    print("dictionary"sv, stats.dictionary);
+    print("postings"sv, stats.postings);
+    print("forward index"sv, stats.forward_index);
+    print("metadata"sv, stats.document_metadata);
+    print("stop words"sv, stats.stop_words);
+    cout << endl;
+}
+
+// раскладки индекса: представления частот, таблицы частых слов, прямой индекс и запас емкости, оставшийся после добавления
+void TestMemoryLayouts(const SearchServer& search_server) {
+    PrintMemoryStats("as built"sv, search_server);
+    // копия размещает массивы без запаса емкости
+    SearchServer layout_server(search_server);
+    PrintMemoryStats("copy"sv, layout_server);
+    for (const TermFreqPrecision precision : {TermFreqPrecision::FLOAT, TermFreqPrecision::QUANTIZED_8}) {
+        layout_server.SetTermFreqPrecision(precision);
+        PrintMemoryStats(GetTermFreqPrecisionName(precision), layout_server);
+    }
+    layout_server.SetTermFreqPrecision(TermFreqPrecision::DOUBLE);
+    layout_server.SetImpactOrdering(IMPACT_TABLE_SIZE);
+    PrintMemoryStats("impact tables"sv, layout_server);
+    layout_server.SetImpactOrdering(0);
+    layout_server.SetForwardIndex(false);
+    PrintMemoryStats("no forward index"sv, layout_server);
+}
+
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 
+// пакет запросов: каждый запрос отдельно против общего обхода списков документов
+template <typename ProcessFunction>
+void TestBatch(string_view mark, const SearchServer& search_server, const vector<string>& queries, ProcessFunction process) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const auto& documents : process(search_server, queries)) {
+        for (const auto& document : documents) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
 int main() {
     mt19937 generator;
 
@@ -82,4 +183,23 @@ int main() {
 
     TEST(seq);
     TEST(par);
+    PrintTraceSnapshot(cerr, TakeTraceSnapshot());
+
+    const auto batch_queries = GenerateQueries(generator, dictionary, 300, 70);
+    TestBatch("batch: ProcessQueries"sv, search_server, batch_queries, ProcessQueries);
+    TestBatch("batch: ProcessQueriesBatched"sv, search_server, batch_queries, ProcessQueriesBatched);
+
+    TestTermFreqPrecision(search_server, TermFreqPrecision::FLOAT, queries);
+    TestTermFreqPrecision(search_server, TermFreqPrecision::QUANTIZED_8, queries);
+    TestMemoryLayouts(search_server);
+
+    const vector<string> stop_words(dictionary.begin(), dictionary.begin() + 200);
+    vector<string_view> words;
+    for (const string& document : documents) {
+        for (const string_view word : SplitIntoWords(document)) {
+            words.push_back(word);
+        }
+    }
+    TestStopWords("stop words: std::set"sv, set<string, less<>>(stop_words.begin(), stop_words.end()), words);
+    TestStopWords("stop words: StopWordSet"sv, StopWordSet(stop_words), words);
 }
@@ -0,0 +1,72 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SEARCH_SERVER_HAS_MMAP
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+using namespace std;
+
+#ifdef SEARCH_SERVER_HAS_MMAP
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "Cannot open "s + path);
+    }
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "Cannot stat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    // отображение нулевой длины недопустимо, пустой файл представляется пустой строкой
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw system_error(error, generic_category(), "Cannot map "s + path);
+        }
+        // файл читается один раз от начала до конца: ядро может читать страницы с опережением
+        madvise(data, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const string& path) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw system_error(make_error_code(errc::no_such_file_or_directory), "Cannot open "s + path);
+    }
+    buffer_.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
+
+string_view MappedFile::GetData() const {
+    return {data_, size_};
+}
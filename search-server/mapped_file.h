@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// файл, отображенный в память только для чтения
+// на POSIX-системах используется mmap, и страницы подгружаются ядром по мере чтения;
+// на остальных платформах файл читается в память целиком
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view GetData() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    // содержимое файла, если отображение в память недоступно
+    std::string buffer_;
+};
@@ -0,0 +1,17 @@
+#include "matched_documents.h"
+
+using namespace std;
+
+bool MatchedDocuments::HasWord(size_t index, size_t word_index) const {
+    return (word_bits[index * blocks_per_document + word_index / 64] >> (word_index % 64)) & 1;
+}
+
+vector<string_view> MatchedDocuments::GetMatchedWords(size_t index) const {
+    vector<string_view> result;
+    for (size_t word_index = 0; word_index < words.size(); ++word_index) {
+        if (HasWord(index, word_index)) {
+            result.push_back(words[word_index]);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// результат сопоставления одного запроса с набором документов (SearchServer::MatchDocuments)
+// плюс-слова запроса, встречающиеся в словаре, нумеруются по порядку в words, а для каждого документа
+// хранится битовое множество номеров найденных в нем слов: blocks_per_document машинных слов подряд
+struct MatchedDocuments {
+    // найдено ли в документе с номером index (в порядке document_ids) слово words[word_index]
+    bool HasWord(size_t index, size_t word_index) const;
+    // слова, найденные в документе с номером index; тот же результат, что и у SearchServer::MatchDocument
+    std::vector<std::string_view> GetMatchedWords(size_t index) const;
+
+    // ссылки на слова словаря сервера по алфавиту
+    std::vector<std::string_view> words;
+    std::vector<int> document_ids;
+    std::vector<DocumentStatus> statuses;
+    size_t blocks_per_document = 0;
+    std::vector<uint64_t> word_bits;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+
+// память, занятая структурой данных
+// payload -- сами хранимые значения; overhead -- все остальное: незанятая емкость массивов, служебные поля
+// узлов деревьев и хэш-таблиц, массивы корзин и заголовки блоков распределителя
+// размеры узлов соответствуют libstdc++, а заголовки блоков -- malloc из glibc, которым пользуется ресурс памяти
+// по умолчанию (new_delete_resource); для других ресурсов overhead -- оценка сверху
+struct MemoryUsage {
+    size_t payload_bytes = 0;
+    size_t overhead_bytes = 0;
+
+    size_t GetTotalBytes() const {
+        return payload_bytes + overhead_bytes;
+    }
+
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        payload_bytes += other.payload_bytes;
+        overhead_bytes += other.overhead_bytes;
+        return *this;
+    }
+};
+
+namespace memory_usage_detail {
+
+// блок malloc: 8 байт заголовка, выравнивание до 16 байт, не меньше 32 байт
+inline size_t GetAllocatedSize(size_t bytes) {
+    if (bytes == 0) {
+        return 0;
+    }
+    const size_t size = (bytes + sizeof(size_t) + 15) / 16 * 16;
+    return size < 32 ? 32 : size;
+}
+
+// узел красно-черного дерева (std::map, std::set): цвет и три указателя перед значением
+const size_t TREE_NODE_HEADER_SIZE = 4 * sizeof(void*);
+// узел std::unordered_map без сохраненного хэша (целые ключи): указатель на следующий узел перед значением
+const size_t HASH_NODE_HEADER_SIZE = sizeof(void*);
+// строки до 15 символов хранятся в самом объекте строки
+const size_t STRING_INLINE_CAPACITY = 15;
+
+}  // namespace memory_usage_detail
+
+// value_size -- байт на элемент
+inline MemoryUsage GetArrayMemoryUsage(size_t size, size_t capacity, size_t value_size) {
+    MemoryUsage usage;
+    usage.payload_bytes = size * value_size;
+    usage.overhead_bytes = memory_usage_detail::GetAllocatedSize(capacity * value_size) - usage.payload_bytes;
+    return usage;
+}
+
+// массив элементов вектора; сам объект вектора учитывается там, где он лежит
+template <typename Vector>
+MemoryUsage GetVectorMemoryUsage(const Vector& values) {
+    return GetArrayMemoryUsage(values.size(), values.capacity(), sizeof(typename Vector::value_type));
+}
+
+// символы строки вне объекта строки; короткие строки памяти вне объекта не занимают
+template <typename String>
+MemoryUsage GetStringMemoryUsage(const String& text) {
+    if (text.capacity() <= memory_usage_detail::STRING_INLINE_CAPACITY) {
+        return {};
+    }
+    return GetArrayMemoryUsage(text.size(), text.capacity() + 1, 1);
+}
+
+// узлы дерева со значениями типа Value (std::map, std::set)
+template <typename Value>
+MemoryUsage GetTreeNodesMemoryUsage(size_t node_count) {
+    MemoryUsage usage;
+    usage.payload_bytes = node_count * sizeof(Value);
+    usage.overhead_bytes = node_count * memory_usage_detail::GetAllocatedSize(memory_usage_detail::TREE_NODE_HEADER_SIZE + sizeof(Value)) - usage.payload_bytes;
+    return usage;
+}
+
+// узлы и массив корзин хэш-таблицы
+template <typename HashMap>
+MemoryUsage GetHashMapMemoryUsage(const HashMap& map) {
+    using Value = typename HashMap::value_type;
+    MemoryUsage usage;
+    usage.payload_bytes = map.size() * sizeof(Value);
+    usage.overhead_bytes = map.size() * memory_usage_detail::GetAllocatedSize(memory_usage_detail::HASH_NODE_HEADER_SIZE + sizeof(Value)) - usage.payload_bytes
+        + memory_usage_detail::GetAllocatedSize(map.bucket_count() * sizeof(void*));
+    return usage;
+}
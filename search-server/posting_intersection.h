@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// возвращает индекс первого элемента упорядоченного массива ordinals, не меньшего target, начиная с from
+// сначала за две SIMD-инструкции сравниваются 8 следующих элементов (частый случай для списков
+// близкой длины), затем шаг удваивается (galloping search), пока не будет перешагнут target,
+// и в найденном отрезке выполняется двоичный поиск
+template <typename Container>
+size_t AdvanceTo(const Container& ordinals, size_t from, int target) {
+    const size_t size = ordinals.size();
+#ifdef __SSE2__
+    if (from + 8 <= size) {
+        const __m128i key = _mm_set1_epi32(target);
+        const __m128i low_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ordinals.data() + from));
+        const __m128i high_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ordinals.data() + from + 4));
+        const int less_mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(low_block, key)))
+            | (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(high_block, key))) << 4);
+        // массив упорядочен, поэтому меньшие target элементы образуют префикс блока
+        if (less_mask != 0xFF) {
+            return from + __builtin_popcount(less_mask);
+        }
+        from += 8;
+    }
+#endif
+    size_t low = from;
+    size_t high = from;
+    size_t step = 1;
+    while (high < size && ordinals[high] < target) {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    high = std::min(high, size);
+    return std::lower_bound(ordinals.begin() + low, ordinals.begin() + high, target) - ordinals.begin();
+}
+
+// пересекает упорядоченные списки номеров документов, начиная с самого короткого
+template <typename Container>
+std::vector<int> IntersectPostings(std::vector<const Container*> lists) {
+    if (lists.empty()) {
+        return {};
+    }
+    std::sort(lists.begin(), lists.end(), [](const Container* lhs, const Container* rhs) {
+        return lhs->size() < rhs->size();
+    });
+    std::vector<int> result(lists[0]->begin(), lists[0]->end());
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        const Container& ordinals = *lists[i];
+        size_t position = 0;
+        size_t result_size = 0;
+        for (const int ordinal : result) {
+            position = AdvanceTo(ordinals, position, ordinal);
+            if (position == ordinals.size()) {
+                break;
+            }
+            if (ordinals[position] == ordinal) {
+                result[result_size++] = ordinal;
+            }
+        }
+        result.resize(result_size);
+    }
+    return result;
+}
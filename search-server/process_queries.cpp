@@ -19,6 +19,10 @@ vector<vector<Document>> ProcessQueries(const SearchServer& search_server, const
     return result;
 }
 
+vector<vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const vector<string>& queries) {
+    return search_server.FindTopDocumentsBatch(execution::par, queries);
+}
+
 vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const vector<string>& queries) {
     vector<vector<Document>> docsPerQueries = ProcessQueries(search_server, queries);
     vector<Document> result;
@@ -3,4 +3,7 @@
 #include "search_server.h"
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
+// то же, что ProcessQueries, но запросы выполняются пакетно (SearchServer::FindTopDocumentsBatch):
+// список документов слова, общего для многих запросов, обходится один раз на группу запросов
+std::vector<std::vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const std::vector<std::string>& queries);
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
@@ -0,0 +1,399 @@
+#include "query_daemon.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// ключи epoll для служебных дескрипторов; соединения нумеруются с нуля
+const uint64_t LISTEN_KEY = UINT64_MAX;
+const uint64_t WAKE_KEY = UINT64_MAX - 1;
+
+// запрос без перевода строки длиннее этого считается ошибкой клиента, и соединение закрывается
+const size_t MAX_REQUEST_LENGTH = 1 << 20;
+const size_t READ_BUFFER_SIZE = 1 << 16;
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+}  // namespace
+
+QueryDaemon::QueryDaemon(QueryProtocol& protocol, const DaemonOptions& options)
+    : protocol_(protocol)
+    , options_(options) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        ThrowSystemError("epoll_create1");
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        ThrowSystemError("eventfd");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_KEY;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) < 0) {
+        ThrowSystemError("epoll_ctl");
+    }
+    OpenListenSocket();
+    for (size_t i = 0; i < max<size_t>(options_.worker_count, 1); ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+}
+
+QueryDaemon::~QueryDaemon() {
+    {
+        lock_guard lock(jobs_mutex_);
+        workers_stopping_ = true;
+    }
+    jobs_condition_.notify_all();
+    for (thread& worker : workers_) {
+        worker.join();
+    }
+    for (const auto& [id, connection] : connections_) {
+        close(connection->fd);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        if (!options_.unix_socket_path.empty()) {
+            unlink(options_.unix_socket_path.c_str());
+        }
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+uint16_t QueryDaemon::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void QueryDaemon::OpenListenSocket() {
+    if (!options_.unix_socket_path.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options_.unix_socket_path.size() >= sizeof(address.sun_path)) {
+            throw invalid_argument("Unix socket path is too long"s);
+        }
+        strcpy(address.sun_path, options_.unix_socket_path.c_str());
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("socket");
+        }
+        unlink(address.sun_path);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("bind");
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options_.tcp_port);
+        if (inet_pton(AF_INET, options_.tcp_host.c_str(), &address.sin_addr) != 1) {
+            throw invalid_argument("Invalid host address: "s + options_.tcp_host);
+        }
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("socket");
+        }
+        const int enable = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("bind");
+        }
+        socklen_t address_length = sizeof(address);
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &address_length);
+        tcp_port_ = ntohs(address.sin_port);
+    }
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        ThrowSystemError("listen");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_KEY;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) < 0) {
+        ThrowSystemError("epoll_ctl");
+    }
+}
+
+void QueryDaemon::Run() {
+    vector<epoll_event> events(256);
+    while (!stop_requested_) {
+        const int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+        for (int i = 0; i < count; ++i) {
+            const uint64_t key = events[i].data.u64;
+            if (key == LISTEN_KEY) {
+                AcceptConnections();
+                continue;
+            }
+            if (key == WAKE_KEY) {
+                uint64_t value;
+                while (read(wake_fd_, &value, sizeof(value)) > 0) {
+                }
+                CollectCompletions();
+                continue;
+            }
+            // соединение могло быть закрыто при обработке предыдущих событий
+            const auto it = connections_.find(key);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            // клиент закрыл соединение в обе стороны: ответы доставить уже некуда
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                CloseConnection(key);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!WriteToConnection(connection)) {
+                    CloseConnection(key);
+                    continue;
+                }
+            }
+            if (events[i].events & EPOLLIN) {
+                ReadFromConnection(key, connection);
+                continue;
+            }
+            UpdateConnection(key, connection);
+        }
+    }
+}
+
+void QueryDaemon::Stop() {
+    stop_requested_ = true;
+    WakeUp();
+}
+
+void QueryDaemon::WakeUp() {
+    const uint64_t value = 1;
+    // eventfd переполняется только после 2^64 - 1 записей, результат можно не проверять
+    [[maybe_unused]] const auto result = write(wake_fd_, &value, sizeof(value));
+}
+
+void QueryDaemon::AcceptConnections() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // EAGAIN -- соединений больше нет; при нехватке дескрипторов ждем закрытия других соединений
+            return;
+        }
+        if (options_.unix_socket_path.empty()) {
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+        const uint64_t connection_id = next_connection_id_++;
+        auto connection = make_unique<Connection>();
+        connection->fd = fd;
+        connection->epoll_events = EPOLLIN;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = connection_id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+        connections_.emplace(connection_id, move(connection));
+    }
+}
+
+// читает из соединения одну порцию данных за событие, чтобы один клиент не задерживал остальных
+void QueryDaemon::ReadFromConnection(uint64_t connection_id, Connection& connection) {
+    char buffer[READ_BUFFER_SIZE];
+    const ssize_t size = recv(connection.fd, buffer, sizeof(buffer), 0);
+    if (size > 0) {
+        connection.input.append(buffer, size);
+    } else if (size == 0) {
+        connection.peer_closed = true;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        CloseConnection(connection_id);
+        return;
+    }
+    DispatchRequests(connection_id, connection);
+    if (connection.input.size() >= MAX_REQUEST_LENGTH && connection.input.find('\n') == string::npos) {
+        CloseConnection(connection_id);
+        return;
+    }
+    UpdateConnection(connection_id, connection);
+}
+
+// передает рабочим потокам все полные строки из буфера, пока не исчерпан лимит одновременных запросов
+void QueryDaemon::DispatchRequests(uint64_t connection_id, Connection& connection) {
+    vector<Job> jobs;
+    size_t parsed = 0;
+    while (!connection.write_in_flight && connection.in_flight + jobs.size() < options_.max_pipeline_depth) {
+        const size_t end = connection.input.find('\n', parsed);
+        if (end == string::npos) {
+            break;
+        }
+        size_t length = end - parsed;
+        if (length > 0 && connection.input[end - 1] == '\r') {
+            --length;
+        }
+        const string_view request = string_view(connection.input).substr(parsed, length);
+        const bool is_write = QueryProtocol::IsWriteRequest(request);
+        if (is_write && connection.in_flight + jobs.size() > 0) {
+            break;
+        }
+        jobs.push_back({connection_id, connection.next_request_sequence++, string(request)});
+        parsed = end + 1;
+        if (is_write) {
+            connection.write_in_flight = true;
+        }
+    }
+    if (jobs.empty()) {
+        return;
+    }
+    connection.input.erase(0, parsed);
+    connection.in_flight += jobs.size();
+    {
+        lock_guard lock(jobs_mutex_);
+        for (Job& job : jobs) {
+            jobs_.push_back(move(job));
+        }
+    }
+    jobs_condition_.notify_all();
+}
+
+// забирает ответы рабочих потоков и отправляет клиентам те, чья очередь подошла
+void QueryDaemon::CollectCompletions() {
+    vector<Completion> completions;
+    {
+        lock_guard lock(completions_mutex_);
+        completions.swap(completions_);
+    }
+    vector<uint64_t> touched_ids;
+    for (Completion& completion : completions) {
+        const auto it = connections_.find(completion.connection_id);
+        if (it == connections_.end()) {
+            continue;
+        }
+        Connection& connection = *it->second;
+        connection.ready_responses.emplace(completion.sequence, move(completion.response));
+        if (--connection.in_flight == 0) {
+            connection.write_in_flight = false;
+        }
+        touched_ids.push_back(completion.connection_id);
+    }
+    sort(touched_ids.begin(), touched_ids.end());
+    touched_ids.erase(unique(touched_ids.begin(), touched_ids.end()), touched_ids.end());
+    for (const uint64_t connection_id : touched_ids) {
+        Connection& connection = *connections_.at(connection_id);
+        auto& ready = connection.ready_responses;
+        while (!ready.empty() && ready.begin()->first == connection.next_response_sequence) {
+            connection.output += ready.begin()->second;
+            connection.output += '\n';
+            ready.erase(ready.begin());
+            ++connection.next_response_sequence;
+        }
+        if (!WriteToConnection(connection)) {
+            CloseConnection(connection_id);
+            continue;
+        }
+        // освободились места для запросов, которые уже прочитаны, но ждут в буфере
+        DispatchRequests(connection_id, connection);
+        UpdateConnection(connection_id, connection);
+    }
+}
+
+// возвращает false, если соединение разорвано
+bool QueryDaemon::WriteToConnection(Connection& connection) {
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        const ssize_t size = send(connection.fd, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        written += size;
+    }
+    connection.output.erase(0, written);
+    return true;
+}
+
+// закрывает соединение, если клиент закончил передачу и все ответы отправлены, иначе
+// подписывается на чтение, пока не исчерпан лимит запросов, и на запись, пока есть что отправлять
+void QueryDaemon::UpdateConnection(uint64_t connection_id, Connection& connection) {
+    if (connection.peer_closed && connection.in_flight == 0 && connection.output.empty()) {
+        CloseConnection(connection_id);
+        return;
+    }
+    uint32_t events = 0;
+    // пока запросы не могут быть переданы рабочим потокам, буфер растет не больше MAX_REQUEST_LENGTH
+    if (!connection.peer_closed && connection.in_flight < options_.max_pipeline_depth
+        && connection.input.size() < MAX_REQUEST_LENGTH) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.epoll_events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = connection_id;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.epoll_events = events;
+    }
+}
+
+void QueryDaemon::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    // закрытый дескриптор удаляется из epoll автоматически; ответы на его запросы будут отброшены
+    close(it->second->fd);
+    connections_.erase(it);
+}
+
+void QueryDaemon::RunWorker() {
+    while (true) {
+        Job job;
+        {
+            unique_lock lock(jobs_mutex_);
+            jobs_condition_.wait(lock, [this] {
+                return workers_stopping_ || !jobs_.empty();
+            });
+            if (workers_stopping_) {
+                return;
+            }
+            job = move(jobs_.front());
+            jobs_.pop_front();
+        }
+        string response = protocol_.Execute(job.request);
+        {
+            lock_guard lock(completions_mutex_);
+            completions_.push_back({job.connection_id, job.sequence, move(response)});
+        }
+        WakeUp();
+    }
+}
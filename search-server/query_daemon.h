@@ -0,0 +1,106 @@
+#pragma once
+
+#include "query_protocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct DaemonOptions {
+    // путь к Unix-сокету; если пуст, сервер слушает TCP-порт (0 -- выбрать свободный)
+    std::string unix_socket_path;
+    std::string tcp_host = "127.0.0.1";
+    uint16_t tcp_port = 0;
+    size_t worker_count = 4;
+    // сколько запросов одного соединения может выполняться одновременно; пока лимит исчерпан,
+    // новые запросы из соединения не читаются и копятся в буфере сокета
+    size_t max_pipeline_depth = 64;
+};
+
+// сетевой интерфейс поискового сервера (Linux): один поток обслуживает все соединения через epoll,
+// разбирает запросы протокола QueryProtocol и передает их пулу рабочих потоков фиксированного размера
+// клиент может отправлять запросы, не дожидаясь ответов (pipelining); ответы приходят в порядке запросов
+// запросы одного соединения на чтение выполняются параллельно, а запрос на изменение выполняется только
+// после всех предыдущих и до всех следующих, поэтому клиент видит результат своих изменений
+class QueryDaemon {
+public:
+    QueryDaemon(QueryProtocol& protocol, const DaemonOptions& options);
+    ~QueryDaemon();
+
+    QueryDaemon(const QueryDaemon&) = delete;
+    QueryDaemon& operator=(const QueryDaemon&) = delete;
+
+    // фактический TCP-порт, на котором сервер принимает соединения
+    uint16_t GetTcpPort() const;
+
+    // обслуживает соединения, пока не будет вызван Stop
+    void Run();
+    // можно вызывать из любого потока и из обработчика сигнала
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        uint64_t next_request_sequence = 0;
+        uint64_t next_response_sequence = 0;
+        // ответы, готовые раньше предыдущих, ждут своей очереди
+        std::map<uint64_t, std::string> ready_responses;
+        size_t in_flight = 0;
+        // выполняется запрос на изменение: следующие запросы ждут его завершения
+        bool write_in_flight = false;
+        bool peer_closed = false;
+        uint32_t epoll_events = 0;
+    };
+
+    struct Job {
+        uint64_t connection_id;
+        uint64_t sequence;
+        std::string request;
+    };
+
+    struct Completion {
+        uint64_t connection_id;
+        uint64_t sequence;
+        std::string response;
+    };
+
+    void OpenListenSocket();
+    void AcceptConnections();
+    void ReadFromConnection(uint64_t connection_id, Connection& connection);
+    void DispatchRequests(uint64_t connection_id, Connection& connection);
+    void CollectCompletions();
+    bool WriteToConnection(Connection& connection);
+    void UpdateConnection(uint64_t connection_id, Connection& connection);
+    void CloseConnection(uint64_t connection_id);
+    void WakeUp();
+    void RunWorker();
+
+    QueryProtocol& protocol_;
+    const DaemonOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    // eventfd, через который рабочие потоки и Stop будят цикл событий
+    int wake_fd_ = -1;
+    uint16_t tcp_port_ = 0;
+    std::atomic<bool> stop_requested_{false};
+    uint64_t next_connection_id_ = 0;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_condition_;
+    std::deque<Job> jobs_;
+    bool workers_stopping_ = false;
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,86 @@
+#include "query_plan.h"
+
+using namespace std;
+
+string_view GetQueryStrategyName(QueryStrategy strategy) {
+    switch (strategy) {
+    case QueryStrategy::TERM_AT_A_TIME:
+        return "TERM_AT_A_TIME"sv;
+    case QueryStrategy::DOCUMENT_AT_A_TIME:
+        return "DOCUMENT_AT_A_TIME"sv;
+    case QueryStrategy::MAX_SCORE:
+        return "MAX_SCORE"sv;
+    case QueryStrategy::BLOCK_MAX_WAND:
+        return "BLOCK_MAX_WAND"sv;
+    case QueryStrategy::IMPACT_ORDERED:
+        return "IMPACT_ORDERED"sv;
+    case QueryStrategy::CONJUNCTIVE:
+        return "CONJUNCTIVE"sv;
+    }
+    return "UNKNOWN"sv;
+}
+
+namespace {
+
+// поля QueryPlannerMetrics в порядке счетчиков ячейки
+constexpr uint64_t QueryPlannerMetrics::* METRIC_FIELDS[] = {
+    &QueryPlannerMetrics::term_at_a_time_queries,
+    &QueryPlannerMetrics::document_at_a_time_queries,
+    &QueryPlannerMetrics::max_score_queries,
+    &QueryPlannerMetrics::block_max_wand_queries,
+    &QueryPlannerMetrics::impact_ordered_queries,
+    &QueryPlannerMetrics::conjunctive_queries,
+    &QueryPlannerMetrics::scanned_postings,
+    &QueryPlannerMetrics::probed_postings,
+    &QueryPlannerMetrics::scored_documents,
+    &QueryPlannerMetrics::pruned_documents,
+    &QueryPlannerMetrics::deferred_terms,
+    &QueryPlannerMetrics::skipped_blocks,
+};
+
+}  // namespace
+
+QueryPlannerCounters::QueryPlannerCounters(const QueryPlannerCounters& other) {
+    Set(other.Get());
+}
+
+QueryPlannerCounters& QueryPlannerCounters::operator=(const QueryPlannerCounters& other) {
+    Set(other.Get());
+    return *this;
+}
+
+size_t QueryPlannerCounters::GetShardIndex() {
+    static atomic<size_t> next_index = 0;
+    thread_local const size_t index = next_index.fetch_add(1, memory_order_relaxed) % SHARD_COUNT;
+    return index;
+}
+
+void QueryPlannerCounters::Set(const QueryPlannerMetrics& metrics) {
+    for (size_t shard = 0; shard < SHARD_COUNT; ++shard) {
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            shards_[shard].counters[i].store(shard == 0 ? metrics.*METRIC_FIELDS[i] : 0, memory_order_relaxed);
+        }
+    }
+}
+
+// ячейку могут делить несколько потоков, поэтому прибавление остается атомарным, но строка кэша
+// в основном остается у одного ядра; нулевые показатели (стратегии, не выбранные запросом) не пишутся
+void QueryPlannerCounters::Add(const QueryPlannerMetrics& metrics) {
+    static_assert(size(METRIC_FIELDS) == COUNTER_COUNT);
+    Shard& shard = shards_[GetShardIndex()];
+    for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+        if (const uint64_t value = metrics.*METRIC_FIELDS[i]; value > 0) {
+            shard.counters[i].fetch_add(value, memory_order_relaxed);
+        }
+    }
+}
+
+QueryPlannerMetrics QueryPlannerCounters::Get() const {
+    QueryPlannerMetrics metrics;
+    for (const Shard& shard : shards_) {
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            metrics.*METRIC_FIELDS[i] += shard.counters[i].load(memory_order_relaxed);
+        }
+    }
+    return metrics;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// способ обхода списков документов при поиске
+enum class QueryStrategy {
+    // слово за словом: вклады слов накапливаются в массиве по всем документам коллекции;
+    // выгоден, когда списки покрывают заметную долю коллекции
+    TERM_AT_A_TIME,
+    // документ за документом: списки сливаются курсорами по возрастанию номеров, и релевантность документа
+    // вычисляется сразу целиком; память не зависит от размера коллекции
+    DOCUMENT_AT_A_TIME,
+    // документ за документом с отсечением (MaxScore), когда нужны только лучшие документы: слова, чей суммарный
+    // верхний предел вклада ниже релевантности худшего из уже отобранных документов, откладываются -- они
+    // не порождают кандидатов, а лишь проверяются для кандидатов из остальных списков; документ не оценивается
+    // целиком, если даже с максимальным вкладом отложенных слов он не попадет в выдачу
+    MAX_SCORE,
+    // документ за документом с отсечением Block-Max WAND, когда нужны только лучшие документы: курсоры
+    // упорядочиваются по текущему документу, и опорным становится первый документ, на котором сумма верхних
+    // пределов вклада слов достигает порога; затем та же проверка повторяется по пределам блоков списков,
+    // содержащих этот документ, и если блоки его не пропускают, курсоры перескакивают сразу за ближайшую
+    // границу блока; в отличие от MAX_SCORE отсекает документы и в запросах из одного слова
+    BLOCK_MAX_WAND,
+    // запрос из одного частого слова: документы берутся из начала списка, упорядоченного по убыванию частоты
+    // (см. SearchServer::SetImpactOrdering), пока верхний предел вклада следующего документа не опустится ниже
+    // порога; если по таблице этого доказать нельзя, запрос выполняется BLOCK_MAX_WAND
+    IMPACT_ORDERED,
+    // запрос с обязательными словами: оцениваются только документы из пересечения их списков
+    CONJUNCTIVE,
+};
+
+std::string_view GetQueryStrategyName(QueryStrategy strategy);
+
+// стоимости для сравнения стратегий, в условных единицах
+// слово за словом: запись в массив релевантностей на каждый элемент списков и обнуление/просмотр массива
+const double TERM_AT_A_TIME_POSTING_COST = 1.0;
+const double TERM_AT_A_TIME_ORDINAL_COST = 0.05;
+// документ за документом: выбор наименьшего номера среди курсоров всех слов на каждый элемент списков
+const double DOCUMENT_AT_A_TIME_POSTING_COST = 0.3;
+
+// слово запроса, найденное в индексе
+struct PlannedTerm {
+    // в плане, полученном из PlanQuery, ссылается на словарь сервера
+    std::string_view word;
+    // номер среди плюс-слов запроса: вклады слов суммируются в порядке запроса при любой стратегии,
+    // поэтому релевантность от стратегии не зависит
+    size_t word_index = 0;
+    size_t posting_count = 0;
+    // IDF с учетом веса слова при нечетком поиске
+    double inverse_document_freq = 0.0;
+    // верхний предел вклада слова в релевантность одного документа
+    double max_score = 0.0;
+};
+
+struct QueryPlan {
+    QueryStrategy strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+    // сколько лучших документов нужно; 0 -- нужны все найденные документы
+    size_t top_count = 0;
+    // слова по возрастанию max_score: частые слова с малым IDF оказываются в начале и откладываются первыми,
+    // а кандидатов порождают редкие слова из конца списка
+    std::vector<PlannedTerm> terms;
+    size_t posting_count = 0;
+    double term_at_a_time_cost = 0.0;
+    double document_at_a_time_cost = 0.0;
+    // сколько слов из начала terms, по оценке, будет отложено при MAX_SCORE
+    size_t expected_deferred_count = 0;
+};
+
+// сводные показатели выполненных запросов
+struct QueryPlannerMetrics {
+    uint64_t term_at_a_time_queries = 0;
+    uint64_t document_at_a_time_queries = 0;
+    uint64_t max_score_queries = 0;
+    uint64_t block_max_wand_queries = 0;
+    uint64_t impact_ordered_queries = 0;
+    uint64_t conjunctive_queries = 0;
+    // элементы списков документов, пройденные подряд
+    uint64_t scanned_postings = 0;
+    // поиски документа в списке отложенного слова
+    uint64_t probed_postings = 0;
+    // документы, для которых вычислена релевантность
+    uint64_t scored_documents = 0;
+    // документы, отброшенные по верхнему пределу релевантности без полной оценки
+    uint64_t pruned_documents = 0;
+    // слова, отложенные к концу запроса
+    uint64_t deferred_terms = 0;
+    // пропуски курсоров за границу блоков, пределы которых ниже порога
+    uint64_t skipped_blocks = 0;
+};
+
+// накопитель показателей; запросы выполняются конкурентно, поэтому счетчики атомарные
+// счетчики разнесены по ячейкам, каждая в своих строках кэша, и поток прибавляет показатели запроса к ячейке,
+// выбранной по номеру потока: потоки, одновременно выполняющие запросы, не перебрасывают друг другу строку кэша
+// с общими счетчиками; Get суммирует ячейки
+// копия сервера получает текущие значения счетчиков
+class QueryPlannerCounters {
+public:
+    QueryPlannerCounters() = default;
+    QueryPlannerCounters(const QueryPlannerCounters& other);
+    QueryPlannerCounters& operator=(const QueryPlannerCounters& other);
+
+    void Add(const QueryPlannerMetrics& metrics);
+    QueryPlannerMetrics Get() const;
+
+private:
+    // число полей QueryPlannerMetrics
+    static const size_t COUNTER_COUNT = 12;
+    static const size_t SHARD_COUNT = 16;
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters{};
+    };
+
+    // ячейка текущего потока; потоки получают ячейки по очереди
+    static size_t GetShardIndex();
+    void Set(const QueryPlannerMetrics& metrics);
+
+    std::array<Shard, SHARD_COUNT> shards_;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "document.h"
+#include "query_plan.h"
+#include "query_trace.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// слово запроса в профиле
+struct TermProfile {
+    std::string word;
+    // длина списка документов слова; 0 -- слова нет в индексе
+    size_t posting_count = 0;
+    // вес слова: 1 для слов запроса, меньше -- для слов, найденных нечетким поиском
+    double weight = 1.0;
+    // IDF с учетом веса; у минус-слов не вычисляется
+    double inverse_document_freq = 0.0;
+};
+
+// вклад слова в релевантность документа: score = ComputeTermScore(term_freq, длина документа, inverse_document_freq)
+struct TermContribution {
+    std::string word;
+    // частота в том представлении, в котором она хранится в списке (см. TermFreqPrecision)
+    double term_freq = 0.0;
+    double inverse_document_freq = 0.0;
+    double score = 0.0;
+};
+
+// разложение релевантности документа выдачи; вклады перечислены в порядке слов запроса и в этом же порядке
+// суммируются при поиске, поэтому их сумма совпадает с релевантностью до бита
+struct DocumentExplanation {
+    int document_id = 0;
+    double relevance = 0.0;
+    std::vector<TermContribution> contributions;
+};
+
+// профиль выполнения одного запроса (SearchServer::FindTopDocuments с параметром QueryProfile&)
+struct QueryProfile {
+    std::vector<TermProfile> plus_terms;
+    std::vector<TermProfile> minus_terms;
+    std::vector<std::string> required_words;
+
+    QueryStrategy strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+    // показатели обхода списков; параллельная версия поиска складывает их по отрезкам коллекции
+    QueryPlannerMetrics metrics;
+
+    // документы, отброшенные как удаленные или содержащие минус-слова, до вызова предиката
+    uint64_t excluded_documents = 0;
+    uint64_t predicate_calls = 0;
+    // документы, которые не пропустил предикат
+    uint64_t rejected_documents = 0;
+    // документы, переданные на отбор лучших; стратегии с отсечением передают не все найденные документы
+    size_t found_document_count = 0;
+
+    // время этапов (query_trace.h); заполняется только в сборке с SEARCH_SERVER_TRACING
+    std::array<std::chrono::nanoseconds, TRACE_STAGE_COUNT> stage_durations{};
+
+    // по одному на документ выдачи, в порядке выдачи
+    std::vector<DocumentExplanation> explanations;
+};
+
+namespace query_profile_detail {
+
+// параллельная версия поиска проверяет документы из нескольких потоков
+struct DocumentCheckCounters {
+    std::atomic<uint64_t> excluded_documents = 0;
+    std::atomic<uint64_t> predicate_calls = 0;
+    std::atomic<uint64_t> rejected_documents = 0;
+};
+
+}  // namespace query_profile_detail
+
+// предикат поиска, который заодно собирает профиль запроса
+// поиск узнает его по типу (IsProfiledPredicate) и только для него вызывает счетчики, поэтому поиск без профиля
+// компилируется без них и ничего не теряет
+template <typename DocumentPredicate>
+class ProfiledDocumentPredicate {
+public:
+    ProfiledDocumentPredicate(DocumentPredicate predicate, QueryProfile& profile, query_profile_detail::DocumentCheckCounters& counters)
+        : predicate_(predicate)
+        , profile_(&profile)
+        , counters_(&counters)
+    {
+    }
+
+    bool operator()(int document_id, DocumentStatus status, int rating) {
+        counters_->predicate_calls.fetch_add(1, std::memory_order_relaxed);
+        const bool is_accepted = predicate_(document_id, status, rating);
+        if (!is_accepted) {
+            counters_->rejected_documents.fetch_add(1, std::memory_order_relaxed);
+        }
+        return is_accepted;
+    }
+
+    void CountExcludedDocument() const {
+        counters_->excluded_documents.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // вызывается один раз, из потока, выполняющего запрос
+    void RecordExecution(QueryStrategy strategy, const QueryPlannerMetrics& metrics) const {
+        profile_->strategy = strategy;
+        profile_->metrics = metrics;
+    }
+
+private:
+    DocumentPredicate predicate_;
+    QueryProfile* profile_;
+    query_profile_detail::DocumentCheckCounters* counters_;
+};
+
+template <typename DocumentPredicate>
+struct IsProfiledPredicate : std::false_type {};
+
+template <typename DocumentPredicate>
+struct IsProfiledPredicate<ProfiledDocumentPredicate<DocumentPredicate>> : std::true_type {};
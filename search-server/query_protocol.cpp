@@ -0,0 +1,137 @@
+#include "query_protocol.h"
+
+#include <charconv>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// отделяет первое слово строки от остатка
+pair<string_view, string_view> SplitFirstWord(string_view text) {
+    const size_t end = text.find(' ');
+    if (end == string_view::npos) {
+        return {text, {}};
+    }
+    return {text.substr(0, end), text.substr(end + 1)};
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc() || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number: "s + string(text));
+    }
+    return value;
+}
+
+vector<int> ParseRatings(string_view text) {
+    vector<int> ratings;
+    if (text == "-"sv) {
+        return ratings;
+    }
+    while (!text.empty()) {
+        const size_t end = text.find(',');
+        ratings.push_back(ParseInt(text.substr(0, end)));
+        text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+    }
+    return ratings;
+}
+
+}  // namespace
+
+QueryProtocol::QueryProtocol(SearchServer& search_server)
+    : search_server_(search_server) {
+}
+
+string QueryProtocol::Execute(string_view request) {
+    const auto [command, arguments] = SplitFirstWord(request);
+    try {
+        if (command == "SEARCH"sv) {
+            return ExecuteSearch(arguments);
+        }
+        if (command == "MATCH"sv) {
+            return ExecuteMatch(arguments);
+        }
+        if (command == "ADD"sv) {
+            return ExecuteAdd(arguments);
+        }
+        if (command == "REMOVE"sv) {
+            return ExecuteRemove(arguments);
+        }
+        if (command == "COUNT"sv) {
+            return ExecuteCount();
+        }
+        return "ERR Unknown command"s;
+    } catch (const exception& e) {
+        return "ERR "s + e.what();
+    }
+}
+
+bool QueryProtocol::IsWriteRequest(string_view request) {
+    const string_view command = SplitFirstWord(request).first;
+    return command == "ADD"sv || command == "REMOVE"sv;
+}
+
+string QueryProtocol::ExecuteSearch(string_view arguments) {
+    vector<Document> documents;
+    {
+        shared_lock lock(mutex_);
+        documents = search_server_.FindTopDocuments(arguments);
+    }
+    ostringstream out;
+    out << "OK "s << documents.size();
+    for (const Document& document : documents) {
+        out << ' ' << document.id << ' ' << document.relevance << ' ' << document.rating;
+    }
+    return out.str();
+}
+
+string QueryProtocol::ExecuteMatch(string_view arguments) {
+    const auto [id, query] = SplitFirstWord(arguments);
+    const int document_id = ParseInt(id);
+    string response = "OK "s;
+    shared_lock lock(mutex_);
+    // сервер сообщает о неизвестном документе исключением библиотеки (std::out_of_range из контейнера),
+    // а клиент получает ошибку протокола
+    tuple<vector<string_view>, DocumentStatus> match;
+    try {
+        match = search_server_.MatchDocument(query, document_id);
+    } catch (const out_of_range&) {
+        throw invalid_argument("Unknown document id"s);
+    }
+    // слова ответа ссылаются на словарь сервера, поэтому копируются до снятия блокировки
+    const auto& [words, status] = match;
+    response += GetDocumentStatusName(status);
+    for (const string_view word : words) {
+        response += ' ';
+        response += word;
+    }
+    return response;
+}
+
+string QueryProtocol::ExecuteAdd(string_view arguments) {
+    const auto [id, rest] = SplitFirstWord(arguments);
+    const auto [status, rest_after_status] = SplitFirstWord(rest);
+    const auto [ratings, text] = SplitFirstWord(rest_after_status);
+    const int document_id = ParseInt(id);
+    const DocumentStatus document_status = ParseDocumentStatus(status);
+    const vector<int> document_ratings = ParseRatings(ratings);
+    unique_lock lock(mutex_);
+    search_server_.AddDocument(document_id, text, document_status, document_ratings);
+    return "OK"s;
+}
+
+string QueryProtocol::ExecuteRemove(string_view arguments) {
+    const int document_id = ParseInt(arguments);
+    unique_lock lock(mutex_);
+    search_server_.RemoveDocument(document_id);
+    return "OK"s;
+}
+
+string QueryProtocol::ExecuteCount() {
+    shared_lock lock(mutex_);
+    return "OK "s + to_string(search_server_.GetDocumentCount());
+}
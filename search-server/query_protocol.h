@@ -0,0 +1,37 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+// текстовый протокол сетевого интерфейса: одна строка -- один запрос, на каждый запрос -- одна строка ответа
+//   SEARCH <запрос>                                      -> OK <n> <id> <relevance> <rating> ...
+//   MATCH <id> <запрос>                                  -> OK <статус> <слово> ...
+//   ADD <id> <статус> <рейтинги через запятую> <текст>   -> OK
+//   REMOVE <id>                                          -> OK
+//   COUNT                                                -> OK <число документов>
+// статус записывается именем (ACTUAL, IRRELEVANT, BANNED, REMOVED), пустой список рейтингов -- знаком "-"
+// при ошибке возвращается ERR <описание>
+class QueryProtocol {
+public:
+    explicit QueryProtocol(SearchServer& search_server);
+
+    // выполняет запрос; потокобезопасен: поиск и матчинг выполняются под разделяемой блокировкой
+    // и могут идти параллельно, добавление и удаление -- под исключительной
+    std::string Execute(std::string_view request);
+
+    // меняет ли запрос содержимое сервера
+    static bool IsWriteRequest(std::string_view request);
+
+private:
+    std::string ExecuteSearch(std::string_view arguments);
+    std::string ExecuteMatch(std::string_view arguments);
+    std::string ExecuteAdd(std::string_view arguments);
+    std::string ExecuteRemove(std::string_view arguments);
+    std::string ExecuteCount();
+
+    SearchServer& search_server_;
+    std::shared_mutex mutex_;
+};
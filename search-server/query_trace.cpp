@@ -0,0 +1,331 @@
+#include "query_trace.h"
+
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+string_view GetTraceStageName(TraceStage stage) {
+    switch (stage) {
+    case TraceStage::QUERY:
+        return "QUERY"sv;
+    case TraceStage::PARSE:
+        return "PARSE"sv;
+    case TraceStage::TERM_LOOKUP:
+        return "TERM_LOOKUP"sv;
+    case TraceStage::MINUS_EXCLUSION:
+        return "MINUS_EXCLUSION"sv;
+    case TraceStage::SCORING:
+        return "SCORING"sv;
+    case TraceStage::FILTERING:
+        return "FILTERING"sv;
+    case TraceStage::TOP_K:
+        return "TOP_K"sv;
+    }
+    return "UNKNOWN"sv;
+}
+
+int GetTraceStageDepth(TraceStage stage) {
+    switch (stage) {
+    case TraceStage::QUERY:
+        return 0;
+    case TraceStage::FILTERING:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    const size_t sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int exponent = static_cast<int>(index / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+    return (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int exponent = static_cast<int>(index / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+    return GetBucketLowerBound(index) + ((uint64_t{1} << (exponent - SUB_BUCKET_BITS)) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+    Increase(counts_[GetBucketIndex(value)], 1);
+    Increase(sum_, value);
+    if (value > max_.load(memory_order_relaxed)) {
+        max_.store(value, memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& count : counts_) {
+        count.store(0, memory_order_relaxed);
+    }
+    sum_.store(0, memory_order_relaxed);
+    max_.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCount(size_t index) const {
+    return counts_[index].load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetSum() const {
+    return sum_.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetMax() const {
+    return max_.load(memory_order_relaxed);
+}
+
+LatencySnapshot::LatencySnapshot()
+    : counts_(LatencyHistogram::BUCKET_COUNT, 0)
+{
+}
+
+void LatencySnapshot::Add(const LatencyHistogram& histogram, uint64_t self_sum) {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        const uint64_t count = histogram.GetCount(i);
+        counts_[i] += count;
+        count_ += count;
+    }
+    sum_ += histogram.GetSum();
+    self_sum_ += self_sum;
+    max_ = max(max_, histogram.GetMax());
+}
+
+void LatencySnapshot::Add(const LatencySnapshot& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    self_sum_ += other.self_sum_;
+    max_ = max(max_, other.max_);
+}
+
+uint64_t LatencySnapshot::GetCount() const {
+    return count_;
+}
+
+uint64_t LatencySnapshot::GetSum() const {
+    return sum_;
+}
+
+uint64_t LatencySnapshot::GetSelfSum() const {
+    return self_sum_;
+}
+
+uint64_t LatencySnapshot::GetMax() const {
+    return max_;
+}
+
+double LatencySnapshot::GetMean() const {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+}
+
+// верхняя граница корзины, в которую попал замер с номером ceil(percentile% * count);
+// максимум не превышается, поэтому GetPercentile(100) == GetMax()
+uint64_t LatencySnapshot::GetPercentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const double rank = ceil(clamp(percentile, 0.0, 100.0) / 100.0 * count_);
+    const uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(rank));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= target) {
+            return min(LatencyHistogram::GetBucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+uint64_t LatencySnapshot::GetCountAtMost(uint64_t value) const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < counts_.size() && LatencyHistogram::GetBucketLowerBound(i) <= value; ++i) {
+        count += counts_[i];
+    }
+    return count;
+}
+
+namespace {
+
+// гистограммы этапов одного потока; собственное время хранится отдельно, оно в гистограмму не попадает
+struct ThreadHistograms {
+    array<LatencyHistogram, TRACE_STAGE_COUNT> stages;
+    array<atomic<uint64_t>, TRACE_STAGE_COUNT> self_sums{};
+};
+
+// реестр гистограмм живых потоков; при завершении потока его замеры переносятся в retired_stages_
+class TraceRegistry {
+public:
+    void Register(ThreadHistograms* histograms) {
+        lock_guard guard(mutex_);
+        live_histograms_.push_back(histograms);
+    }
+
+    void Unregister(ThreadHistograms* histograms) {
+        lock_guard guard(mutex_);
+        AddHistograms(retired_stages_, *histograms);
+        live_histograms_.erase(find(live_histograms_.begin(), live_histograms_.end(), histograms));
+    }
+
+    TraceSnapshot TakeSnapshot() {
+        lock_guard guard(mutex_);
+        TraceSnapshot snapshot;
+        snapshot.stages = retired_stages_;
+        for (const ThreadHistograms* histograms : live_histograms_) {
+            AddHistograms(snapshot.stages, *histograms);
+        }
+        return snapshot;
+    }
+
+    void Reset() {
+        lock_guard guard(mutex_);
+        retired_stages_ = {};
+        for (ThreadHistograms* histograms : live_histograms_) {
+            for (size_t stage = 0; stage < TRACE_STAGE_COUNT; ++stage) {
+                histograms->stages[stage].Reset();
+                histograms->self_sums[stage].store(0, memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static void AddHistograms(array<LatencySnapshot, TRACE_STAGE_COUNT>& stages, const ThreadHistograms& histograms) {
+        for (size_t stage = 0; stage < TRACE_STAGE_COUNT; ++stage) {
+            stages[stage].Add(histograms.stages[stage], histograms.self_sums[stage].load(memory_order_relaxed));
+        }
+    }
+
+    mutex mutex_;
+    vector<ThreadHistograms*> live_histograms_;
+    array<LatencySnapshot, TRACE_STAGE_COUNT> retired_stages_;
+};
+
+// реестр не разрушается: потоки могут завершаться и после разрушения статических объектов
+TraceRegistry& GetTraceRegistry() {
+    static TraceRegistry* registry = new TraceRegistry;
+    return *registry;
+}
+
+// гистограммы потока создаются при первом замере, а не для каждого потока процесса
+class ThreadHistogramsHolder {
+public:
+    ~ThreadHistogramsHolder() {
+        if (histograms_) {
+            GetTraceRegistry().Unregister(histograms_.get());
+        }
+    }
+
+    ThreadHistograms& Get() {
+        if (!histograms_) {
+            histograms_ = make_unique<ThreadHistograms>();
+            GetTraceRegistry().Register(histograms_.get());
+        }
+        return *histograms_;
+    }
+
+private:
+    unique_ptr<ThreadHistograms> histograms_;
+};
+
+thread_local ThreadHistogramsHolder thread_histograms;
+
+const int PROMETHEUS_MIN_BUCKET_EXPONENT = 10;
+const int PROMETHEUS_MAX_BUCKET_EXPONENT = 34;
+
+double NanosecondsToMicroseconds(uint64_t nanoseconds) {
+    return nanoseconds / 1e3;
+}
+
+double NanosecondsToSeconds(uint64_t nanoseconds) {
+    return nanoseconds / 1e9;
+}
+
+}  // namespace
+
+namespace trace_detail {
+
+void RecordSpan(TraceStage stage, uint64_t duration, uint64_t self_duration) {
+    ThreadHistograms& histograms = thread_histograms.Get();
+    const size_t index = static_cast<size_t>(stage);
+    histograms.stages[index].Record(duration);
+    auto& self_sum = histograms.self_sums[index];
+    self_sum.store(self_sum.load(memory_order_relaxed) + self_duration, memory_order_relaxed);
+}
+
+}  // namespace trace_detail
+
+TraceStageCollector::TraceStageCollector(array<chrono::nanoseconds, TRACE_STAGE_COUNT>& durations)
+    : previous_durations_(TraceSpan::collected_durations_)
+{
+    TraceSpan::collected_durations_ = &durations;
+}
+
+TraceStageCollector::~TraceStageCollector() {
+    TraceSpan::collected_durations_ = previous_durations_;
+}
+
+TraceSnapshot TakeTraceSnapshot() {
+    return GetTraceRegistry().TakeSnapshot();
+}
+
+void ResetTraceHistograms() {
+    GetTraceRegistry().Reset();
+}
+
+void PrintTraceSnapshot(ostream& out, const TraceSnapshot& snapshot) {
+    for (size_t index = 0; index < TRACE_STAGE_COUNT; ++index) {
+        const auto stage = static_cast<TraceStage>(index);
+        const LatencySnapshot& latency = snapshot[stage];
+        out << string(GetTraceStageDepth(stage) * 2, ' ') << GetTraceStageName(stage) << ": "s << latency.GetCount() << " spans"s;
+        if (latency.GetCount() > 0) {
+            out << ", us: mean "s << latency.GetMean() / 1e3
+                << ", p50 "s << NanosecondsToMicroseconds(latency.GetPercentile(50))
+                << ", p90 "s << NanosecondsToMicroseconds(latency.GetPercentile(90))
+                << ", p99 "s << NanosecondsToMicroseconds(latency.GetPercentile(99))
+                << ", max "s << NanosecondsToMicroseconds(latency.GetMax())
+                << ", self "s << NanosecondsToMicroseconds(latency.GetSelfSum()) / latency.GetCount();
+        }
+        out << '\n';
+    }
+}
+
+void WritePrometheusMetrics(ostream& out, const TraceSnapshot& snapshot) {
+    out << "# HELP search_server_stage_duration_seconds Duration of search query stages.\n"s;
+    out << "# TYPE search_server_stage_duration_seconds histogram\n"s;
+    for (size_t index = 0; index < TRACE_STAGE_COUNT; ++index) {
+        const LatencySnapshot& latency = snapshot.stages[index];
+        const string_view name = GetTraceStageName(static_cast<TraceStage>(index));
+        // границы 2^k нс совпадают с границами корзин, поэтому накопленные числа точные
+        for (int exponent = PROMETHEUS_MIN_BUCKET_EXPONENT; exponent <= PROMETHEUS_MAX_BUCKET_EXPONENT; ++exponent) {
+            const uint64_t bound = uint64_t{1} << exponent;
+            out << "search_server_stage_duration_seconds_bucket{stage=\""s << name << "\",le=\""s
+                << NanosecondsToSeconds(bound) << "\"} "s << latency.GetCountAtMost(bound - 1) << '\n';
+        }
+        out << "search_server_stage_duration_seconds_bucket{stage=\""s << name << "\",le=\"+Inf\"} "s << latency.GetCount() << '\n';
+        out << "search_server_stage_duration_seconds_sum{stage=\""s << name << "\"} "s << NanosecondsToSeconds(latency.GetSum()) << '\n';
+        out << "search_server_stage_duration_seconds_count{stage=\""s << name << "\"} "s << latency.GetCount() << '\n';
+    }
+    out << "# HELP search_server_stage_self_seconds_total Time spent in search query stages excluding nested stages.\n"s;
+    out << "# TYPE search_server_stage_self_seconds_total counter\n"s;
+    for (size_t index = 0; index < TRACE_STAGE_COUNT; ++index) {
+        out << "search_server_stage_self_seconds_total{stage=\""s << GetTraceStageName(static_cast<TraceStage>(index)) << "\"} "s
+            << NanosecondsToSeconds(snapshot.stages[index].GetSelfSum()) << '\n';
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// трассировка этапов поиска: TRACE_SPAN(STAGE) замеряет время до конца области видимости с точностью
+// до наносекунд и записывает его в гистограмму этапа; гистограммы у каждого потока свои, поэтому запись
+// не требует ни блокировок, ни атомарных операций чтения-изменения-записи
+// сборка с -DSEARCH_SERVER_TRACING=OFF (макрос SEARCH_SERVER_TRACING не определен) убирает замеры целиком:
+// TRACE_SPAN раскрывается в пустую инструкцию, а снимок остается пустым
+
+// этапы выполнения запроса; этапы вложены друг в друга, как области видимости их замеров:
+// QUERY
+//   PARSE             разбор запроса и раскрытие нечетких слов
+//   TERM_LOOKUP       поиск списков документов слов и выбор стратегии
+//   MINUS_EXCLUSION   построение фильтра минус-слов
+//   SCORING           обход списков и вычисление релевантности
+//     FILTERING       отдельный проход проверки найденных документов (удаленные, минус-слова, предикат);
+//                     стратегии документ за документом проверяют документ при оценке, и там проверка
+//                     входит в SCORING -- замер каждого документа стоил бы дороже самой проверки
+//   TOP_K             отбор и сортировка выдачи
+enum class TraceStage {
+    QUERY,
+    PARSE,
+    TERM_LOOKUP,
+    MINUS_EXCLUSION,
+    SCORING,
+    FILTERING,
+    TOP_K,
+};
+
+const size_t TRACE_STAGE_COUNT = 7;
+
+std::string_view GetTraceStageName(TraceStage stage);
+// глубина вложенности этапа в схеме выше
+int GetTraceStageDepth(TraceStage stage);
+
+#ifdef SEARCH_SERVER_TRACING
+constexpr bool TRACING_ENABLED = true;
+#else
+constexpr bool TRACING_ENABLED = false;
+#endif
+
+// гистограмма длительностей в наносекундах с логарифмически-линейными корзинами, как в HdrHistogram:
+// значения меньше 16 хранятся точно, а каждый интервал [2^e, 2^(e+1)) делится на 16 равных корзин,
+// так что погрешность значения не больше 1/16 (6.25%) во всем диапазоне uint64_t
+// запись -- только из потока-владельца; чтение из других потоков видит согласованные значения каждой корзины
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static size_t GetBucketIndex(uint64_t value);
+    // наименьшее значение корзины
+    static uint64_t GetBucketLowerBound(size_t index);
+    // наибольшее значение корзины
+    static uint64_t GetBucketUpperBound(size_t index);
+
+    void Record(uint64_t value);
+    void Reset();
+
+    uint64_t GetCount(size_t index) const;
+    uint64_t GetSum() const;
+    uint64_t GetMax() const;
+
+private:
+    // один писатель: достаточно загрузить и сохранить значение, блокирующая инструкция не нужна
+    static void Increase(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+    std::atomic<uint64_t> sum_ = 0;
+    std::atomic<uint64_t> max_ = 0;
+};
+
+// сводка гистограмм всех потоков по одному этапу
+class LatencySnapshot {
+public:
+    LatencySnapshot();
+
+    // self_sum -- собственное время этапа в потоке гистограммы
+    void Add(const LatencyHistogram& histogram, uint64_t self_sum);
+    void Add(const LatencySnapshot& other);
+
+    uint64_t GetCount() const;
+    // суммарная длительность, нс
+    uint64_t GetSum() const;
+    // суммарная длительность без вложенных этапов, нс
+    uint64_t GetSelfSum() const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+    // наименьшее значение, не меньше которого percentile процентов замеров, с погрешностью корзины
+    uint64_t GetPercentile(double percentile) const;
+    // число замеров не больше value; точно, когда value + 1 -- граница корзины (например, степень двойки)
+    uint64_t GetCountAtMost(uint64_t value) const;
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t self_sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+struct TraceSnapshot {
+    std::array<LatencySnapshot, TRACE_STAGE_COUNT> stages;
+
+    const LatencySnapshot& operator[](TraceStage stage) const {
+        return stages[static_cast<size_t>(stage)];
+    }
+};
+
+// сводка по всем потокам, включая завершившиеся
+TraceSnapshot TakeTraceSnapshot();
+// обнуляет гистограммы; замеры, записываемые в этот момент другими потоками, могут частично уцелеть
+void ResetTraceHistograms();
+
+// этапы деревом: число, среднее, перцентили и максимум в микросекундах
+void PrintTraceSnapshot(std::ostream& out, const TraceSnapshot& snapshot);
+// формат Prometheus: гистограмма search_server_stage_duration_seconds с меткой stage и границами корзин
+// 2^k нс от 1 мкс до 17 с, а также счетчик search_server_stage_self_seconds_total
+void WritePrometheusMetrics(std::ostream& out, const TraceSnapshot& snapshot);
+
+namespace trace_detail {
+
+void RecordSpan(TraceStage stage, uint64_t duration, uint64_t self_duration);
+
+}  // namespace trace_detail
+
+// длительности этапов одного запроса: пока объект жив, замеры его потока прибавляются и к durations
+class TraceStageCollector {
+public:
+    explicit TraceStageCollector(std::array<std::chrono::nanoseconds, TRACE_STAGE_COUNT>& durations);
+    ~TraceStageCollector();
+
+    TraceStageCollector(const TraceStageCollector&) = delete;
+    TraceStageCollector& operator=(const TraceStageCollector&) = delete;
+
+private:
+    std::array<std::chrono::nanoseconds, TRACE_STAGE_COUNT>* previous_durations_;
+};
+
+// замер этапа; вложенный замер вычитает свою длительность из собственного времени объемлющего
+class TraceSpan {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TraceSpan(TraceStage stage)
+        : stage_(stage)
+        , parent_(current_span_)
+    {
+        current_span_ = this;
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan() {
+        const uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count();
+        current_span_ = parent_;
+        if (parent_) {
+            parent_->children_duration_ += duration;
+        }
+        trace_detail::RecordSpan(stage_, duration, duration - std::min(duration, children_duration_));
+        if (collected_durations_) {
+            (*collected_durations_)[static_cast<size_t>(stage_)] += std::chrono::nanoseconds(duration);
+        }
+    }
+
+private:
+    friend class TraceStageCollector;
+
+    static inline thread_local TraceSpan* current_span_ = nullptr;
+    static inline thread_local std::array<std::chrono::nanoseconds, TRACE_STAGE_COUNT>* collected_durations_ = nullptr;
+
+    const TraceStage stage_;
+    TraceSpan* const parent_;
+    uint64_t children_duration_ = 0;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+#define TRACE_CONCAT_INTERNAL(X, Y) X##Y
+#define TRACE_CONCAT(X, Y) TRACE_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_TRACING
+#define TRACE_SPAN(stage) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(TraceStage::stage)
+#else
+#define TRACE_SPAN(stage) static_cast<void>(0)
+#endif
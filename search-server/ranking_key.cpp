@@ -0,0 +1,118 @@
+#include "ranking_key.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// с этого размера поразрядная сортировка (12 проходов по массиву) быстрее сортировки сравнением
+const size_t RADIX_SORT_MIN_SIZE = 1024;
+
+struct RankedDocument {
+    RankingKey key;
+    uint32_t index;
+};
+
+bool IsKeyBefore(const RankedDocument& lhs, const RankedDocument& rhs) {
+    return lhs.key < rhs.key;
+}
+
+vector<RankedDocument> MakeRankedDocuments(const vector<Document>& documents) {
+    vector<RankedDocument> ranked_documents(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ranked_documents[i] = {MakeRankingKey(documents[i]), static_cast<uint32_t>(i)};
+    }
+    return ranked_documents;
+}
+
+// один устойчивый проход сортировки подсчетом по байту, который возвращает get_byte;
+// если байт у всех документов одинаков (например, старшие байты релевантности), проход пропускается
+template <typename ByteGetter>
+void SortByByte(vector<RankedDocument>& ranked_documents, vector<RankedDocument>& buffer, ByteGetter get_byte) {
+    array<size_t, 256> counts{};
+    for (const RankedDocument& ranked_document : ranked_documents) {
+        ++counts[get_byte(ranked_document)];
+    }
+    if (counts[get_byte(ranked_documents.front())] == ranked_documents.size()) {
+        return;
+    }
+    size_t offset = 0;
+    for (size_t& count : counts) {
+        const size_t bucket_size = count;
+        count = offset;
+        offset += bucket_size;
+    }
+    for (const RankedDocument& ranked_document : ranked_documents) {
+        buffer[counts[get_byte(ranked_document)]++] = ranked_document;
+    }
+    ranked_documents.swap(buffer);
+}
+
+// LSD: сначала байты id от младшего к старшему, затем байты score; устойчивость проходов сохраняет
+// порядок, заданный младшими байтами
+void RadixSort(vector<RankedDocument>& ranked_documents) {
+    vector<RankedDocument> buffer(ranked_documents.size());
+    for (int shift = 0; shift < 32; shift += 8) {
+        SortByByte(ranked_documents, buffer, [shift](const RankedDocument& ranked_document) {
+            return (ranked_document.key.id >> shift) & 0xFF;
+        });
+    }
+    for (int shift = 0; shift < 64; shift += 8) {
+        SortByByte(ranked_documents, buffer, [shift](const RankedDocument& ranked_document) {
+            return static_cast<uint32_t>(ranked_document.key.score >> shift) & 0xFF;
+        });
+    }
+}
+
+// переставляет документы в порядке первых count элементов ranked_documents
+void ApplyRanking(vector<Document>& documents, const vector<RankedDocument>& ranked_documents, size_t count) {
+    vector<Document> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(documents[ranked_documents[i].index]);
+    }
+    documents = move(result);
+}
+
+}  // namespace
+
+RankingKey MakeRankingKey(const Document& document) {
+    const double steps = round(document.relevance / EPSILON);
+    uint64_t relevance = 0;
+    if (steps >= static_cast<double>(UINT32_MAX)) {
+        relevance = UINT32_MAX;
+    } else if (steps > 0.0) {
+        relevance = static_cast<uint64_t>(steps);
+    }
+    // смещение переводит рейтинг со знаком в беззнаковое число с тем же порядком
+    const uint32_t rating = static_cast<uint32_t>(document.rating) ^ 0x80000000u;
+    RankingKey key;
+    key.score = ((UINT32_MAX - relevance) << 32) | (UINT32_MAX - rating);
+    key.id = static_cast<uint32_t>(document.id);
+    return key;
+}
+
+void SortByRanking(vector<Document>& documents) {
+    auto ranked_documents = MakeRankedDocuments(documents);
+    if (ranked_documents.size() >= RADIX_SORT_MIN_SIZE) {
+        RadixSort(ranked_documents);
+    } else {
+        sort(ranked_documents.begin(), ranked_documents.end(), IsKeyBefore);
+    }
+    ApplyRanking(documents, ranked_documents, ranked_documents.size());
+}
+
+// отбор лучших за линейное время, затем сортировка только отобранных
+void SelectTopRanked(vector<Document>& documents, size_t count) {
+    if (documents.size() <= count) {
+        SortByRanking(documents);
+        return;
+    }
+    auto ranked_documents = MakeRankedDocuments(documents);
+    nth_element(ranked_documents.begin(), ranked_documents.begin() + count, ranked_documents.end(), IsKeyBefore);
+    sort(ranked_documents.begin(), ranked_documents.begin() + count, IsKeyBefore);
+    ApplyRanking(documents, ranked_documents, count);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// точность для переменных с плавающей точкой
+const double EPSILON = 1e-6;
+
+// ключ порядка выдачи: документы идут по возрастанию ключа
+// score упаковывает релевантность, округленную до шага EPSILON (старшие 32 бита), и рейтинг (младшие 32 бита),
+// оба инвертированы, чтобы большая релевантность и больший рейтинг давали меньший ключ; id в те же 64 бита
+// уже не помещается и сравнивается последним -- порядок полный, поэтому выдача не зависит ни от порядка,
+// в котором найдены документы, ни от политики выполнения
+// в отличие от сравнения |lhs - rhs| < EPSILON округление транзитивно: релевантности, отличающиеся меньше
+// чем на EPSILON, но попавшие в разные шаги, упорядочиваются по релевантности
+// релевантность больше 2^32 * EPSILON (около 4295) считается равной ей, отрицательная -- нулю
+struct RankingKey {
+    uint64_t score = 0;
+    uint32_t id = 0;
+};
+
+RankingKey MakeRankingKey(const Document& document);
+
+// сравнение без ветвлений
+inline bool operator<(const RankingKey& lhs, const RankingKey& rhs) {
+    return (lhs.score < rhs.score) | ((lhs.score == rhs.score) & (lhs.id < rhs.id));
+}
+
+// упорядочивает документы в порядке выдачи; большие наборы сортируются поразрядно (LSD radix sort) по байтам
+// ключа, остальные -- сравнением ключей
+void SortByRanking(std::vector<Document>& documents);
+// оставляет count лучших документов в порядке выдачи; остальные документы не упорядочиваются
+void SelectTopRanked(std::vector<Document>& documents, size_t count);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+// статистика коллекции документов, необходимая функциям ранжирования
+struct CollectionStatistics {
+    int document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// функции ранжирования передаются в FindTopDocuments параметром шаблона, поэтому
+// внутренний цикл поиска специализируется на этапе компиляции, без виртуальных вызовов
+// функция ранжирования создается один раз на запрос и должна предоставлять методы:
+//   double ComputeInverseDocumentFreq(size_t document_freq) const -- вес слова, вычисляется один раз на слово
+//   double ComputeTermScore(double term_freq, double inv_document_length, double inverse_document_freq) const
+//     -- вклад слова в релевантность документа, term_freq уже нормирована на длину документа
+// вклад слова должен быть неотрицательным, не убывать с ростом term_freq и не возрастать с ростом
+// inv_document_length: планировщик запросов оценивает по ним верхний предел вклада слова (см. query_plan.h)
+
+// TF-IDF, ранжирование по умолчанию
+class TfIdfScorer {
+public:
+    explicit TfIdfScorer(const CollectionStatistics& statistics)
+        : document_count_(statistics.document_count) {
+    }
+
+    double ComputeInverseDocumentFreq(size_t document_freq) const {
+        return std::log(document_count_ * 1.0 / document_freq);
+    }
+
+    double ComputeTermScore(double term_freq, double /*inv_document_length*/, double inverse_document_freq) const {
+        return term_freq * inverse_document_freq;
+    }
+
+private:
+    int document_count_;
+};
+
+// Okapi BM25
+// tf = count / length, поэтому count / (count + K1 * (1 - B + B * length / avgdl)) после деления
+// на length превращается в tf / (tf + K1 * (1 - B) / length + K1 * B / avgdl), где 1 / length
+// вычисляется при добавлении документа, а остальное -- один раз на запрос
+class Bm25Scorer {
+public:
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    explicit Bm25Scorer(const CollectionStatistics& statistics)
+        : document_count_(statistics.document_count)
+        , average_length_norm_(statistics.average_document_length > 0.0 ? K1 * B / statistics.average_document_length : 0.0) {
+    }
+
+    double ComputeInverseDocumentFreq(size_t document_freq) const {
+        return std::log(1.0 + (document_count_ - static_cast<double>(document_freq) + 0.5) / (document_freq + 0.5));
+    }
+
+    double ComputeTermScore(double term_freq, double inv_document_length, double inverse_document_freq) const {
+        return inverse_document_freq * (K1 + 1.0) * term_freq
+            / (term_freq + K1 * (1.0 - B) * inv_document_length + average_length_norm_);
+    }
+
+private:
+    int document_count_;
+    double average_length_norm_;
+};
@@ -1,55 +1,541 @@
 #include "search_server.h"
+#include "disk_index.h"
 
 using namespace std;
 
 // конструктор, принимающий на вход std::string
-SearchServer::SearchServer(const string& stop_words_text)
-    : SearchServer(string_view(stop_words_text))
+SearchServer::SearchServer(const string& stop_words_text, pmr::memory_resource* resource)
+    : SearchServer(string_view(stop_words_text), resource)
 {
 }
 
 // конструктор, принимающий на вход std::string_view
-SearchServer::SearchServer(const string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const string_view stop_words_text, pmr::memory_resource* resource)
+    : SearchServer(SplitIntoWords(stop_words_text), resource)
 {
 }
 
+// ключи словаря копии -- новые строки, поэтому таблица слов по номерам заполняется заново
+SearchServer::SearchServer(const SearchServer& other)
+    : stop_words_(other.stop_words_)
+    , word_to_document_freqs_(other.word_to_document_freqs_)
+    , term_words_(other.term_words_)
+    , term_postings_(other.term_postings_)
+    , free_term_ids_(other.free_term_ids_)
+    , document_id_to_ordinal_(other.document_id_to_ordinal_)
+    , ordinal_to_document_id_(other.ordinal_to_document_id_)
+    , document_ratings_(other.document_ratings_)
+    , document_statuses_(other.document_statuses_)
+    , document_word_counts_(other.document_word_counts_)
+    , document_inv_word_counts_(other.document_inv_word_counts_)
+    , forward_index_(other.forward_index_)
+    , has_forward_index_(other.has_forward_index_)
+    , document_ids_(other.document_ids_)
+    , removed_ordinals_(other.removed_ordinals_)
+    , removed_count_(other.removed_count_)
+    , total_word_count_(other.total_word_count_)
+    , fuzzy_max_edit_distance_(other.fuzzy_max_edit_distance_)
+    , fuzzy_penalty_(other.fuzzy_penalty_)
+    , impact_min_document_freq_(other.impact_min_document_freq_)
+    , term_freq_precision_(other.term_freq_precision_)
+    , forced_query_strategy_(other.forced_query_strategy_)
+    , query_planner_counters_(other.query_planner_counters_)
+    , memory_budget_(other.memory_budget_)
+    , memory_headroom_(other.memory_headroom_)
+{
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        term_words_[postings.term_id] = word;
+        term_postings_[postings.term_id] = &postings;
+    }
+    // деревья нечеткого поиска ссылаются на слова словаря, поэтому строятся по словарю копии
+    if (fuzzy_max_edit_distance_ > 0) {
+        BuildFuzzyWords();
+    }
+}
+
+SearchServer::PostingList::PostingList(const allocator_type& allocator)
+    : ordinals(allocator)
+    , term_freqs(allocator)
+    , block_max_term_freqs(allocator)
+    , block_min_inv_document_lengths(allocator)
+    , impacts(allocator)
+{
+}
+
+SearchServer::PostingList::PostingList(TermFreqPrecision precision, const allocator_type& allocator)
+    : ordinals(allocator)
+    , term_freqs(precision, allocator)
+    , block_max_term_freqs(allocator)
+    , block_min_inv_document_lengths(allocator)
+    , impacts(allocator)
+{
+}
+
+SearchServer::PostingList::PostingList(const PostingList& other, const allocator_type& allocator)
+    : term_id(other.term_id)
+    , ordinals(other.ordinals, allocator)
+    , term_freqs(other.term_freqs, allocator)
+    , removed_count(other.removed_count)
+    , max_term_freq(other.max_term_freq)
+    , min_inv_document_length(other.min_inv_document_length)
+    , block_max_term_freqs(other.block_max_term_freqs, allocator)
+    , block_min_inv_document_lengths(other.block_min_inv_document_lengths, allocator)
+    , impacts(other.impacts, allocator)
+{
+}
+
+SearchServer::PostingList::PostingList(PostingList&& other, const allocator_type& allocator)
+    : term_id(other.term_id)
+    , ordinals(move(other.ordinals), allocator)
+    , term_freqs(move(other.term_freqs), allocator)
+    , removed_count(other.removed_count)
+    , max_term_freq(other.max_term_freq)
+    , min_inv_document_length(other.min_inv_document_length)
+    , block_max_term_freqs(move(other.block_max_term_freqs), allocator)
+    , block_min_inv_document_lengths(move(other.block_min_inv_document_lengths), allocator)
+    , impacts(move(other.impacts), allocator)
+{
+}
+
+size_t SearchServer::PostingList::GetDocumentFreq() const {
+    return ordinals.size() - removed_count;
+}
+
+// пределы только расширяются: после удаления документов они остаются верными, хотя и менее точными,
+// и уточняются при уплотнении
+void SearchServer::PostingList::UpdateScoreBounds(size_t position, double term_freq, double inv_document_length) {
+    max_term_freq = max(max_term_freq, term_freq);
+    min_inv_document_length = min(min_inv_document_length, inv_document_length);
+    const size_t block = position / SCORE_BLOCK_SIZE;
+    if (block == block_max_term_freqs.size()) {
+        block_max_term_freqs.push_back(term_freq);
+        block_min_inv_document_lengths.push_back(inv_document_length);
+    } else {
+        block_max_term_freqs[block] = max(block_max_term_freqs[block], term_freq);
+        block_min_inv_document_lengths[block] = min(block_min_inv_document_lengths[block], inv_document_length);
+    }
+}
+
+void SearchServer::PostingList::RebuildScoreBounds(const pmr::vector<double>& inv_document_lengths) {
+    max_term_freq = 0.0;
+    min_inv_document_length = numeric_limits<double>::max();
+    block_max_term_freqs.clear();
+    block_min_inv_document_lengths.clear();
+    for (size_t j = 0; j < ordinals.size(); ++j) {
+        UpdateScoreBounds(j, term_freqs[j], inv_document_lengths[ordinals[j]]);
+    }
+}
+
+size_t SearchServer::PostingList::GetBlockCount() const {
+    return block_max_term_freqs.size();
+}
+
+int SearchServer::PostingList::GetBlockLastOrdinal(size_t block) const {
+    return ordinals[min((block + 1) * SCORE_BLOCK_SIZE, ordinals.size()) - 1];
+}
+
+namespace {
+
+// порядок таблицы частого слова: по убыванию частоты, при равной частоте -- по возрастанию номера
+template <typename Impact>
+bool IsImpactBefore(const Impact& lhs, const Impact& rhs) {
+    return lhs.term_freq > rhs.term_freq || (lhs.term_freq == rhs.term_freq && lhs.ordinal < rhs.ordinal);
+}
+
+}  // namespace
+
+void SearchServer::PostingList::BuildImpacts() {
+    impacts.clear();
+    impacts.reserve(min(ordinals.size(), IMPACT_TABLE_SIZE));
+    for (size_t j = 0; j < ordinals.size(); ++j) {
+        const Impact impact{term_freqs[j], ordinals[j]};
+        if (impacts.size() == IMPACT_TABLE_SIZE && !IsImpactBefore(impact, impacts.back())) {
+            continue;
+        }
+        impacts.insert(upper_bound(impacts.begin(), impacts.end(), impact, IsImpactBefore<Impact>), impact);
+        if (impacts.size() > IMPACT_TABLE_SIZE) {
+            impacts.pop_back();
+        }
+    }
+}
+
+// документ, которого нет в таблице, попадает в нее, если его частота не меньше последней частоты таблицы
+// (вытесненный документ удовлетворяет условию таблицы) или если таблица содержит весь список
+// документ, частота которого уменьшилась, выпадает из таблицы; если таблица опустела наполовину, она строится заново
+void SearchServer::PostingList::UpdateImpact(int ordinal, double term_freq) {
+    const auto it = find_if(impacts.begin(), impacts.end(), [ordinal](const Impact& impact) {
+        return impact.ordinal == ordinal;
+    });
+    if (it != impacts.end()) {
+        impacts.erase(it);
+    }
+    // документ ordinal уже есть в списке
+    const bool is_complete = impacts.size() + 1 == ordinals.size();
+    const Impact impact{term_freq, ordinal};
+    if (is_complete || (!impacts.empty() && term_freq >= impacts.back().term_freq)) {
+        impacts.insert(upper_bound(impacts.begin(), impacts.end(), impact, IsImpactBefore<Impact>), impact);
+        if (impacts.size() > IMPACT_TABLE_SIZE) {
+            impacts.pop_back();
+        }
+    }
+    if (impacts.size() < IMPACT_TABLE_SIZE / 2 && impacts.size() < ordinals.size()) {
+        BuildImpacts();
+    }
+}
+
+void SearchServer::PostingList::EraseImpact(int ordinal) {
+    const auto it = find_if(impacts.begin(), impacts.end(), [ordinal](const Impact& impact) {
+        return impact.ordinal == ordinal;
+    });
+    if (it == impacts.end()) {
+        return;
+    }
+    impacts.erase(it);
+    if (impacts.size() < IMPACT_TABLE_SIZE / 2 && impacts.size() < ordinals.size()) {
+        BuildImpacts();
+    }
+}
+
 // добавляет сведения о документе в хранилище
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_id_to_ordinal_.count(document_id) > 0)) {
         throw invalid_argument("Invalid document_id"s);
     }
-    const auto words = SplitIntoWordsNoStop(document);
+    AddTokenizedDocument(document_id, SplitIntoWordsNoStop(document), status, ratings);
+}
+
+// разбивает текст документа на слова без стоп-слов, проверяя их корректность
+vector<string_view> SearchServer::TokenizeDocument(const string_view document) const {
+    return SplitIntoWordsNoStop(document);
+}
 
+// добавляет документ, уже разбитый на слова
+void SearchServer::AddTokenizedDocument(int document_id, const vector<string_view>& words, DocumentStatus status, const vector<int>& ratings) {
+    if ((document_id < 0) || (document_id_to_ordinal_.count(document_id) > 0)) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    ReserveDocumentMemory(words);
+
+    // порядковые номера выдаются по возрастанию, поэтому списки документов остаются упорядоченными
+    const int ordinal = static_cast<int>(ordinal_to_document_id_.size());
     const double inv_word_count = 1.0 / words.size();
-	unordered_set<std::string> words_values;
+    // вхождения упорядочиваются по номеру слова: повторы слова оказываются рядом, а слова документа -- в порядке
+    // прямого индекса; частота накапливается точно и записывается в список один раз, когда документ разобран
+    // целиком, -- округленные частоты не накапливают ошибку округления
+    vector<pair<int, PostingList*>> occurrences;
+    occurrences.reserve(words.size());
     for (const string_view word : words) {
-        auto it = words_values.emplace(string(word));
-        string_view word_view = *it.first;
-        word_to_document_freqs_[word_view][document_id] += inv_word_count;
-        document_id_to_word_freqs_[document_id][word_view] += inv_word_count;
+        auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
+            it = InsertWord(word);
+        }
+        occurrences.emplace_back(it->second.term_id, &it->second);
+    }
+    sort(occurrences.begin(), occurrences.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    vector<pair<int, double>> terms;
+    for (size_t i = 0; i < occurrences.size();) {
+        const auto [term_id, postings] = occurrences[i];
+        double term_freq = 0.0;
+        for (; i < occurrences.size() && occurrences[i].first == term_id; ++i) {
+            term_freq += inv_word_count;
+        }
+        terms.emplace_back(term_id, term_freq);
+        postings->ordinals.push_back(ordinal);
+        postings->term_freqs.PushBack(term_freq);
+        const size_t position = postings->ordinals.size() - 1;
+        postings->UpdateScoreBounds(position, postings->term_freqs[position], inv_word_count);
+        UpdateImpacts(*postings, ordinal, postings->term_freqs[position]);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, move(words_values) });
+    if (has_forward_index_) {
+        forward_index_.AddDocument(terms);
+    }
+    ordinal_to_document_id_.push_back(document_id);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    document_statuses_.push_back(status);
+    document_word_counts_.push_back(static_cast<int>(words.size()));
+    document_inv_word_counts_.push_back(inv_word_count);
+    removed_ordinals_.push_back(false);
+    document_id_to_ordinal_.emplace(document_id, ordinal);
+    total_word_count_ += words.size();
     document_ids_.insert(document_id);
 }
 
-// возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска с фильтрацией по статусу
-// версия с не определенной ExecutionPolicy просто вызывает последовательную
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+// меняет статус и рейтинг документа
+void SearchServer::UpdateDocumentMetadata(int document_id, DocumentStatus status, const vector<int>& ratings) {
+    const auto ordinal_it = document_id_to_ordinal_.find(document_id);
+    if (ordinal_it == document_id_to_ordinal_.end()) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    document_statuses_[ordinal_it->second] = status;
+    document_ratings_[ordinal_it->second] = ComputeAverageRating(ratings);
+}
+
+// заменяет текст документа, сравнивая старый и новый наборы слов
+void SearchServer::UpdateDocument(int document_id, const string_view document) {
+    const auto ordinal_it = document_id_to_ordinal_.find(document_id);
+    if (ordinal_it == document_id_to_ordinal_.end()) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    const auto words = SplitIntoWordsNoStop(document);
+    // уплотнение ради бюджета памяти перенумеровывает документы, поэтому номер читается после проверки
+    ReserveDocumentMemory(words);
+    const int ordinal = ordinal_it->second;
+    const double inv_word_count = 1.0 / words.size();
+    // частоты накапливаются так же, как в AddDocument, чтобы релевантность не зависела от способа добавления
+    map<string_view, double> new_word_freqs;
+    for (const string_view word : words) {
+        new_word_freqs[word] += inv_word_count;
+    }
+
+    // пределы вклада слов пересчитываются уже с новой длиной документа
+    document_inv_word_counts_[ordinal] = inv_word_count;
+    for (const auto word_it : FindDocumentWords(ordinal)) {
+        if (new_word_freqs.count(string_view(word_it->first)) > 0) {
+            continue;
+        }
+        ErasePosting(word_it->second, ordinal);
+        word_it->second.EraseImpact(ordinal);
+        if (word_it->second.ordinals.empty()) {
+            EraseWord(word_it);
+        } else {
+            word_it->second.RebuildScoreBounds(document_inv_word_counts_);
+        }
+    }
+    vector<pair<int, double>> terms;
+    for (const auto& [word, term_freq] : new_word_freqs) {
+        auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            word_it = InsertWord(word);
+        }
+        PostingList& postings = word_it->second;
+        const auto position = lower_bound(postings.ordinals.begin(), postings.ordinals.end(), ordinal);
+        const auto index = position - postings.ordinals.begin();
+        if (position == postings.ordinals.end() || *position != ordinal) {
+            postings.ordinals.insert(position, ordinal);
+            postings.term_freqs.Insert(index, term_freq);
+            // элементы после вставленного сдвинулись в соседние блоки
+            postings.RebuildScoreBounds(document_inv_word_counts_);
+        } else {
+            postings.term_freqs.Set(index, term_freq);
+            postings.UpdateScoreBounds(index, postings.term_freqs[index], inv_word_count);
+        }
+        UpdateImpacts(postings, ordinal, postings.term_freqs[index]);
+        terms.emplace_back(postings.term_id, term_freq);
+    }
+    if (has_forward_index_) {
+        sort(terms.begin(), terms.end());
+        forward_index_.ReplaceDocument(ordinal, terms);
+    }
+
+    total_word_count_ += static_cast<long long>(words.size()) - document_word_counts_[ordinal];
+    document_word_counts_[ordinal] = static_cast<int>(words.size());
+}
+
+// включает нечеткий поиск: плюс-слова запроса дополняются словами словаря, отстоящими от них
+// не более чем на max_edit_distance правок; вклад каждого такого слова умножается на penalty за каждую правку
+// max_edit_distance == 0 выключает нечеткий поиск
+void SearchServer::SetFuzzySearch(int max_edit_distance, double penalty) {
+    if (max_edit_distance < 0 || max_edit_distance > MAX_FUZZY_EDIT_DISTANCE) {
+        throw invalid_argument("Invalid fuzzy edit distance"s);
+    }
+    if (!(penalty > 0.0 && penalty <= 1.0)) {
+        throw invalid_argument("Invalid fuzzy penalty"s);
+    }
+    if (max_edit_distance == 0) {
+        fuzzy_words_.Clear();
+        fuzzy_reversed_words_.Clear();
+    } else if (fuzzy_max_edit_distance_ == 0) {
+        BuildFuzzyWords();
+    }
+    fuzzy_max_edit_distance_ = max_edit_distance;
+    fuzzy_penalty_ = penalty;
+}
+
+void SearchServer::SetImpactOrdering(size_t min_document_freq) {
+    impact_min_document_freq_ = min_document_freq;
+    // таблицы и перекодированные частоты меняют память мимо запаса бюджета, поэтому она будет посчитана заново
+    memory_headroom_ = 0;
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        if (min_document_freq > 0 && postings.ordinals.size() >= min_document_freq) {
+            postings.BuildImpacts();
+        } else {
+            postings.impacts.clear();
+            postings.impacts.shrink_to_fit();
+        }
+    }
+}
+
+void SearchServer::SetTermFreqPrecision(TermFreqPrecision precision) {
+    term_freq_precision_ = precision;
+    memory_headroom_ = 0;
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        if (postings.term_freqs.GetPrecision() == precision) {
+            continue;
+        }
+        vector<double> term_freqs(postings.ordinals.size());
+        for (size_t i = 0; i < term_freqs.size(); ++i) {
+            term_freqs[i] = has_forward_index_ ? *forward_index_.FindTermFreq(postings.ordinals[i], postings.term_id) : postings.term_freqs[i];
+        }
+        postings.term_freqs.Reset(precision);
+        postings.term_freqs.Reserve(term_freqs.size());
+        for (const double term_freq : term_freqs) {
+            postings.term_freqs.PushBack(term_freq);
+        }
+        postings.RebuildScoreBounds(document_inv_word_counts_);
+        if (!postings.impacts.empty()) {
+            postings.BuildImpacts();
+        }
+    }
+}
+
+TermFreqPrecision SearchServer::GetTermFreqPrecision() const {
+    return term_freq_precision_;
+}
+
+size_t SearchServer::GetTermFreqMemoryUsage() const {
+    size_t memory_usage = 0;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        memory_usage += postings.term_freqs.GetMemoryUsage();
+    }
+    return memory_usage;
+}
+
+MemoryUsage MemoryStats::GetTotal() const {
+    MemoryUsage total = dictionary;
+    total += postings;
+    total += forward_index;
+    total += document_metadata;
+    total += stop_words;
+    return total;
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+    using DictionaryEntry = decltype(word_to_document_freqs_)::value_type;
+    MemoryStats stats;
+    // список документов лежит в узле словаря: объект списка относится к спискам, а узел -- к словарю
+    const size_t word_count = word_to_document_freqs_.size();
+    stats.dictionary = GetTreeNodesMemoryUsage<DictionaryEntry>(word_count);
+    stats.dictionary.payload_bytes -= word_count * sizeof(PostingList);
+    stats.postings.payload_bytes = word_count * sizeof(PostingList);
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        stats.dictionary += GetStringMemoryUsage(word);
+        stats.postings += GetVectorMemoryUsage(postings.ordinals);
+        stats.postings += postings.term_freqs.GetMemoryStats();
+        stats.postings += GetVectorMemoryUsage(postings.block_max_term_freqs);
+        stats.postings += GetVectorMemoryUsage(postings.block_min_inv_document_lengths);
+        stats.postings += GetVectorMemoryUsage(postings.impacts);
+    }
+
+    stats.dictionary += GetVectorMemoryUsage(term_words_);
+    stats.dictionary += GetVectorMemoryUsage(term_postings_);
+    stats.dictionary += GetVectorMemoryUsage(free_term_ids_);
+    stats.dictionary += fuzzy_words_.GetMemoryStats();
+    stats.dictionary += fuzzy_reversed_words_.GetMemoryStats();
+
+    stats.forward_index = forward_index_.GetMemoryStats();
+
+    stats.document_metadata = GetHashMapMemoryUsage(document_id_to_ordinal_);
+    stats.document_metadata += GetVectorMemoryUsage(ordinal_to_document_id_);
+    stats.document_metadata += GetVectorMemoryUsage(document_ratings_);
+    stats.document_metadata += GetVectorMemoryUsage(document_statuses_);
+    stats.document_metadata += GetVectorMemoryUsage(document_word_counts_);
+    stats.document_metadata += GetVectorMemoryUsage(document_inv_word_counts_);
+    stats.document_metadata += GetTreeNodesMemoryUsage<int>(document_ids_.size());
+    // битовая карта: бит на документ
+    stats.document_metadata += GetArrayMemoryUsage((removed_ordinals_.size() + 7) / 8, removed_ordinals_.capacity() / 8, 1);
+
+    stats.stop_words = stop_words_.GetMemoryStats();
+    return stats;
+}
+
+void SearchServer::SetMemoryBudget(size_t budget) {
+    memory_budget_ = budget;
+    memory_headroom_ = 0;
+}
+
+size_t SearchServer::GetMemoryBudget() const {
+    return memory_budget_;
+}
+
+// оценка памяти, которую займет документ из слов words
+// каждое слово считается новым для словаря: проверка словаря стоила бы столько же, сколько само добавление,
+// а массивы, растущие удвоением емкости, занимают в среднем вдвое больше своих элементов
+size_t SearchServer::EstimateDocumentMemory(const vector<string_view>& words) const {
+    using namespace memory_usage_detail;
+    using DictionaryEntry = decltype(word_to_document_freqs_)::value_type;
+    // элементы массивов по порядковому номеру, узел множества id, узел и корзина хэш-таблицы
+    const size_t document_bytes = 2 * (3 * sizeof(int) + sizeof(DocumentStatus) + sizeof(double) + sizeof(size_t) + sizeof(uint32_t) + 1)
+        + GetAllocatedSize(TREE_NODE_HEADER_SIZE + sizeof(int))
+        + GetAllocatedSize(HASH_NODE_HEADER_SIZE + sizeof(pair<const int, int>)) + 2 * sizeof(void*);
+    // элемент списка документов с пределами вклада блока и элемент прямого индекса
+    const size_t posting_bytes = 2 * (sizeof(int) + sizeof(double)) + 2 * 2 * sizeof(double) / SCORE_BLOCK_SIZE + 1
+        + 2 * (sizeof(int) + sizeof(double));
+    // узел словаря, первые блоки четырех массивов списка документов и элемент таблицы слов по номерам
+    const size_t new_word_bytes = GetAllocatedSize(TREE_NODE_HEADER_SIZE + sizeof(DictionaryEntry)) + 4 * GetAllocatedSize(sizeof(double))
+        + 2 * sizeof(string_view);
+
+    size_t bytes = document_bytes;
+    for (const string_view word : words) {
+        bytes += posting_bytes + new_word_bytes;
+        if (word.size() > STRING_INLINE_CAPACITY) {
+            bytes += GetAllocatedSize(word.size() + 1);
+        }
+    }
+    return bytes;
+}
+
+// проверяет, что документ из слов words помещается в бюджет памяти (см. SetMemoryBudget), и вычитает
+// его оценку из запаса; исключение бросается до любых изменений индекса
+void SearchServer::ReserveDocumentMemory(const vector<string_view>& words) {
+    if (memory_budget_ == 0) {
+        return;
+    }
+    const size_t bytes = EstimateDocumentMemory(words);
+    if (bytes > memory_headroom_) {
+        const auto count_headroom = [this] {
+            const size_t total_bytes = GetMemoryStats().GetTotal().GetTotalBytes();
+            memory_headroom_ = total_bytes < memory_budget_ ? memory_budget_ - total_bytes : 0;
+        };
+        count_headroom();
+        if (bytes > memory_headroom_ && removed_count_ > 0) {
+            Compact();
+            count_headroom();
+        }
+        if (bytes > memory_headroom_) {
+            throw length_error("Memory budget exceeded"s);
+        }
+    }
+    memory_headroom_ -= bytes;
+}
+
+void SearchServer::UpdateImpacts(PostingList& postings, int ordinal, double term_freq) {
+    if (impact_min_document_freq_ == 0 || postings.ordinals.size() < impact_min_document_freq_) {
+        return;
+    }
+    // слово только что стало частым
+    if (postings.impacts.empty()) {
+        postings.BuildImpacts();
+    } else {
+        postings.UpdateImpact(ordinal, term_freq);
+    }
+}
+
+void SearchServer::SetQueryStrategy(optional<QueryStrategy> strategy) {
+    if (strategy == QueryStrategy::CONJUNCTIVE) {
+        throw invalid_argument("Conjunctive strategy is chosen by required words only"s);
+    }
+    forced_query_strategy_ = strategy;
 }
 
-// возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска
-// версия с не определенной ExecutionPolicy просто вызывает последовательную
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const {
-    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
+QueryPlannerMetrics SearchServer::GetQueryPlannerMetrics() const {
+    return query_planner_counters_.Get();
 }
 
 // возвращает общее количество документов
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ids_.size();
 }
 
 // возвращает все плюс-слова запроса, содержащиеся в документе и статус документа
@@ -59,65 +545,117 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const str
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, const string_view raw_query, int document_id) const {
     const auto query = ParseQuery(raw_query, true);
+    const int ordinal = document_id_to_ordinal_.at(document_id);
     for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { vector<string_view>(), documents_.at(document_id).status };
+        if (!FindDocumentWord(ordinal, word).empty()) {
+            return { vector<string_view>(), document_statuses_[ordinal] };
+        }
+    }
+    for (const string_view word : query.required_words) {
+        if (FindDocumentWord(ordinal, word).empty()) {
+            return { vector<string_view>(), document_statuses_[ordinal] };
         }
     }
     vector<string_view> matched_words;
     matched_words.reserve(query.plus_words.size());
+    // возвращаем ссылки на слова словаря, а не запроса, чтобы результат не зависел от времени жизни запроса
     for_each(query.plus_words.begin(), query.plus_words.end(),
-        [this, document_id, &matched_words](auto& word) {
-            if (document_id_to_word_freqs_.at(document_id).count(word) != 0) {
-                matched_words.push_back(word);
+        [this, ordinal, &matched_words](auto& word) {
+            const string_view document_word = FindDocumentWord(ordinal, word);
+            if (!document_word.empty()) {
+                matched_words.push_back(document_word);
             }
         });
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy&, const string_view raw_query, int document_id) const {
     const auto query = ParseQuery(raw_query);
+    const int ordinal = document_id_to_ordinal_.at(document_id);
     for (const string_view word : query.minus_words) {
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { vector<string_view>(), documents_.at(document_id).status };
+        if (!FindDocumentWord(ordinal, word).empty()) {
+            return { vector<string_view>(), document_statuses_[ordinal] };
         }
     }
-    vector<string_view> matched_words;
-    matched_words.reserve(query.plus_words.size());
- 
-    for_each(execution::par, query.plus_words.begin(), query.plus_words.end(),
-        [this, document_id, &matched_words](auto& word) {
-            if (document_id_to_word_freqs_.at(document_id).count(word) != 0) {
-                matched_words.push_back(word);
-            }
+    for (const string_view word : query.required_words) {
+        if (FindDocumentWord(ordinal, word).empty()) {
+            return { vector<string_view>(), document_statuses_[ordinal] };
+        }
+    }
+    // каждый поток пишет только в свой элемент: слово словаря или пустую строку, если слова в документе нет
+    vector<string_view> matched_words(query.plus_words.size());
+    transform(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
+        [this, ordinal](string_view word) {
+            return FindDocumentWord(ordinal, word);
         });
-   const auto word_check = [this, document_id](string_view word){
-        auto f = word_to_document_freqs_.find(word);
-        return f != word_to_document_freqs_.end() && f->second.count(document_id);
-    };
-    auto word_end = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), word_check);
-    sort(execution::par, matched_words.begin(), word_end);
-    matched_words.erase(unique(execution::par, matched_words.begin(), word_end), matched_words.end());
-    return { matched_words, documents_.at(document_id).status };
+    sort(execution::par, matched_words.begin(), matched_words.end());
+    matched_words.erase(unique(execution::par, matched_words.begin(), matched_words.end()), matched_words.end());
+    if (!matched_words.empty() && matched_words.front().empty()) {
+        matched_words.erase(matched_words.begin());
+    }
+    return { matched_words, document_statuses_[ordinal] };
+}
+
+MatchedDocuments SearchServer::MatchDocuments(const string_view raw_query, const vector<int>& document_ids) const {
+    return MatchDocuments(execution::seq, raw_query, document_ids);
 }
 
 // возвращает итератор, указывающий на id первого документа, хранящегося в поисковом сервере
-const set<int>::const_iterator SearchServer::begin() const {
+const pmr::set<int>::const_iterator SearchServer::begin() const {
     return document_ids_.begin();
 }
 
 // возвращает итератор, указывающий на id последнего документа, хранящегося в поисковом сервере
-const set<int>::const_iterator SearchServer::end() const {
+const pmr::set<int>::const_iterator SearchServer::end() const {
     return document_ids_.end();
 }
 
 // возвращает частоты слов в документе с данным id
-const map<string_view, double, less<>>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const map<string_view, double, less<>> empty_result;
-    if (document_id_to_word_freqs_.count(document_id) == 0) {
-        return empty_result;
+SearchServer::WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    if (!has_forward_index_) {
+        throw logic_error("Forward index is disabled"s);
+    }
+    const auto it = document_id_to_ordinal_.find(document_id);
+    if (it == document_id_to_ordinal_.end()) {
+        return {};
     }
-    return document_id_to_word_freqs_.at(document_id);
+    const int ordinal = it->second;
+    return WordFrequencies(forward_index_.GetTermIds(ordinal), forward_index_.GetTermFreqs(ordinal),
+        forward_index_.GetTermCount(ordinal), term_words_.data(), this);
+}
+
+// слова с частотами перечисляются по спискам документов в порядке номеров слов, поэтому слова каждого
+// документа попадают в прямой индекс уже упорядоченными
+void SearchServer::SetForwardIndex(bool enabled) {
+    if (enabled == has_forward_index_) {
+        return;
+    }
+    has_forward_index_ = enabled;
+    memory_headroom_ = 0;
+    forward_index_.Clear();
+    if (!enabled) {
+        return;
+    }
+    vector<const PostingList*> postings_by_term(term_words_.size(), nullptr);
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        postings_by_term[postings.term_id] = &postings;
+    }
+    vector<vector<pair<int, double>>> ordinal_to_terms(ordinal_to_document_id_.size());
+    for (const PostingList* postings : postings_by_term) {
+        if (postings == nullptr) {
+            continue;
+        }
+        for (size_t i = 0; i < postings->ordinals.size(); ++i) {
+            ordinal_to_terms[postings->ordinals[i]].emplace_back(postings->term_id, postings->term_freqs[i]);
+        }
+    }
+    for (const auto& terms : ordinal_to_terms) {
+        forward_index_.AddDocument(terms);
+    }
+}
+
+bool SearchServer::HasForwardIndex() const {
+    return has_forward_index_;
 }
 
 // удаляет документ из поискового сервера по id
@@ -125,9 +663,193 @@ void SearchServer::RemoveDocument(int document_id) {
     RemoveDocument(execution::seq, document_id);
 }
 
+// удаляет документ с порядковым номером ordinal из списка документов слова
+void SearchServer::ErasePosting(PostingList& postings, int ordinal) {
+    const auto it = lower_bound(postings.ordinals.begin(), postings.ordinals.end(), ordinal);
+    if (it == postings.ordinals.end() || *it != ordinal) {
+        return;
+    }
+    const auto index = it - postings.ordinals.begin();
+    postings.ordinals.erase(it);
+    postings.term_freqs.Erase(index);
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
+
+void SearchServer::Compact() {
+    Compact(execution::seq);
+}
+
+// удаленные документы не записываются, а живые нумеруются подряд в прежнем порядке, поэтому списки документов
+// остаются упорядоченными
+void SearchServer::WriteDiskIndex(const string& path) const {
+    DiskIndexWriter writer(path);
+    for (const string& word : stop_words_) {
+        writer.AddStopWord(word);
+    }
+    vector<int> new_ordinals(ordinal_to_document_id_.size(), -1);
+    int live_count = 0;
+    for (size_t ordinal = 0; ordinal < ordinal_to_document_id_.size(); ++ordinal) {
+        if (removed_ordinals_[ordinal]) {
+            continue;
+        }
+        new_ordinals[ordinal] = live_count++;
+        writer.AddDocument(ordinal_to_document_id_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal], document_inv_word_counts_[ordinal]);
+    }
+    vector<int> ordinals;
+    vector<double> term_freqs;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        ordinals.clear();
+        term_freqs.clear();
+        for (size_t i = 0; i < postings.ordinals.size(); ++i) {
+            const int new_ordinal = new_ordinals[postings.ordinals[i]];
+            if (new_ordinal >= 0) {
+                ordinals.push_back(new_ordinal);
+                term_freqs.push_back(postings.term_freqs[i]);
+            }
+        }
+        if (!ordinals.empty()) {
+            writer.AddPostingList(word, ordinals, term_freqs);
+        }
+    }
+    writer.Finish(total_word_count_);
+}
+
+// отмечает документ удаленным; слова документа остаются в словаре до уплотнения, но их IDF
+// сразу вычисляется без учета удаленного документа: у каждого слова документа увеличивается число
+// удаленных, так что отметка проходит по всем словам документа
+// возвращает false, если документа с таким id нет
+bool SearchServer::MarkDocumentRemoved(int document_id) {
+    const auto ordinal_it = document_id_to_ordinal_.find(document_id);
+    if (ordinal_it == document_id_to_ordinal_.end()) {
+        return false;
+    }
+    const int ordinal = ordinal_it->second;
+    for (const auto word_it : FindDocumentWords(ordinal)) {
+        ++word_it->second.removed_count;
+    }
+    removed_ordinals_[ordinal] = true;
+    ++removed_count_;
+    total_word_count_ -= document_word_counts_[ordinal];
+    document_ids_.erase(document_id);
+    document_id_to_ordinal_.erase(ordinal_it);
+    return true;
+}
+
+bool SearchServer::NeedsCompaction() const {
+    return removed_count_ > TOMBSTONE_COMPACTION_RATIO * ordinal_to_document_id_.size();
+}
+
+// переносит сведения о документах на новые порядковые номера (-1 -- документ удален)
+// и убирает из словаря слова, которых больше нет ни в одном документе
+void SearchServer::CompactDocuments(const vector<int>& new_ordinals) {
+    size_t live_count = 0;
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
+        }
+        // новый номер не больше старого, поэтому сведения переносятся на уже освободившиеся места
+        ordinal_to_document_id_[live_count] = ordinal_to_document_id_[ordinal];
+        document_ratings_[live_count] = document_ratings_[ordinal];
+        document_statuses_[live_count] = document_statuses_[ordinal];
+        document_word_counts_[live_count] = document_word_counts_[ordinal];
+        document_inv_word_counts_[live_count] = document_inv_word_counts_[ordinal];
+        ++live_count;
+    }
+    ordinal_to_document_id_.resize(live_count);
+    document_ratings_.resize(live_count);
+    document_statuses_.resize(live_count);
+    document_word_counts_.resize(live_count);
+    document_inv_word_counts_.resize(live_count);
+    forward_index_.Compact(new_ordinals);
+    for (auto& [document_id, ordinal] : document_id_to_ordinal_) {
+        ordinal = new_ordinals[ordinal];
+    }
+    // номера слов освобождаются последними: на них ссылались слова удаленных документов в прямом индексе
+    for (auto it = word_to_document_freqs_.begin(); it != word_to_document_freqs_.end();) {
+        const auto next_it = next(it);
+        if (it->second.ordinals.empty()) {
+            EraseWord(it);
+        }
+        it = next_it;
+    }
+    removed_ordinals_.assign(live_count, false);
+    removed_count_ = 0;
+}
+
+// добавляет слово в словарь и выдает ему номер, освобожденный удаленным словом, или следующий
+SearchServer::Dictionary::iterator SearchServer::InsertWord(string_view word) {
+    const auto word_it = word_to_document_freqs_.emplace(piecewise_construct, forward_as_tuple(word), forward_as_tuple(term_freq_precision_)).first;
+    if (free_term_ids_.empty()) {
+        word_it->second.term_id = static_cast<int>(term_words_.size());
+        term_words_.push_back(word_it->first);
+        term_postings_.push_back(&word_it->second);
+    } else {
+        word_it->second.term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        term_words_[word_it->second.term_id] = word_it->first;
+        term_postings_[word_it->second.term_id] = &word_it->second;
+    }
+    if (fuzzy_max_edit_distance_ > 0) {
+        fuzzy_words_.Insert(word_it->first, word_it->second.term_id);
+        fuzzy_reversed_words_.Insert(word_it->first, word_it->second.term_id);
+    }
+    return word_it;
+}
+
+void SearchServer::EraseWord(Dictionary::iterator word_it) {
+    term_words_[word_it->second.term_id] = string_view();
+    term_postings_[word_it->second.term_id] = nullptr;
+    free_term_ids_.push_back(word_it->second.term_id);
+    if (fuzzy_max_edit_distance_ > 0) {
+        fuzzy_words_.Erase(word_it->first);
+        fuzzy_reversed_words_.Erase(word_it->first);
+    }
+    word_to_document_freqs_.erase(word_it);
+}
+
+// слова документа ordinal; без прямого индекса документ ищется в списке документов каждого слова
+vector<SearchServer::Dictionary::iterator> SearchServer::FindDocumentWords(int ordinal) {
+    vector<Dictionary::iterator> result;
+    if (has_forward_index_) {
+        const int* term_ids = forward_index_.GetTermIds(ordinal);
+        result.reserve(forward_index_.GetTermCount(ordinal));
+        for (size_t i = 0; i < forward_index_.GetTermCount(ordinal); ++i) {
+            result.push_back(word_to_document_freqs_.find(term_words_[term_ids[i]]));
+        }
+        return result;
+    }
+    for (auto it = word_to_document_freqs_.begin(); it != word_to_document_freqs_.end(); ++it) {
+        if (binary_search(it->second.ordinals.begin(), it->second.ordinals.end(), ordinal)) {
+            result.push_back(it);
+        }
+    }
+    return result;
+}
+
+int SearchServer::FindTermId(string_view word) const {
+    const auto word_it = word_to_document_freqs_.find(word);
+    return word_it == word_to_document_freqs_.end() ? -1 : word_it->second.term_id;
+}
+
+// слово словаря, если оно есть в документе ordinal, иначе пустая строка
+string_view SearchServer::FindDocumentWord(int ordinal, string_view word) const {
+    const auto word_it = word_to_document_freqs_.find(word);
+    if (word_it == word_to_document_freqs_.end()) {
+        return {};
+    }
+    const PostingList& postings = word_it->second;
+    const bool found = has_forward_index_
+        ? forward_index_.FindTermFreq(ordinal, postings.term_id) != nullptr
+        : binary_search(postings.ordinals.begin(), postings.ordinals.end(), ordinal);
+    return found ? string_view(word_it->first) : string_view();
+}
+
 // проверяет, является ли слово стоп-словом
 bool SearchServer::IsStopWord(const string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 // проверяет, не содержит ли слово недопустимые символы
@@ -165,14 +887,18 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         throw invalid_argument("Query word is empty"s);
     }
     bool is_minus = false;
+    bool is_required = false;
     if (text[0] == '-') {
         is_minus = true;
         text.remove_prefix(1);
+    } else if (text[0] == '+') {
+        is_required = true;
+        text.remove_prefix(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
+    if (text.empty() || text[0] == '-' || (is_required && text[0] == '+') || !IsValidWord(text)) {
         throw invalid_argument("Query word "s + string(text) + " is invalid"s);
     }
-    return {text, is_minus, IsStopWord(text)};
+    return {text, is_minus, is_required, IsStopWord(text)};
 }
 
 // парсинг поискового запроса
@@ -185,6 +911,9 @@ SearchServer::Query SearchServer::ParseQuery(const string_view text, bool uniqui
                 result.minus_words.push_back(query_word.data);
             } else {
                 result.plus_words.push_back(query_word.data);
+                if (query_word.is_required) {
+                    result.required_words.push_back(query_word.data);
+                }
             }
         }
     }
@@ -193,13 +922,140 @@ SearchServer::Query SearchServer::ParseQuery(const string_view text, bool uniqui
         result.minus_words.erase(unique(execution::par, result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
         sort(execution::par, result.plus_words.begin(), result.plus_words.end());
         result.plus_words.erase(unique(execution::par, result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
+        sort(result.required_words.begin(), result.required_words.end());
+        result.required_words.erase(unique(result.required_words.begin(), result.required_words.end()), result.required_words.end());
+    }
+    result.plus_word_weights.assign(result.plus_words.size(), 1.0);
+    return result;
+}
+
+// строит деревья нечеткого поиска по всем словам словаря
+void SearchServer::BuildFuzzyWords() {
+    vector<pair<string_view, int>> words;
+    words.reserve(word_to_document_freqs_.size());
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        words.emplace_back(word, postings.term_id);
+    }
+    fuzzy_words_.Build(words);
+    fuzzy_reversed_words_.Build(words);
+}
+
+// возвращает слова словаря, отстоящие от word не более чем на fuzzy_max_edit_distance_ правок, и расстояния до них
+// в слове на расстоянии d правки делятся между половинами слова запроса, и одной из половин достается не больше
+// d / 2 правок: слова с почти точной первой половиной ищутся в дереве слов, с почти точной второй -- в дереве
+// перевернутых слов; так обход начинается с узкого пути по половине слова, а не перебирает все короткие префиксы,
+// близкие к началу слова, которых в большом словаре тысячи
+vector<pair<int, int>> SearchServer::FindFuzzyWords(const string_view word) const {
+    u32string symbols = DecodeUtf8String(word);
+    vector<pair<int, int>> result;
+    const auto find_matches = [&](const WordTrie& trie, LevenshteinAutomaton automaton) {
+        trie.FindMatches(automaton, [&](int term_id, LevenshteinAutomaton::State state) {
+            result.emplace_back(term_id, automaton.Distance(state));
+        });
+    };
+    const size_t half = symbols.size() / 2;
+    const size_t reversed_half = symbols.size() - half;
+    find_matches(fuzzy_words_, LevenshteinAutomaton(symbols, fuzzy_max_edit_distance_, half, fuzzy_max_edit_distance_ / 2));
+    reverse(symbols.begin(), symbols.end());
+    find_matches(fuzzy_reversed_words_, LevenshteinAutomaton(move(symbols), fuzzy_max_edit_distance_, reversed_half, fuzzy_max_edit_distance_ / 2));
+    // слово, обе половины которого близки к половинам запроса, найдено дважды
+    sort(result.begin(), result.end());
+    result.erase(unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+// заменяет плюс-слова запроса на найденные нечетким поиском слова словаря с весами penalty^(число правок)
+// слово запроса дополняется не больше чем FUZZY_EXPANSION_LIMIT словами: сначала ближайшими, среди них --
+// встречающимися в большем числе документов, то есть скорее всего задуманными, а при равной частоте --
+// меньшими; частые слова к тому же отличаются малым IDF и почти всегда откладываются при отсечении
+// если слово найдено для нескольких слов запроса, берется наибольший вес
+void SearchServer::ExpandFuzzyWords(Query& query) const {
+    map<string_view, double> word_to_weight;
+    for (const string_view word : query.plus_words) {
+        // номер слова, расстояние и частота
+        vector<tuple<int, int, size_t>> candidates;
+        for (const auto& [term_id, distance] : FindFuzzyWords(word)) {
+            candidates.emplace_back(term_id, distance, term_postings_[term_id]->GetDocumentFreq());
+        }
+        // само слово, если оно есть в словаре, остается сверх ограничения
+        const bool has_word = any_of(candidates.begin(), candidates.end(), [](const auto& candidate) {
+            return get<1>(candidate) == 0;
+        });
+        const size_t count = min(candidates.size(), FUZZY_EXPANSION_LIMIT + (has_word ? 1 : 0));
+        partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [this](const auto& lhs, const auto& rhs) {
+            return tie(get<1>(lhs), get<2>(rhs), term_words_[get<0>(lhs)]) < tie(get<1>(rhs), get<2>(lhs), term_words_[get<0>(rhs)]);
+        });
+        for (size_t i = 0; i < count; ++i) {
+            const auto& [term_id, distance, document_freq] = candidates[i];
+            double& weight = word_to_weight[term_words_[term_id]];
+            weight = max(weight, pow(fuzzy_penalty_, distance));
+        }
+    }
+    query.plus_words.clear();
+    query.plus_word_weights.clear();
+    for (const auto [word, weight] : word_to_weight) {
+        query.plus_words.push_back(word);
+        query.plus_word_weights.push_back(weight);
+    }
+}
+
+// возвращает статистику коллекции для функций ранжирования
+CollectionStatistics SearchServer::GetCollectionStatistics() const {
+    CollectionStatistics statistics;
+    statistics.document_count = GetDocumentCount();
+    if (statistics.document_count > 0) {
+        statistics.average_document_length = total_word_count_ * 1.0 / statistics.document_count;
+    }
+    return statistics;
+}
+
+// разбирает поисковый запрос: повторы слов удаляются, нечеткие слова раскрываются
+SearchServer::Query SearchServer::ParseSearchQuery(const string_view raw_query) const {
+    TRACE_SPAN(PARSE);
+    auto query = ParseQuery(raw_query, true);
+    if (fuzzy_max_edit_distance_ > 0) {
+        ExpandFuzzyWords(query);
+    }
+    return query;
+}
+
+// возвращает списки документов плюс-слов запроса в порядке plus_words, nullptr для слов, которых нет в словаре
+vector<const SearchServer::PostingList*> SearchServer::FindPlusWordPostings(const Query& query) const {
+    TRACE_SPAN(TERM_LOOKUP);
+    vector<const PostingList*> result;
+    result.reserve(query.plus_words.size());
+    for (const string_view word : query.plus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        // слово, все документы которого удалены, ничего не добавляет к релевантности
+        result.push_back(it == word_to_document_freqs_.end() || it->second.GetDocumentFreq() == 0 ? nullptr : &it->second);
     }
     return result;
 }
 
-// рассчитывает IDF слова
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+// собирает множество документов, исключаемых минус-словами запроса
+// checked_count -- сколько раз множество будет проверено, от него зависит, какие списки выгоднее не копировать
+ExclusionFilter<SearchServer::Ordinals> SearchServer::BuildMinusWordsFilter(const Query& query, size_t checked_count) const {
+    TRACE_SPAN(MINUS_EXCLUSION);
+    vector<const Ordinals*> minus_lists;
+    for (const string_view word : query.minus_words) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            minus_lists.push_back(&it->second.ordinals);
+        }
+    }
+    return ExclusionFilter<Ordinals>(minus_lists, ordinal_to_document_id_.size(), checked_count);
+}
+
+bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    return MakeRankingKey(lhs) < MakeRankingKey(rhs);
+}
+
+SearchCursor::SearchCursor(const Document& last_document)
+    : last_document_(last_document) {
+}
+
+bool SearchCursor::IsBefore(const Document& document) const {
+    return !last_document_ || IsRankedBefore(*last_document_, document);
 }
 
 // выводит результаты поиска в консоль
@@ -239,9 +1095,10 @@ void FindTopDocuments(const SearchServer& search_server, const string& raw_query
 void MatchDocuments(const SearchServer& search_server, const string& query) {
     try {
         cout << "Матчинг документов по запросу: "s << query << endl;
-        for (const auto& document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        const auto matched_documents = search_server.MatchDocuments(query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            PrintMatchDocumentResult(document_ids[i], matched_documents.GetMatchedWords(i), matched_documents.statuses[i]);
         }
     } catch (const invalid_argument& e) {
         cout << "Ошибка матчинга документов на запрос "s << query << ": "s << e.what() << endl;
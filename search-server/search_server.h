@@ -3,14 +3,32 @@
 #include "document.h"
 #include "paginator.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "levenshtein_automaton.h"
+#include "exclusion_filter.h"
+#include "forward_index.h"
+#include "matched_documents.h"
+#include "memory_usage.h"
+#include "posting_intersection.h"
+#include "query_plan.h"
+#include "query_profile.h"
+#include "query_trace.h"
+#include "ranking_key.h"
+#include "scorer.h"
+#include "stop_word_set.h"
+#include "term_freq_column.h"
+#include "word_trie.h"
 
 #include <cmath>
 #include <execution>
+#include <limits>
 #include <map>
+#include <memory_resource>
 #include <numeric>
+#include <optional>
+#include <queue>
 #include <set>
-#include <unordered_set>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 using namespace std::string_literals;
@@ -18,66 +36,370 @@ using namespace std::string_literals;
 // максимальное число документов в поисковой выдаче
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
-// точность для переменных с плавающей точкой
-const double EPSILON = 1e-6;
+// максимальное допустимое число правок при нечетком поиске
+const int MAX_FUZZY_EDIT_DISTANCE = 2;
+// максимальное число похожих слов, которыми дополняется слово нечеткого запроса, не считая самого слова
+const size_t FUZZY_EXPANSION_LIMIT = 3;
+
+// доля удаленных документов среди всех порядковых номеров, при превышении которой индекс уплотняется
+const double TOMBSTONE_COMPACTION_RATIO = 0.25;
+
+// число элементов списка документов в блоке, для которого хранятся пределы вклада слова (Block-Max WAND)
+const size_t SCORE_BLOCK_SIZE = 64;
+
+// число документов с наибольшей частотой слова, которые хранятся для частых слов (см. SetImpactOrdering)
+const size_t IMPACT_TABLE_SIZE = 64;
+
+// FindTopDocumentsBatch выполняет вместе до QUERY_BATCH_SIZE запросов и накапливает их релевантности отрезками
+// по QUERY_BATCH_CHUNK_SIZE порядковых номеров: накопители отрезка занимают 8 КБ на каждый запрос, получающий
+// на нем вклады, и не больше 8 МБ на группу
+const size_t QUERY_BATCH_SIZE = 1024;
+const int QUERY_BATCH_CHUNK_SIZE = 1024;
+
+// порядок выдачи (см. RankingKey): по убыванию релевантности, при равной с точностью до EPSILON релевантности --
+// по убыванию рейтинга, затем по возрастанию id; порядок полный, поэтому страницы постраничной выдачи не пересекаются
+bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+// позиция в выдаче, с которой продолжается постраничный поиск (search_after)
+// курсор по умолчанию указывает на начало выдачи, курсор следующей страницы возвращается вместе со страницей
+class SearchCursor {
+public:
+    SearchCursor() = default;
+    explicit SearchCursor(const Document& last_document);
+
+    // идет ли документ в выдаче после курсора
+    bool IsBefore(const Document& document) const;
+
+private:
+    std::optional<Document> last_document_;
+};
+
+// страница результатов поиска; пустая страница означает конец выдачи
+struct DocumentPage {
+    std::vector<Document> documents;
+    SearchCursor next_cursor;
+};
+
+// память индексов сервера по частям (см. memory_usage.h); объект самого сервера не учитывается
+struct MemoryStats {
+    // узлы словаря и слова, не поместившиеся в объект строки
+    MemoryUsage dictionary;
+    // списки документов слов: порядковые номера, частоты, пределы вклада блоков и таблицы частых слов
+    MemoryUsage postings;
+    // частоты слов по документам (GetWordFrequencies)
+    MemoryUsage forward_index;
+    // id, рейтинги, статусы и длины документов, перевод id в порядковые номера, битовая карта удаленных
+    MemoryUsage document_metadata;
+    MemoryUsage stop_words;
+
+    MemoryUsage GetTotal() const;
+};
 
 class SearchServer {
 public:
+    using WordFrequencies = ::WordFrequencies;
+
+    // все индексы сервера размещаются в памяти, выделенной из resource; например, при перестроении индекса
+    // можно использовать std::pmr::monotonic_buffer_resource и освободить всю память разом вместе с ним
+    // ресурс должен жить дольше сервера; ресурс, который не освобождает память (monotonic), не вернет ее
+    // и при удалении документов
+    // ресурс не обязан быть потокобезопасным: параллельные методы сервера выделяют память из него только
+    // в вызывающем потоке
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string& stop_words_text);
-    explicit SearchServer(const std::string_view stop_words_text);
+    explicit SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(const std::string_view stop_words_text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // копия размещается в ресурсе по умолчанию
+    SearchServer(const SearchServer& other);
+    SearchServer(SearchServer&& other) = default;
 
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-    template <typename DocumentPredicate>
+    // разбор текста отделен от добавления, чтобы при массовой загрузке документы разбирались параллельно
+    // TokenizeDocument не меняет сервер и может выполняться одновременно с AddTokenizedDocument
+    // слова ссылаются на document и должны оставаться действительными до вызова AddTokenizedDocument
+    std::vector<std::string_view> TokenizeDocument(const std::string_view document) const;
+    void AddTokenizedDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, const std::vector<int>& ratings);
+
+    // меняет статус и рейтинг документа, не трогая индекс слов
+    void UpdateDocumentMetadata(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+    // заменяет текст документа: списки документов меняются только у слов, которые появились в документе
+    // или пропали из него, у остальных слов лишь пересчитывается частота
+    void UpdateDocument(int document_id, const std::string_view document);
+
+    // включает нечеткий поиск (max_edit_distance == 0 выключает его); по умолчанию он выключен: включение
+    // строит деревья слов словаря (на словаре в миллион слов -- секунды), а запрос с ним выполняется примерно
+    // в два раза дольше точного
+    void SetFuzzySearch(int max_edit_distance, double penalty);
+
+    // для слов, встречающихся не меньше чем в min_document_freq документах, хранится начало списка документов,
+    // упорядоченное по убыванию частоты слова, -- IMPACT_TABLE_SIZE документов с наибольшей частотой;
+    // таблица поддерживается при добавлении, изменении и удалении документов
+    // лучшие документы по запросу из одного такого слова обычно находятся по таблице, без обхода всего списка
+    // min_document_freq == 0 выключает таблицы
+    void SetImpactOrdering(size_t min_document_freq);
+
+    // представление частот слов в списках документов (см. term_freq_column.h): float и 8-битная шкала
+    // уменьшают списки ценой ограниченной ошибки ранжирования; частоты перекодируются из точных частот
+    // документов (GetWordFrequencies), поэтому возврат к DOUBLE восстанавливает точную релевантность;
+    // без прямого индекса (SetForwardIndex) частоты перекодируются из хранимых, и округление не обратимо
+    void SetTermFreqPrecision(TermFreqPrecision precision);
+    TermFreqPrecision GetTermFreqPrecision() const;
+    // байты, занятые частотами слов в списках документов
+    size_t GetTermFreqMemoryUsage() const;
+
+    // память индексов с разделением на данные и накладные расходы; обходит весь словарь и все документы
+    MemoryStats GetMemoryStats() const;
+    // ограничивает память индексов (GetMemoryStats().GetTotal()) значением budget байт; 0 -- без ограничения
+    // документ, который может не поместиться в бюджет, сначала освобождает место уплотнением индекса (если
+    // есть удаленные документы), а если и этого мало -- отклоняется исключением std::length_error, и сервер
+    // не меняется; так проверяются AddDocument, AddTokenizedDocument и UpdateDocument
+    // память считается заново, только когда запас до бюджета, оставшийся с прошлого подсчета, меньше оценки
+    // для документа: оценка учитывает каждое слово документа как новое слово словаря и рост массивов в среднем,
+    // поэтому бюджет может быть превышен лишь на запас емкости от удвоения массива списка документов
+    void SetMemoryBudget(size_t budget);
+    size_t GetMemoryBudget() const;
+
+    // стратегия обхода списков документов (см. query_plan.h); nullopt -- стратегию выбирает планировщик
+    // MAX_SCORE и BLOCK_MAX_WAND применимы только к поиску лучших документов, в остальных случаях вместо них
+    // используется DOCUMENT_AT_A_TIME; запросы с обязательными словами всегда выполняются пересечением списков
+    void SetQueryStrategy(std::optional<QueryStrategy> strategy);
+
+    // функция ранжирования задается параметром шаблона Scorer (см. scorer.h), например FindTopDocuments<Bm25Scorer>(query)
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Scorer = TfIdfScorer>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    template <typename Scorer = TfIdfScorer>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
-    template <typename ExecutionPolicy>
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const;
-    template <typename ExecutionPolicy>
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const;
 
+    // поиск с профилем: заполняет profile (см. query_profile.h) -- слова запроса и длины их списков, стратегию,
+    // счетчики обхода и проверок документов, время этапов и разложение релевантности каждого документа выдачи
+    // по словам; выдача та же, что и без профиля, а поиск без профиля счетчиков не содержит вовсе
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, QueryProfile& profile) const;
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, QueryProfile& profile) const;
+    template <typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, QueryProfile& profile) const;
+
+    // пакетное выполнение запросов для офлайновых задач: выдача для каждого запроса совпадает
+    // с FindTopDocuments<Scorer>(raw_query), а релевантность -- в пределах EPSILON (вклады слов складываются
+    // в другом порядке); запросы разбираются все сразу, группируются по словам, и список документов слова
+    // обходится один раз для всех запросов группы, в которых оно есть; вклад попадает в накопители всех
+    // таких запросов, затем для каждого запроса отбираются лучшие документы
+    // политика выполнения распределяет группы запросов по потокам
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries) const;
+    template <typename Scorer = TfIdfScorer>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+
+    // постраничный поиск: возвращает до page_size документов, следующих в выдаче за cursor
+    // сортируются не все найденные документы, а только page_size лучших из следующих за курсором,
+    // поэтому стоимость дальних страниц не растет вместе с номером страницы
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
+    DocumentPage FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentPredicate document_predicate) const;
+    template <typename Scorer = TfIdfScorer>
+    DocumentPage FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentStatus status) const;
+    template <typename Scorer = TfIdfScorer>
+    DocumentPage FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const;
+
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy, typename DocumentPredicate>
+    DocumentPage FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentPredicate document_predicate) const;
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    DocumentPage FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentStatus status) const;
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    DocumentPage FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const;
+
+    // план запроса: найденные слова с оценками их вклада и выбранная стратегия обхода списков документов
+    // top_count -- сколько лучших документов нужно, 0 -- нужны все найденные
+    template <typename Scorer = TfIdfScorer>
+    QueryPlan PlanQuery(const std::string_view raw_query, size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    // показатели выполнения, накопленные по всем запросам
+    QueryPlannerMetrics GetQueryPlannerMetrics() const;
+
     int GetDocumentCount() const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const;
 
-    const std::set<int>::const_iterator begin() const;
-    const std::set<int>::const_iterator end() const;
+    // сопоставляет запрос сразу с набором документов: запрос разбирается один раз, и для каждого слова
+    // запроса документы набора ищутся в его списке документов, а не слова -- в каждом документе
+    // параллельная версия делит набор на части, каждая из которых заполняет только свои биты результата
+    template <typename ExecutionPolicy>
+    MatchedDocuments MatchDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const;
+    MatchedDocuments MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    const std::pmr::set<int>::const_iterator begin() const;
+    const std::pmr::set<int>::const_iterator end() const;
 
-    const std::map<std::string_view, double, std::less<>>& GetWordFrequencies(int document_id) const;
+    // вид на прямой индекс (см. forward_index.h); для неизвестного id -- пустой вид
+    // без прямого индекса бросает std::logic_error, поэтому и RemoveDuplicates требует прямого индекса
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    // прямой индекс (слова каждого документа) нужен GetWordFrequencies и ускоряет удаление и изменение
+    // документов, MatchDocument и точное перекодирование частот; без него сервер занимает меньше памяти,
+    // а удаление и изменение документа просматривают весь словарь; включение строит индекс по спискам документов
+    // с хранимыми частотами (см. SetTermFreqPrecision)
+    void SetForwardIndex(bool enabled);
+    bool HasForwardIndex() const;
 
+    // документы удаляются логически: они отмечаются в битовой карте удаленных и пропускаются при поиске,
+    // а из списков документов слов физически убираются при уплотнении индекса (Compact); уплотнение
+    // запускается само, когда доля удаленных документов превышает TOMBSTONE_COMPACTION_RATIO
+    // отметка документа занимает время, пропорциональное числу его различных слов (у каждого слова
+    // учитывается удаленный документ), уплотнение -- пропорциональное размеру индекса
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
     void RemoveDocument(int document_id);
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // физически удаляет из индекса удаленные документы и перенумеровывает оставшиеся
+    template <typename ExecutionPolicy>
+    void Compact(ExecutionPolicy&& policy);
+    void Compact();
+
+    // записывает индекс для поиска с диска (DiskSearchServer, см. disk_index.h): документы без удаленных,
+    // стоп-слова, словарь и списки документов с хранимыми частотами (см. SetTermFreqPrecision)
+    void WriteDiskIndex(const std::string& path) const;
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::unordered_set<std::string> words_values;
+    using Ordinals = std::pmr::vector<int>;
+
+    // документы, содержащие слово: порядковые номера документов по возрастанию и частоты слова в них
+    // поддерживает uses-allocator construction, поэтому получает ресурс памяти от контейнера, в котором лежит
+    struct PostingList {
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+        explicit PostingList(const allocator_type& allocator = {});
+        PostingList(TermFreqPrecision precision, const allocator_type& allocator = {});
+        PostingList(const PostingList& other, const allocator_type& allocator);
+        PostingList(PostingList&& other, const allocator_type& allocator);
+
+        // число документов со словом без учета удаленных, по нему вычисляется IDF
+        size_t GetDocumentFreq() const;
+        // расширяет пределы вклада списка и блока, в который попадает элемент с номером position
+        void UpdateScoreBounds(size_t position, double term_freq, double inv_document_length);
+        // пересчитывает пределы по всему списку; нужно, когда элементы сдвигаются между блоками
+        void RebuildScoreBounds(const std::pmr::vector<double>& inv_document_lengths);
+        size_t GetBlockCount() const;
+        // последний порядковый номер блока
+        int GetBlockLastOrdinal(size_t block) const;
+        // строит таблицу документов с наибольшей частотой слова
+        void BuildImpacts();
+        // учитывает новую частоту слова в документе ordinal
+        void UpdateImpact(int ordinal, double term_freq);
+        // убирает из таблицы документ, удаленный из списка
+        void EraseImpact(int ordinal);
+
+        // номер слова в прямом индексе
+        int term_id = -1;
+        Ordinals ordinals;
+        // частоты хранятся в представлении, выбранном SetTermFreqPrecision; пределы вклада и таблица
+        // строятся по хранимым (округленным) частотам
+        TermFreqColumn term_freqs;
+        // число удаленных, но еще не убранных из списка документов
+        size_t removed_count = 0;
+        // наибольшая частота слова и наименьшая обратная длина документа в списке: функции ранжирования
+        // не убывают по частоте и не возрастают по обратной длине, поэтому по ним ограничивается вклад слова
+        // при удалении документов пределы не уменьшаются и остаются пределами, при уплотнении пересчитываются
+        double max_term_freq = 0.0;
+        double min_inv_document_length = std::numeric_limits<double>::max();
+        // те же пределы по блокам из SCORE_BLOCK_SIZE идущих подряд элементов списка: по ним при поиске
+        // пропускаются целые блоки, в которых документ не может набрать нужную релевантность
+        std::pmr::vector<double> block_max_term_freqs;
+        std::pmr::vector<double> block_min_inv_document_lengths;
+
+        struct Impact {
+            double term_freq;
+            int ordinal;
+        };
+        // не больше IMPACT_TABLE_SIZE документов по убыванию частоты (при равной частоте -- по возрастанию номера);
+        // в любом документе списка, которого нет в таблице, частота не больше последней частоты таблицы,
+        // поэтому таблица -- это начало списка, упорядоченного по частоте; пустая таблица не используется
+        // удаленные, но не убранные уплотнением документы остаются в таблице и пропускаются при поиске
+        std::pmr::vector<Impact> impacts;
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> document_id_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    using Dictionary = std::pmr::map<std::pmr::string, PostingList, std::less<>>;
+
+    const StopWordSet stop_words_;
+    // словарь: слово -> документы, его содержащие; ключи словаря хранят сами слова, остальные индексы ссылаются на них
+    Dictionary word_to_document_freqs_;
+    // слова словаря по номерам (PostingList::term_id); номера удаленных слов пусты и выдаются новым словам
+    std::pmr::vector<std::string_view> term_words_;
+    // списки документов слов по тем же номерам: нечеткий поиск узнает по ним частоту найденного слова
+    // без поиска в словаре
+    std::pmr::vector<const PostingList*> term_postings_;
+    std::pmr::vector<int> free_term_ids_;
+
+    // внутри сервера документы нумеруются подряд в порядке добавления, id документа переводится
+    // в порядковый номер один раз, а сведения о документах хранятся в массивах, индексируемых этим номером
+    // номера удаленных документов не переиспользуются до уплотнения индекса
+    std::pmr::unordered_map<int, int> document_id_to_ordinal_;
+    std::pmr::vector<int> ordinal_to_document_id_;
+    std::pmr::vector<int> document_ratings_;
+    std::pmr::vector<DocumentStatus> document_statuses_;
+    std::pmr::vector<int> document_word_counts_;
+    std::pmr::vector<double> document_inv_word_counts_;
+    ForwardIndex forward_index_;
+    bool has_forward_index_ = true;
+    std::pmr::set<int> document_ids_;
+    // битовая карта удаленных документов по порядковым номерам
+    std::pmr::vector<bool> removed_ordinals_;
+    size_t removed_count_ = 0;
+    // суммарное число слов во всех документах, нужно для средней длины документа
+    long long total_word_count_ = 0;
+    int fuzzy_max_edit_distance_ = 0;
+    double fuzzy_penalty_ = 1.0;
+    size_t impact_min_document_freq_ = 0;
+    TermFreqPrecision term_freq_precision_ = TermFreqPrecision::DOUBLE;
+    std::optional<QueryStrategy> forced_query_strategy_;
+    mutable QueryPlannerCounters query_planner_counters_;
+    // деревья слов словаря для нечеткого поиска (см. FindFuzzyWords): автомат Левенштейна проходит их, пропуская
+    // поддеревья "мертвых" префиксов целиком, а узлы лежат в массивах, а не разбросаны по памяти, как узлы словаря
+    // деревья строятся при включении нечеткого поиска и дальше меняются вместе со словарем, поэтому запросы
+    // только читают их; пока нечеткий поиск выключен, деревья пусты
+    // деревья -- вспомогательные, поэтому размещаются не в ресурсе сервера
+    WordTrie fuzzy_words_;
+    WordTrie fuzzy_reversed_words_{true};
+    size_t memory_budget_ = 0;
+    // байты, которые можно добавить без подсчета памяти; 0 -- считать при следующем добавлении
+    size_t memory_headroom_ = 0;
 
     bool IsStopWord(const std::string_view word) const;
     static bool IsValidWord(const std::string_view word);
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
+    static void ErasePosting(PostingList& postings, int ordinal);
+    // поддерживает таблицу частого слова после изменения его частоты в документе ordinal
+    void UpdateImpacts(PostingList& postings, int ordinal, double term_freq);
+    bool MarkDocumentRemoved(int document_id);
+    bool NeedsCompaction() const;
+    Dictionary::iterator InsertWord(std::string_view word);
+    void EraseWord(Dictionary::iterator word_it);
+    std::vector<Dictionary::iterator> FindDocumentWords(int ordinal);
+    std::string_view FindDocumentWord(int ordinal, std::string_view word) const;
+    // номер слова в прямом индексе; -1, если слова нет в словаре
+    int FindTermId(std::string_view word) const;
+    friend class ::WordFrequencies;
+    size_t EstimateDocumentMemory(const std::vector<std::string_view>& words) const;
+    void ReserveDocumentMemory(const std::vector<std::string_view>& words);
+    void CompactDocuments(const std::vector<int>& new_ordinals);
 
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
@@ -86,23 +408,74 @@ private:
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        // обязательные слова (+слово): документ должен содержать их все; они входят и в plus_words
+        std::vector<std::string_view> required_words;
+        // весовые коэффициенты плюс-слов, для слов из запроса равны 1, для найденных нечетким поиском -- меньше
+        std::vector<double> plus_word_weights;
     };
 
     Query ParseQuery(const std::string_view text, bool uniquify = false) const;
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    void BuildFuzzyWords();
+    // номера слов словаря, найденных нечетким поиском, и расстояния до них
+    std::vector<std::pair<int, int>> FindFuzzyWords(const std::string_view word) const;
+    void ExpandFuzzyWords(Query& query) const;
+    Query ParseSearchQuery(const std::string_view raw_query) const;
+    // слова запроса, длины списков и разложение релевантности выдачи для QueryProfile
+    template <typename Scorer>
+    void FillQueryProfile(const Query& query, const Scorer& scorer, const std::vector<Document>& documents, QueryProfile& profile) const;
+    CollectionStatistics GetCollectionStatistics() const;
+    std::vector<const PostingList*> FindPlusWordPostings(const Query& query) const;
+    ExclusionFilter<Ordinals> BuildMinusWordsFilter(const Query& query, size_t checked_count) const;
 
+    template <typename Scorer>
+    QueryPlan BuildQueryPlan(const Query& query, const Scorer& scorer, const std::vector<const PostingList*>& plus_postings, size_t top_count) const;
+
+    template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy&& policy, const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, size_t top_count) const;
+    template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocument(const std::execution::sequenced_policy&, const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, size_t top_count = 0) const;
+    template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocument(const std::execution::parallel_policy&, const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, size_t top_count = 0) const;
+    // is_excluded -- документ удален или содержит минус-слово; предикат вызывается только для остальных
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    bool IsDocumentAccepted(int ordinal, bool is_excluded, DocumentPredicate& document_predicate) const;
+    // выполняет план стратегией plan.strategy; TermFreq -- тип хранения частот, под который
+    // специализированы циклы обхода списков
+    template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ExecuteQueryPlan(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const;
+    template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocumentByTerms(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const;
+    template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocumentByDocuments(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const;
+    template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocumentMaxScore(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const;
+    template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocumentBlockMaxWand(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const;
+    template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    bool ForEachFoundDocumentByImpact(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const;
+    template <typename TermFreq, typename Scorer>
+    void FindTopDocumentsBatchGroup(const std::vector<Query>& queries, size_t begin, size_t end, const Scorer& scorer, std::vector<std::vector<Document>>& results) const;
+    template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+    void ForEachFoundDocumentConjunctive(const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document) const;
 };
 
 // конструктор-шаблон, принимающий на вход произвольный контейнер строк
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+SearchServer::SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource)
+    : stop_words_(stop_words)
+    , word_to_document_freqs_(resource)
+    , term_words_(resource)
+    , term_postings_(resource)
+    , free_term_ids_(resource)
+    , document_id_to_ordinal_(resource)
+    , ordinal_to_document_id_(resource)
+    , document_ratings_(resource)
+    , document_statuses_(resource)
+    , document_word_counts_(resource)
+    , document_inv_word_counts_(resource)
+    , forward_index_(resource)
+    , document_ids_(resource)
+    , removed_ordinals_(resource)
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid"s);
@@ -111,156 +484,1416 @@ SearchServer::SearchServer(const StringContainer& stop_words)
 
 // возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска с фильтрацией посредством функции-предиката
 // версия без ExecutionPolicy просто вызывает последовательную
-template <typename DocumentPredicate>
+template <typename Scorer, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, document_predicate);
+}
+
+// возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска с фильтрацией по статусу
+// версия без ExecutionPolicy просто вызывает последовательную
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, status);
+}
+
+// возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска
+// версия без ExecutionPolicy просто вызывает последовательную
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
 // возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска с фильтрацией посредством функции-предиката
-template <typename ExecutionPolicy, typename DocumentPredicate>
+template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-	const auto query = ParseQuery(raw_query, true);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    std::sort(
-        policy,
-        matched_documents.begin(),
-        matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-        }
-    );
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+    TRACE_SPAN(QUERY);
+    const auto query = ParseSearchQuery(raw_query);
+    const Scorer scorer(GetCollectionStatistics());
+    auto matched_documents = FindAllDocuments(policy, query, scorer, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+    TRACE_SPAN(TOP_K);
+    SelectTopRanked(matched_documents, MAX_RESULT_DOCUMENT_COUNT);
     return matched_documents;
 }
 
 // возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска с фильтрацией по статусу
-template <typename ExecutionPolicy>
+template <typename Scorer, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+    return FindTopDocuments<Scorer>(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
         return document_status == status;
     });
 }
 
 // возвращает первые MAX_RESULT_DOCUMENT_COUNT результатов поиска
-template <typename ExecutionPolicy>
+template <typename Scorer, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
-	return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+	return FindTopDocuments<Scorer>(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-// возвращает все результаты поиска с фильтрацией посредством функции-предиката
-// версия с не определенной ExecutionPolicy просто вызывает последовательную
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+// поиск с профилем: предикат оборачивается в ProfiledDocumentPredicate, и по его типу поиск включает счетчики
+template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, QueryProfile& profile) const {
+    profile = QueryProfile();
+    query_profile_detail::DocumentCheckCounters counters;
+    const Scorer scorer(GetCollectionStatistics());
+    Query query;
+    std::vector<Document> matched_documents;
+    // время этапов не включает заполнение профиля
+    {
+        TraceStageCollector stage_collector(profile.stage_durations);
+        TRACE_SPAN(QUERY);
+        query = ParseSearchQuery(raw_query);
+        matched_documents = FindAllDocuments(policy, query, scorer, ProfiledDocumentPredicate(document_predicate, profile, counters), MAX_RESULT_DOCUMENT_COUNT);
+        profile.found_document_count = matched_documents.size();
+        TRACE_SPAN(TOP_K);
+        SelectTopRanked(matched_documents, MAX_RESULT_DOCUMENT_COUNT);
+    }
+    profile.excluded_documents = counters.excluded_documents.load();
+    profile.predicate_calls = counters.predicate_calls.load();
+    profile.rejected_documents = counters.rejected_documents.load();
+    FillQueryProfile(query, scorer, matched_documents, profile);
+    return matched_documents;
 }
 
-// возвращает все результаты поиска с фильтрацией посредством функции-предиката
-// последовательная версия
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename Scorer, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, QueryProfile& profile) const {
+    return FindTopDocuments<Scorer>(policy, raw_query, [](int /*document_id*/, DocumentStatus status, int /*rating*/) {
+        return status == DocumentStatus::ACTUAL;
+    }, profile);
+}
+
+template <typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, QueryProfile& profile) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, profile);
+}
+
+// разложение релевантности повторяет оценку при поиске: частота берется из списка документов слова,
+// а вклады суммируются в порядке слов запроса
+template <typename Scorer>
+void SearchServer::FillQueryProfile(const Query& query, const Scorer& scorer, const std::vector<Document>& documents, QueryProfile& profile) const {
+    const auto plus_postings = FindPlusWordPostings(query);
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        TermProfile term;
+        term.word = std::string(query.plus_words[i]);
+        term.weight = query.plus_word_weights[i];
+        if (plus_postings[i]) {
+            term.posting_count = plus_postings[i]->ordinals.size();
+            term.inverse_document_freq = scorer.ComputeInverseDocumentFreq(plus_postings[i]->GetDocumentFreq()) * term.weight;
+        }
+        profile.plus_terms.push_back(std::move(term));
+    }
+    for (const std::string_view word : query.minus_words) {
+        TermProfile term;
+        term.word = std::string(word);
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it != word_to_document_freqs_.end()) {
+            term.posting_count = word_it->second.ordinals.size();
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        profile.minus_terms.push_back(std::move(term));
+    }
+    for (const std::string_view word : query.required_words) {
+        profile.required_words.emplace_back(word);
+    }
+
+    for (const Document& document : documents) {
+        DocumentExplanation explanation;
+        explanation.document_id = document.id;
+        explanation.relevance = document.relevance;
+        const int ordinal = document_id_to_ordinal_.at(document.id);
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            if (!plus_postings[i]) {
+                continue;
+            }
+            const PostingList& postings = *plus_postings[i];
+            const size_t position = AdvanceTo(postings.ordinals, 0, ordinal);
+            if (position == postings.ordinals.size() || postings.ordinals[position] != ordinal) {
+                continue;
             }
+            TermContribution contribution;
+            contribution.word = profile.plus_terms[i].word;
+            contribution.term_freq = postings.term_freqs[position];
+            contribution.inverse_document_freq = profile.plus_terms[i].inverse_document_freq;
+            contribution.score = scorer.ComputeTermScore(contribution.term_freq, document_inv_word_counts_[ordinal], contribution.inverse_document_freq);
+            explanation.contributions.push_back(std::move(contribution));
         }
+        profile.explanations.push_back(std::move(explanation));
     }
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+}
+
+// пакетное выполнение запросов
+// версия без ExecutionPolicy выполняет группы запросов последовательно
+template <typename Scorer>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const {
+    return FindTopDocumentsBatch<Scorer>(std::execution::seq, raw_queries);
+}
+
+template <typename Scorer, typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries) const {
+    // разбор последовательный: исключение из алгоритма с ExecutionPolicy вызвало бы std::terminate,
+    // а некорректный запрос в пакете должен приводить к invalid_argument, как и в FindTopDocuments
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string& raw_query : raw_queries) {
+        queries.push_back(ParseSearchQuery(raw_query));
+    }
+    const Scorer scorer(GetCollectionStatistics());
+    std::vector<std::vector<Document>> results(queries.size());
+    std::vector<size_t> group_begins;
+    for (size_t begin = 0; begin < queries.size(); begin += QUERY_BATCH_SIZE) {
+        group_begins.push_back(begin);
+    }
+    std::for_each(policy, group_begins.begin(), group_begins.end(), [&](size_t begin) {
+        const size_t end = std::min(begin + QUERY_BATCH_SIZE, queries.size());
+        switch (term_freq_precision_) {
+        case TermFreqPrecision::FLOAT:
+            FindTopDocumentsBatchGroup<float>(queries, begin, end, scorer, results);
+            break;
+        case TermFreqPrecision::QUANTIZED_8:
+            FindTopDocumentsBatchGroup<uint8_t>(queries, begin, end, scorer, results);
+            break;
+        default:
+            FindTopDocumentsBatchGroup<double>(queries, begin, end, scorer, results);
+            break;
+        }
+    });
+    return results;
+}
+
+// выполняет запросы [begin, end) слово за словом по отрезкам порядковых номеров
+// запросы группируются по спискам документов: список слова проходится на отрезке не больше одного раза для всех
+// запросов группы, где бы слово в них ни стояло; поэтому вклады слов запроса суммируются в порядке списков,
+// а не в порядке слов запроса, и релевантность может отличаться от FindTopDocuments в пределах EPSILON
+// на каждом отрезке слова запроса делятся, как в MaxScore, по пределам вклада на отрезке: слова с наименьшими
+// пределами, сумма которых ниже порога запроса, не порождают кандидатов, а ищутся только в документах,
+// найденных по остальным словам; список, который на отрезке нужен лишь так, не проходится
+// накопители выделяются только запросам, которые на текущем отрезке получают вклады
+template <typename TermFreq, typename Scorer>
+void SearchServer::FindTopDocumentsBatchGroup(const std::vector<Query>& queries, size_t begin, size_t end, const Scorer& scorer, std::vector<std::vector<Document>>& results) const {
+    const auto is_actual = [](int /*document_id*/, DocumentStatus status, int /*rating*/) {
+        return status == DocumentStatus::ACTUAL;
+    };
+    struct TermUse {
+        // номер запроса в группе
+        size_t query;
+        double inverse_document_freq;
+        // предел вклада слова на текущем отрезке; 0 -- на отрезке слова нет
+        double bound;
+        // слово порождает кандидатов запроса на текущем отрезке
+        bool is_essential;
+    };
+    struct TermGroup {
+        const PostingList* postings;
+        // документы списка на текущем отрезке: [position, chunk_end_position)
+        size_t position;
+        size_t chunk_end_position;
+        std::vector<TermUse> uses;
+    };
+    std::vector<TermGroup> groups;
+    std::unordered_map<const PostingList*, size_t> group_indexes;
+    // слова каждого запроса: номер группы и номер использования в ней
+    std::vector<std::vector<std::pair<size_t, size_t>>> query_terms(end - begin);
+    std::vector<ExclusionFilter<Ordinals>> minus_filters;
+    minus_filters.reserve(end - begin);
+    std::vector<size_t> filter_indexes(end - begin, 0);
+    for (size_t query_index = begin; query_index < end; ++query_index) {
+        const Query& query = queries[query_index];
+        std::vector<Document>& documents = results[query_index];
+        // пересечение списков обязательных слов не делится между запросами
+        if (!query.required_words.empty()) {
+            ForEachFoundDocumentConjunctive(query, scorer, is_actual, [&documents](const Document& document) {
+                documents.push_back(document);
+            });
+            SelectTopRanked(documents, MAX_RESULT_DOCUMENT_COUNT);
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        const auto plus_postings = FindPlusWordPostings(query);
+        size_t posting_count = 0;
+        for (size_t i = 0; i < plus_postings.size(); ++i) {
+            if (!plus_postings[i]) {
+                continue;
+            }
+            posting_count += plus_postings[i]->ordinals.size();
+            const auto [index_it, is_new] = group_indexes.emplace(plus_postings[i], groups.size());
+            if (is_new) {
+                groups.push_back({plus_postings[i], 0, 0, {}});
+            }
+            TermGroup& group = groups[index_it->second];
+            const double inverse_document_freq = scorer.ComputeInverseDocumentFreq(plus_postings[i]->GetDocumentFreq()) * query.plus_word_weights[i];
+            query_terms[query_index - begin].emplace_back(index_it->second, group.uses.size());
+            group.uses.push_back({query_index - begin, inverse_document_freq, 0.0, false});
         }
+        filter_indexes[query_index - begin] = minus_filters.size();
+        minus_filters.push_back(BuildMinusWordsFilter(query, posting_count));
     }
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    std::vector<typename ExclusionFilter<Ordinals>::Scan> minus_scans;
+    minus_scans.reserve(minus_filters.size());
+    for (const auto& minus_filter : minus_filters) {
+        minus_scans.emplace_back(minus_filter);
+    }
+
+    // накопители отрезка: по CHUNK_SIZE на каждый запрос, получающий вклады на отрезке; обнуляются по мере чтения,
+    // поэтому массив не приходится очищать на каждом отрезке
+    constexpr int CHUNK_SIZE = QUERY_BATCH_CHUNK_SIZE;
+    std::vector<double> relevances;
+    std::vector<uint64_t> found_ordinals;
+    // место запроса в накопителях текущего отрезка, SIZE_MAX -- запрос на отрезке не участвует
+    std::vector<size_t> query_slots(end - begin, SIZE_MAX);
+    std::vector<size_t> active_queries;
+    // лучшие релевантности каждого запроса: документ ниже порога (как и при отсечении в MaxScore) в выдачу не войдет
+    std::vector<std::priority_queue<double, std::vector<double>, std::greater<double>>> top_relevances(end - begin);
+    std::vector<double> thresholds(end - begin, -std::numeric_limits<double>::infinity());
+    // место запроса в накопителях и IDF слова
+    std::vector<std::pair<size_t, double>> active_uses;
+    std::vector<TermUse*> uses_by_bound;
+    // число документов, найденных запросом на отрезке по основным словам
+    std::vector<size_t> found_counts;
+    const int ordinal_count = static_cast<int>(ordinal_to_document_id_.size());
+    for (int chunk_begin = 0; chunk_begin < ordinal_count; chunk_begin += CHUNK_SIZE) {
+        const int chunk_end = std::min(chunk_begin + CHUNK_SIZE, ordinal_count);
+        for (TermGroup& group : groups) {
+            const PostingList& postings = *group.postings;
+            group.chunk_end_position = AdvanceTo(postings.ordinals, group.position, chunk_end);
+            double max_term_freq = 0.0;
+            double min_inv_document_length = std::numeric_limits<double>::max();
+            if (group.chunk_end_position > group.position) {
+                for (size_t block = group.position / SCORE_BLOCK_SIZE; block <= (group.chunk_end_position - 1) / SCORE_BLOCK_SIZE; ++block) {
+                    max_term_freq = std::max(max_term_freq, postings.block_max_term_freqs[block]);
+                    min_inv_document_length = std::min(min_inv_document_length, postings.block_min_inv_document_lengths[block]);
+                }
+            }
+            for (TermUse& use : group.uses) {
+                use.bound = group.chunk_end_position > group.position
+                    ? scorer.ComputeTermScore(max_term_freq, min_inv_document_length, use.inverse_document_freq) : 0.0;
+                use.is_essential = false;
+            }
+        }
+        // запрос, документы которого на отрезке не проходят порог, пропускает отрезок; у остальных запросов
+        // слова с наименьшими пределами, пока их сумма ниже порога, остаются неосновными
+        active_queries.clear();
+        for (size_t query = 0; query < end - begin; ++query) {
+            uses_by_bound.clear();
+            double bound = 0.0;
+            for (const auto& [group_index, use_index] : query_terms[query]) {
+                TermUse& use = groups[group_index].uses[use_index];
+                if (groups[group_index].chunk_end_position > groups[group_index].position) {
+                    uses_by_bound.push_back(&use);
+                    bound += use.bound;
+                }
+            }
+            if (uses_by_bound.empty() || bound < thresholds[query]) {
+                continue;
+            }
+            std::sort(uses_by_bound.begin(), uses_by_bound.end(), [](const TermUse* lhs, const TermUse* rhs) {
+                return lhs->bound < rhs->bound;
+            });
+            double non_essential_bound = 0.0;
+            for (TermUse* use : uses_by_bound) {
+                non_essential_bound += use->bound;
+                use->is_essential = !(non_essential_bound < thresholds[query]);
+            }
+            query_slots[query] = active_queries.size();
+            active_queries.push_back(query);
+        }
+        if (relevances.size() < active_queries.size() * CHUNK_SIZE) {
+            relevances.resize(active_queries.size() * CHUNK_SIZE, 0.0);
+            found_ordinals.resize(active_queries.size() * CHUNK_SIZE / 64, 0);
+        }
+        for (TermGroup& group : groups) {
+            active_uses.clear();
+            for (const TermUse& use : group.uses) {
+                if (use.is_essential && query_slots[use.query] != SIZE_MAX) {
+                    active_uses.emplace_back(query_slots[use.query] * CHUNK_SIZE, use.inverse_document_freq);
+                }
+            }
+            if (active_uses.empty()) {
+                continue;
+            }
+            const Ordinals& ordinals = group.postings->ordinals;
+            const TermFreq* term_freqs = group.postings->term_freqs.template GetData<TermFreq>();
+            for (size_t position = group.position; position < group.chunk_end_position; ++position) {
+                const int ordinal = ordinals[position];
+                const double term_freq = DecodeTermFreq(term_freqs[position]);
+                const double inv_document_length = document_inv_word_counts_[ordinal];
+                const size_t offset = ordinal - chunk_begin;
+                for (const auto& [slot_begin, inverse_document_freq] : active_uses) {
+                    relevances[slot_begin + offset] += scorer.ComputeTermScore(term_freq, inv_document_length, inverse_document_freq);
+                    found_ordinals[(slot_begin + offset) >> 6] |= uint64_t{1} << (offset & 63);
+                }
+            }
+        }
+        // неосновные слова добавляют вклады только найденным документам; если документов списка на отрезке
+        // не больше, чем найденных документов запроса, список проходится (один раз для всех таких запросов),
+        // иначе найденные документы ищутся в списке
+        found_counts.assign(active_queries.size(), 0);
+        for (size_t slot = 0; slot < active_queries.size(); ++slot) {
+            for (size_t block = slot * CHUNK_SIZE / 64; block < (slot + 1) * CHUNK_SIZE / 64; ++block) {
+                found_counts[slot] += __builtin_popcountll(found_ordinals[block]);
+            }
+        }
+        for (TermGroup& group : groups) {
+            active_uses.clear();
+            for (const TermUse& use : group.uses) {
+                if (!use.is_essential && query_slots[use.query] != SIZE_MAX
+                    && group.chunk_end_position - group.position <= found_counts[query_slots[use.query]]) {
+                    active_uses.emplace_back(query_slots[use.query] * CHUNK_SIZE, use.inverse_document_freq);
+                }
+            }
+            if (active_uses.empty()) {
+                continue;
+            }
+            const Ordinals& ordinals = group.postings->ordinals;
+            const TermFreq* term_freqs = group.postings->term_freqs.template GetData<TermFreq>();
+            for (size_t position = group.position; position < group.chunk_end_position; ++position) {
+                const int ordinal = ordinals[position];
+                const size_t offset = ordinal - chunk_begin;
+                for (const auto& [slot_begin, inverse_document_freq] : active_uses) {
+                    if (found_ordinals[(slot_begin + offset) >> 6] & (uint64_t{1} << (offset & 63))) {
+                        relevances[slot_begin + offset] += scorer.ComputeTermScore(DecodeTermFreq(term_freqs[position]), document_inv_word_counts_[ordinal], inverse_document_freq);
+                    }
+                }
+            }
+        }
+        for (size_t slot = 0; slot < active_queries.size(); ++slot) {
+            const size_t query = active_queries[slot];
+            query_slots[query] = SIZE_MAX;
+            const size_t first_block = slot * CHUNK_SIZE / 64;
+            const size_t last_block = (slot + 1) * CHUNK_SIZE / 64;
+            // остальные неосновные слова ищутся в списках по найденным документам
+            for (const auto& [group_index, use_index] : query_terms[query]) {
+                const TermGroup& group = groups[group_index];
+                const TermUse& use = group.uses[use_index];
+                if (use.is_essential || group.chunk_end_position == group.position
+                    || group.chunk_end_position - group.position <= found_counts[slot]) {
+                    continue;
+                }
+                const Ordinals& ordinals = group.postings->ordinals;
+                const TermFreq* term_freqs = group.postings->term_freqs.template GetData<TermFreq>();
+                size_t position = group.position;
+                for (size_t block = first_block; block < last_block && position < group.chunk_end_position; ++block) {
+                    for (uint64_t bits = found_ordinals[block]; bits != 0 && position < group.chunk_end_position; bits &= bits - 1) {
+                        const size_t index = block * 64 + __builtin_ctzll(bits);
+                        const int ordinal = chunk_begin + static_cast<int>(index - slot * CHUNK_SIZE);
+                        position = AdvanceTo(ordinals, position, ordinal);
+                        if (position < group.chunk_end_position && ordinals[position] == ordinal) {
+                            relevances[index] += scorer.ComputeTermScore(DecodeTermFreq(term_freqs[position]), document_inv_word_counts_[ordinal], use.inverse_document_freq);
+                        }
+                    }
+                }
+            }
+            std::vector<Document>& documents = results[begin + query];
+            auto& minus_scan = minus_scans[filter_indexes[query]];
+            for (size_t block = first_block; block < last_block; ++block) {
+                for (uint64_t bits = found_ordinals[block]; bits != 0; bits &= bits - 1) {
+                    const size_t index = block * 64 + __builtin_ctzll(bits);
+                    const int ordinal = chunk_begin + static_cast<int>(index - slot * CHUNK_SIZE);
+                    const double relevance = relevances[index];
+                    relevances[index] = 0.0;
+                    if (relevance < thresholds[query] || removed_ordinals_[ordinal] || minus_scan.IsExcluded(ordinal)
+                        || !is_actual(ordinal_to_document_id_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal])) {
+                        continue;
+                    }
+                    documents.emplace_back(ordinal_to_document_id_[ordinal], relevance, document_ratings_[ordinal]);
+                    top_relevances[query].push(relevance);
+                    if (top_relevances[query].size() > MAX_RESULT_DOCUMENT_COUNT) {
+                        top_relevances[query].pop();
+                    }
+                    if (top_relevances[query].size() == MAX_RESULT_DOCUMENT_COUNT) {
+                        thresholds[query] = top_relevances[query].top() - EPSILON;
+                    }
+                }
+                found_ordinals[block] = 0;
+            }
+            // документы, опустившиеся ниже порога, время от времени отбрасываются
+            if (documents.size() >= static_cast<size_t>(CHUNK_SIZE)) {
+                SelectTopRanked(documents, MAX_RESULT_DOCUMENT_COUNT);
+            }
+        }
+        for (TermGroup& group : groups) {
+            group.position = group.chunk_end_position;
+        }
+    }
+    for (size_t query_index = begin; query_index < end; ++query_index) {
+        if (queries[query_index].required_words.empty()) {
+            SelectTopRanked(results[query_index], MAX_RESULT_DOCUMENT_COUNT);
+        }
+    }
+}
+
+// постраничный поиск с фильтрацией посредством функции-предиката
+// версия без ExecutionPolicy просто вызывает последовательную
+template <typename Scorer, typename DocumentPredicate>
+DocumentPage SearchServer::FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentPredicate document_predicate) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, cursor, page_size, document_predicate);
+}
+
+// постраничный поиск с фильтрацией по статусу
+// версия без ExecutionPolicy просто вызывает последовательную
+template <typename Scorer>
+DocumentPage SearchServer::FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentStatus status) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, cursor, page_size, status);
+}
+
+// постраничный поиск
+// версия без ExecutionPolicy просто вызывает последовательную
+template <typename Scorer>
+DocumentPage SearchServer::FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const {
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, cursor, page_size, DocumentStatus::ACTUAL);
+}
+
+// постраничный поиск с фильтрацией посредством функции-предиката
+// лучшие page_size документов после курсора отбираются кучей, на вершине которой худший из отобранных
+template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
+DocumentPage SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentPredicate document_predicate) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    TRACE_SPAN(QUERY);
+    const auto query = ParseSearchQuery(raw_query);
+    const Scorer scorer(GetCollectionStatistics());
+    std::priority_queue<Document, std::vector<Document>, decltype(&IsRankedBefore)> page_heap(&IsRankedBefore);
+    ForEachFoundDocument(policy, query, scorer, document_predicate, [&cursor, page_size, &page_heap](const Document& document) {
+        if (!cursor.IsBefore(document)) {
+            return;
+        }
+        if (page_heap.size() < page_size) {
+            page_heap.push(document);
+        } else if (IsRankedBefore(document, page_heap.top())) {
+            page_heap.pop();
+            page_heap.push(document);
+        }
+    });
+    TRACE_SPAN(TOP_K);
+    DocumentPage page;
+    page.documents.resize(page_heap.size());
+    for (auto it = page.documents.rbegin(); it != page.documents.rend(); ++it) {
+        *it = page_heap.top();
+        page_heap.pop();
     }
+    page.next_cursor = page.documents.empty() ? cursor : SearchCursor(page.documents.back());
+    return page;
+}
+
+// постраничный поиск с фильтрацией по статусу
+template <typename Scorer, typename ExecutionPolicy>
+DocumentPage SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size, DocumentStatus status) const {
+    return FindTopDocuments<Scorer>(policy, raw_query, cursor, page_size, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+    });
+}
+
+// постраничный поиск
+template <typename Scorer, typename ExecutionPolicy>
+DocumentPage SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const {
+    return FindTopDocuments<Scorer>(policy, raw_query, cursor, page_size, DocumentStatus::ACTUAL);
+}
+
+// возвращает результаты поиска с фильтрацией посредством функции-предиката
+// если top_count > 0, могут быть пропущены документы, которые заведомо не войдут в top_count лучших
+template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, size_t top_count) const {
+    std::vector<Document> matched_documents;
+    ForEachFoundDocument(policy, query, scorer, document_predicate, [&matched_documents](const Document& document) {
+        matched_documents.push_back(document);
+    }, top_count);
     return matched_documents;
 }
 
-// возвращает все результаты поиска с фильтрацией посредством функции-предиката
-// параллельная версия
+// строит план запроса: оценивает вклад найденных слов и стоимость стратегий обхода их списков
+template <typename Scorer>
+QueryPlan SearchServer::BuildQueryPlan(const Query& query, const Scorer& scorer, const std::vector<const PostingList*>& plus_postings, size_t top_count) const {
+    QueryPlan plan;
+    plan.top_count = top_count;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (!plus_postings[i]) {
+            continue;
+        }
+        const PostingList& postings = *plus_postings[i];
+        PlannedTerm term;
+        term.word = query.plus_words[i];
+        term.word_index = i;
+        term.posting_count = postings.ordinals.size();
+        term.inverse_document_freq = scorer.ComputeInverseDocumentFreq(postings.GetDocumentFreq()) * query.plus_word_weights[i];
+        term.max_score = scorer.ComputeTermScore(postings.max_term_freq, postings.min_inv_document_length, term.inverse_document_freq);
+        plan.posting_count += term.posting_count;
+        plan.terms.push_back(term);
+    }
+    std::stable_sort(plan.terms.begin(), plan.terms.end(), [](const PlannedTerm& lhs, const PlannedTerm& rhs) {
+        return lhs.max_score < rhs.max_score;
+    });
+
+    // при отсечении кандидатов порождают только неотложенные слова; порог отсечения заранее неизвестен,
+    // поэтому считается, что будут отложены слова, которые все вместе весят меньше самого весомого слова
+    size_t active_posting_count = plan.posting_count;
+    if (top_count > 0 && plan.terms.size() > 1) {
+        double deferred_score = 0.0;
+        while (plan.expected_deferred_count + 1 < plan.terms.size()
+               && deferred_score + plan.terms[plan.expected_deferred_count].max_score < plan.terms.back().max_score) {
+            deferred_score += plan.terms[plan.expected_deferred_count].max_score;
+            active_posting_count -= plan.terms[plan.expected_deferred_count].posting_count;
+            ++plan.expected_deferred_count;
+        }
+    }
+    plan.term_at_a_time_cost = plan.posting_count * TERM_AT_A_TIME_POSTING_COST + ordinal_to_document_id_.size() * TERM_AT_A_TIME_ORDINAL_COST;
+    plan.document_at_a_time_cost = static_cast<double>(active_posting_count) * plan.terms.size() * DOCUMENT_AT_A_TIME_POSTING_COST;
+
+    const bool use_max_score = top_count > 0 && plan.terms.size() > 1;
+    const bool use_impacts = top_count > 0 && plan.terms.size() == 1 && !plus_postings[plan.terms.front().word_index]->impacts.empty();
+    if (forced_query_strategy_) {
+        plan.strategy = *forced_query_strategy_;
+        if (plan.strategy == QueryStrategy::IMPACT_ORDERED && !use_impacts) {
+            plan.strategy = QueryStrategy::BLOCK_MAX_WAND;
+        }
+        if ((plan.strategy == QueryStrategy::MAX_SCORE && !use_max_score)
+            || (plan.strategy == QueryStrategy::BLOCK_MAX_WAND && top_count == 0)) {
+            plan.strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+        }
+    } else if (use_impacts) {
+        plan.strategy = QueryStrategy::IMPACT_ORDERED;
+    } else if (top_count > 0 && !plan.terms.empty()) {
+        // когда нужны только лучшие документы, отсечение выгоднее полного обхода при любой стоимости:
+        // MaxScore отсекает по частичным суммам и на нескольких словах быстрее, а для одного слова
+        // отложить нечего, и документы отсекаются только по пределам блоков
+        plan.strategy = use_max_score ? QueryStrategy::MAX_SCORE : QueryStrategy::BLOCK_MAX_WAND;
+    } else if (plan.term_at_a_time_cost < plan.document_at_a_time_cost) {
+        plan.strategy = QueryStrategy::TERM_AT_A_TIME;
+    } else {
+        plan.strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+    }
+    return plan;
+}
+
+// план запроса без его выполнения
+template <typename Scorer>
+QueryPlan SearchServer::PlanQuery(const std::string_view raw_query, size_t top_count) const {
+    const auto query = ParseSearchQuery(raw_query);
+    const Scorer scorer(GetCollectionStatistics());
+    QueryPlan plan = BuildQueryPlan(query, scorer, FindPlusWordPostings(query), top_count);
+    // слова запроса ссылаются на raw_query, а план возвращается наружу
+    for (PlannedTerm& term : plan.terms) {
+        term.word = word_to_document_freqs_.find(term.word)->first;
+    }
+    if (!query.required_words.empty()) {
+        plan.strategy = QueryStrategy::CONJUNCTIVE;
+    }
+    return plan;
+}
+
+// передает каждый найденный документ в visit_document
+// последовательная версия: списки документов обходятся стратегией, выбранной планировщиком;
+// если top_count > 0, документы, которые заведомо не войдут в top_count лучших, могут быть пропущены
+template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocument(const std::execution::sequenced_policy&, const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, size_t top_count) const {
+    QueryPlannerMetrics metrics;
+    if (!query.required_words.empty()) {
+        ++metrics.conjunctive_queries;
+        query_planner_counters_.Add(metrics);
+        if constexpr (IsProfiledPredicate<DocumentPredicate>::value) {
+            document_predicate.RecordExecution(QueryStrategy::CONJUNCTIVE, metrics);
+        }
+        ForEachFoundDocumentConjunctive(query, scorer, document_predicate, visit_document);
+        return;
+    }
+    const auto plus_postings = FindPlusWordPostings(query);
+    const QueryPlan plan = BuildQueryPlan(query, scorer, plus_postings, top_count);
+    // документы с минус-словами отбрасываются до вызова предиката и оценки
+    const auto minus_filter = BuildMinusWordsFilter(query, plan.posting_count);
+    TRACE_SPAN(SCORING);
+    // представление частот выбирается один раз на запрос, а не на каждый элемент списка
+    switch (term_freq_precision_) {
+    case TermFreqPrecision::FLOAT:
+        ExecuteQueryPlan<float>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    case TermFreqPrecision::QUANTIZED_8:
+        ExecuteQueryPlan<uint8_t>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    default:
+        ExecuteQueryPlan<double>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    }
+    query_planner_counters_.Add(metrics);
+    if constexpr (IsProfiledPredicate<DocumentPredicate>::value) {
+        // таблица частого слова могла не доказать полноту, и тогда запрос выполнен BLOCK_MAX_WAND
+        const bool is_impact_fallback = plan.strategy == QueryStrategy::IMPACT_ORDERED && metrics.impact_ordered_queries == 0;
+        document_predicate.RecordExecution(is_impact_fallback ? QueryStrategy::BLOCK_MAX_WAND : plan.strategy, metrics);
+    }
+}
+
+// проверка найденного документа; в поиске с профилем заодно считаются исключенные документы
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    constexpr size_t THREAD_COUNT = 101;
-    ConcurrentMap<int, double> mt_document_to_relevance(THREAD_COUNT);
+bool SearchServer::IsDocumentAccepted(int ordinal, bool is_excluded, DocumentPredicate& document_predicate) const {
+    if (is_excluded) {
+        if constexpr (IsProfiledPredicate<DocumentPredicate>::value) {
+            document_predicate.CountExcludedDocument();
+        }
+        return false;
+    }
+    return document_predicate(ordinal_to_document_id_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal]);
+}
+
+template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ExecuteQueryPlan(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const {
+    switch (plan.strategy) {
+    case QueryStrategy::TERM_AT_A_TIME:
+        ++metrics.term_at_a_time_queries;
+        ForEachFoundDocumentByTerms<TermFreq>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    case QueryStrategy::MAX_SCORE:
+        ++metrics.max_score_queries;
+        ForEachFoundDocumentMaxScore<TermFreq>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    case QueryStrategy::IMPACT_ORDERED:
+        if (ForEachFoundDocumentByImpact(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics)) {
+            ++metrics.impact_ordered_queries;
+            break;
+        }
+        [[fallthrough]];
+    case QueryStrategy::BLOCK_MAX_WAND:
+        ++metrics.block_max_wand_queries;
+        ForEachFoundDocumentBlockMaxWand<TermFreq>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    default:
+        ++metrics.document_at_a_time_queries;
+        ForEachFoundDocumentByDocuments<TermFreq>(plan, plus_postings, minus_filter, scorer, document_predicate, visit_document, metrics);
+        break;
+    }
+}
+
+// обход слово за словом: вклады слов в порядке запроса накапливаются в массиве по порядковым номерам,
+// затем найденные документы проверяются и передаются в visit_document по возрастанию номеров
+template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocumentByTerms(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const {
+    std::vector<const PlannedTerm*> terms;
+    for (const PlannedTerm& term : plan.terms) {
+        terms.push_back(&term);
+    }
+    std::sort(terms.begin(), terms.end(), [](const PlannedTerm* lhs, const PlannedTerm* rhs) {
+        return lhs->word_index < rhs->word_index;
+    });
+    std::vector<double> relevances(ordinal_to_document_id_.size(), 0.0);
+    std::vector<uint64_t> found_ordinals((relevances.size() + 63) / 64, 0);
+    for (const PlannedTerm* term : terms) {
+        const PostingList& postings = *plus_postings[term->word_index];
+        const TermFreq* term_freqs = postings.term_freqs.template GetData<TermFreq>();
+        for (size_t j = 0; j < postings.ordinals.size(); ++j) {
+            const int ordinal = postings.ordinals[j];
+            relevances[ordinal] += scorer.ComputeTermScore(DecodeTermFreq(term_freqs[j]), document_inv_word_counts_[ordinal], term->inverse_document_freq);
+            found_ordinals[ordinal >> 6] |= uint64_t{1} << (ordinal & 63);
+        }
+        metrics.scanned_postings += postings.ordinals.size();
+    }
+    // удаленные документы и документы с минус-словами отбрасываются за один проход по найденным
+    TRACE_SPAN(FILTERING);
+    typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+    for (size_t block = 0; block < found_ordinals.size(); ++block) {
+        for (uint64_t bits = found_ordinals[block]; bits != 0; bits &= bits - 1) {
+            const int ordinal = static_cast<int>(block * 64 + __builtin_ctzll(bits));
+            if (IsDocumentAccepted(ordinal, removed_ordinals_[ordinal] || minus_scan.IsExcluded(ordinal), document_predicate)) {
+                ++metrics.scored_documents;
+                visit_document(Document(ordinal_to_document_id_[ordinal], relevances[ordinal], document_ratings_[ordinal]));
+            }
+        }
+    }
+}
+
+// обход документ за документом: курсоры по спискам всех слов сливаются по возрастанию номеров
+template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocumentByDocuments(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const {
+    struct Cursor {
+        const PostingList* postings;
+        const TermFreq* term_freqs;
+        double inverse_document_freq;
+        size_t position;
+    };
+    std::vector<Cursor> cursors;
+    for (const PlannedTerm& term : plan.terms) {
+        const PostingList* postings = plus_postings[term.word_index];
+        cursors.push_back({postings, postings->term_freqs.template GetData<TermFreq>(), term.inverse_document_freq, 0});
+    }
+    // вклады суммируются в порядке слов запроса
+    std::vector<size_t> word_indexes(plan.terms.size());
+    std::iota(word_indexes.begin(), word_indexes.end(), 0);
+    std::sort(word_indexes.begin(), word_indexes.end(), [&plan](size_t lhs, size_t rhs) {
+        return plan.terms[lhs].word_index < plan.terms[rhs].word_index;
+    });
+    std::vector<Cursor> ordered_cursors;
+    for (const size_t i : word_indexes) {
+        ordered_cursors.push_back(cursors[i]);
+    }
+
+    typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+    while (true) {
+        int ordinal = std::numeric_limits<int>::max();
+        for (const Cursor& cursor : ordered_cursors) {
+            if (cursor.position < cursor.postings->ordinals.size()) {
+                ordinal = std::min(ordinal, cursor.postings->ordinals[cursor.position]);
+            }
+        }
+        if (ordinal == std::numeric_limits<int>::max()) {
+            break;
+        }
+        const bool is_found = IsDocumentAccepted(ordinal, removed_ordinals_[ordinal] || minus_scan.IsExcluded(ordinal), document_predicate);
+        double relevance = 0.0;
+        for (Cursor& cursor : ordered_cursors) {
+            if (cursor.position < cursor.postings->ordinals.size() && cursor.postings->ordinals[cursor.position] == ordinal) {
+                if (is_found) {
+                    relevance += scorer.ComputeTermScore(DecodeTermFreq(cursor.term_freqs[cursor.position]), document_inv_word_counts_[ordinal], cursor.inverse_document_freq);
+                }
+                ++cursor.position;
+                ++metrics.scanned_postings;
+            }
+        }
+        if (is_found) {
+            ++metrics.scored_documents;
+            visit_document(Document(ordinal_to_document_id_[ordinal], relevance, document_ratings_[ordinal]));
+        }
+    }
+}
+
+// обход документ за документом с отсечением (MaxScore)
+// слова упорядочены по возрастанию верхнего предела вклада; первые deferred_count слов отложены: документ,
+// в котором есть только они, набирает не больше deferred_bounds[deferred_count] и не войдет в выдачу
+// документ отбрасывается и тогда, когда его уже известные вклады вместе с пределами еще не проверенных
+// слов меньше порога -- релевантности худшего из top_count лучших найденных документов
+// порог уменьшен на EPSILON: документы, отличающиеся от худшего меньше чем на EPSILON, упорядочиваются
+// по рейтингу и не могут быть отброшены
+template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocumentMaxScore(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const {
+    typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+    const size_t term_count = plan.terms.size();
+    std::vector<size_t> positions(term_count, 0);
+    std::vector<double> deferred_bounds(term_count + 1, 0.0);
+    for (size_t i = 0; i < term_count; ++i) {
+        deferred_bounds[i + 1] = deferred_bounds[i] + plan.terms[i].max_score;
+    }
+    std::vector<size_t> word_indexes(term_count);
+    std::iota(word_indexes.begin(), word_indexes.end(), 0);
+    std::sort(word_indexes.begin(), word_indexes.end(), [&plan](size_t lhs, size_t rhs) {
+        return plan.terms[lhs].word_index < plan.terms[rhs].word_index;
+    });
+    const auto get_postings = [&](size_t i) -> const PostingList& {
+        return *plus_postings[plan.terms[i].word_index];
+    };
+    std::vector<const TermFreq*> term_freqs(term_count);
+    for (size_t i = 0; i < term_count; ++i) {
+        term_freqs[i] = get_postings(i).term_freqs.template GetData<TermFreq>();
+    }
+    const auto get_score = [&](size_t i, size_t position, int ordinal) {
+        return scorer.ComputeTermScore(DecodeTermFreq(term_freqs[i][position]), document_inv_word_counts_[ordinal], plan.terms[i].inverse_document_freq);
+    };
+
+    // вклады слов в текущий документ; NaN -- слова в документе нет или оно еще не проверено
+    std::vector<double> scores(term_count);
+    std::priority_queue<double, std::vector<double>, std::greater<double>> top_relevances;
+    double threshold = -std::numeric_limits<double>::infinity();
+    size_t deferred_count = 0;
+    while (deferred_count < term_count) {
+        int ordinal = std::numeric_limits<int>::max();
+        for (size_t i = deferred_count; i < term_count; ++i) {
+            if (positions[i] < get_postings(i).ordinals.size()) {
+                ordinal = std::min(ordinal, get_postings(i).ordinals[positions[i]]);
+            }
+        }
+        if (ordinal == std::numeric_limits<int>::max()) {
+            break;
+        }
+        const bool is_found = IsDocumentAccepted(ordinal, removed_ordinals_[ordinal] || minus_scan.IsExcluded(ordinal), document_predicate);
+        double bound = deferred_bounds[deferred_count];
+        for (size_t i = deferred_count; i < term_count; ++i) {
+            scores[i] = std::numeric_limits<double>::quiet_NaN();
+            const PostingList& postings = get_postings(i);
+            if (positions[i] < postings.ordinals.size() && postings.ordinals[positions[i]] == ordinal) {
+                if (is_found) {
+                    scores[i] = get_score(i, positions[i], ordinal);
+                    bound += scores[i];
+                }
+                ++positions[i];
+                ++metrics.scanned_postings;
+            }
+        }
+        if (!is_found) {
+            continue;
+        }
+        // отложенные слова проверяются от самого весомого, пока документ еще может войти в выдачу
+        bool is_pruned = false;
+        for (size_t i = deferred_count; i-- > 0;) {
+            scores[i] = std::numeric_limits<double>::quiet_NaN();
+            if (bound < threshold) {
+                is_pruned = true;
+                break;
+            }
+            const PostingList& postings = get_postings(i);
+            positions[i] = AdvanceTo(postings.ordinals, positions[i], ordinal);
+            ++metrics.probed_postings;
+            bound -= plan.terms[i].max_score;
+            if (positions[i] < postings.ordinals.size() && postings.ordinals[positions[i]] == ordinal) {
+                scores[i] = get_score(i, positions[i], ordinal);
+                bound += scores[i];
+            }
+        }
+        if (is_pruned || bound < threshold) {
+            ++metrics.pruned_documents;
+            continue;
+        }
+
+        double relevance = 0.0;
+        for (const size_t i : word_indexes) {
+            if (!std::isnan(scores[i])) {
+                relevance += scores[i];
+            }
+        }
+        ++metrics.scored_documents;
+        visit_document(Document(ordinal_to_document_id_[ordinal], relevance, document_ratings_[ordinal]));
+
+        top_relevances.push(relevance);
+        if (top_relevances.size() > plan.top_count) {
+            top_relevances.pop();
+        }
+        if (top_relevances.size() == plan.top_count) {
+            threshold = top_relevances.top() - EPSILON;
+            while (deferred_count < term_count && deferred_bounds[deferred_count + 1] < threshold) {
+                ++deferred_count;
+            }
+        }
+    }
+    metrics.deferred_terms += deferred_count;
+}
+
+// обход документ за документом с отсечением Block-Max WAND
+// курсоры упорядочены по текущему номеру; документ, предшествующий номеру опорного курсора, есть только
+// в списках курсоров перед опорным, и их пределы в сумме меньше порога, поэтому такие документы пропускаются
+// пределы блоков уточняют оценку: если и по ним опорный документ не проходит порог, не пройдет его
+// и ни один документ до ближайшей границы блока (или до номера следующего курсора)
+// порог, как и в MaxScore, уменьшен на EPSILON, поэтому выдача совпадает с полным перебором
+template <typename TermFreq, typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocumentBlockMaxWand(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const {
+    typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+    constexpr int END_ORDINAL = std::numeric_limits<int>::max();
+    struct Cursor {
+        const PostingList* postings;
+        const TermFreq* term_freqs;
+        const PlannedTerm* term;
+        size_t position;
+        size_t block;
+        // предел вклада в текущем блоке
+        double block_score;
+
+        int GetOrdinal() const {
+            return position < postings->ordinals.size() ? postings->ordinals[position] : END_ORDINAL;
+        }
+    };
+    std::vector<Cursor> cursors;
+    for (const PlannedTerm& term : plan.terms) {
+        const PostingList* postings = plus_postings[term.word_index];
+        cursors.push_back({postings, postings->term_freqs.template GetData<TermFreq>(), &term, 0, 0, 0.0});
+    }
+    const auto by_ordinal = [](const Cursor& lhs, const Cursor& rhs) {
+        return lhs.GetOrdinal() < rhs.GetOrdinal();
+    };
+    const auto advance_to = [&metrics](Cursor& cursor, int ordinal) {
+        cursor.position = AdvanceTo(cursor.postings->ordinals, cursor.position, ordinal);
+        ++metrics.probed_postings;
+    };
+
+    // вклады слов в текущий документ: номер слова в запросе и вклад
+    std::vector<std::pair<size_t, double>> scores;
+    std::priority_queue<double, std::vector<double>, std::greater<double>> top_relevances;
+    double threshold = -std::numeric_limits<double>::infinity();
+    while (true) {
+        // курсоры почти упорядочены, и их немного: сортировка вставками здесь быстрее std::sort
+        for (size_t i = 1; i < cursors.size(); ++i) {
+            for (size_t k = i; k > 0 && by_ordinal(cursors[k], cursors[k - 1]); --k) {
+                std::swap(cursors[k], cursors[k - 1]);
+            }
+        }
+        double bound = 0.0;
+        size_t pivot = 0;
+        while (pivot < cursors.size() && cursors[pivot].GetOrdinal() != END_ORDINAL) {
+            bound += cursors[pivot].term->max_score;
+            if (bound >= threshold) {
+                break;
+            }
+            ++pivot;
+        }
+        if (pivot == cursors.size() || cursors[pivot].GetOrdinal() == END_ORDINAL) {
+            break;
+        }
+        const int pivot_ordinal = cursors[pivot].GetOrdinal();
+        while (pivot + 1 < cursors.size() && cursors[pivot + 1].GetOrdinal() == pivot_ordinal) {
+            ++pivot;
+        }
+
+        // пределы блоков, в которые попадает опорный документ, и ближайшая из их границ
+        double block_bound = 0.0;
+        int next_ordinal = pivot + 1 < cursors.size() ? cursors[pivot + 1].GetOrdinal() : END_ORDINAL;
+        for (size_t i = 0; i <= pivot; ++i) {
+            Cursor& cursor = cursors[i];
+            const PostingList& postings = *cursor.postings;
+            cursor.block = std::max(cursor.block, cursor.position / SCORE_BLOCK_SIZE);
+            while (cursor.block < postings.GetBlockCount() && postings.GetBlockLastOrdinal(cursor.block) < pivot_ordinal) {
+                ++cursor.block;
+            }
+            cursor.block_score = 0.0;
+            if (cursor.block == postings.GetBlockCount()) {
+                continue;
+            }
+            cursor.block_score = scorer.ComputeTermScore(postings.block_max_term_freqs[cursor.block], postings.block_min_inv_document_lengths[cursor.block], cursor.term->inverse_document_freq);
+            block_bound += cursor.block_score;
+            next_ordinal = std::min(next_ordinal, postings.GetBlockLastOrdinal(cursor.block) + 1);
+        }
+        if (block_bound < threshold) {
+            ++metrics.skipped_blocks;
+            for (size_t i = 0; i <= pivot; ++i) {
+                advance_to(cursors[i], next_ordinal);
+            }
+            continue;
+        }
+        if (cursors[0].GetOrdinal() != pivot_ordinal) {
+            // документы до опорного порог не проходят
+            for (size_t i = 0; i < pivot && cursors[i].GetOrdinal() < pivot_ordinal; ++i) {
+                advance_to(cursors[i], pivot_ordinal);
+            }
+            continue;
+        }
+
+        const bool is_found = IsDocumentAccepted(pivot_ordinal, removed_ordinals_[pivot_ordinal] || minus_scan.IsExcluded(pivot_ordinal), document_predicate);
+        // пределы блоков по мере оценки заменяются настоящими вкладами; как только сумма опускается ниже
+        // порога, документ отбрасывается
+        scores.clear();
+        bool is_pruned = false;
+        for (size_t i = 0; i <= pivot; ++i) {
+            Cursor& cursor = cursors[i];
+            if (is_found && !is_pruned) {
+                const double score = scorer.ComputeTermScore(DecodeTermFreq(cursor.term_freqs[cursor.position]), document_inv_word_counts_[pivot_ordinal], cursor.term->inverse_document_freq);
+                scores.emplace_back(cursor.term->word_index, score);
+                block_bound += score - cursor.block_score;
+                is_pruned = block_bound < threshold;
+            }
+            ++cursor.position;
+            ++metrics.scanned_postings;
+        }
+        if (!is_found) {
+            continue;
+        }
+        if (is_pruned) {
+            ++metrics.pruned_documents;
+            continue;
+        }
+        // вклады суммируются в порядке слов запроса
+        std::sort(scores.begin(), scores.end());
+        double relevance = 0.0;
+        for (const auto& [word_index, score] : scores) {
+            relevance += score;
+        }
+        ++metrics.scored_documents;
+        visit_document(Document(ordinal_to_document_id_[pivot_ordinal], relevance, document_ratings_[pivot_ordinal]));
+
+        top_relevances.push(relevance);
+        if (top_relevances.size() > plan.top_count) {
+            top_relevances.pop();
+        }
+        if (top_relevances.size() == plan.top_count) {
+            threshold = top_relevances.top() - EPSILON;
+        }
+    }
+}
+
+// обход таблицы частого слова (запрос из одного слова): документы перебираются по убыванию частоты,
+// пока предел вклада следующего документа -- с его частотой и наименьшей длиной документа в списке --
+// не окажется ниже порога; документы за таблицей ограничены последней частотой таблицы
+// возвращает false, если по таблице не удалось найти лучшие документы; тогда в visit_document ничего не передается
+template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+bool SearchServer::ForEachFoundDocumentByImpact(const QueryPlan& plan, const std::vector<const PostingList*>& plus_postings, const ExclusionFilter<Ordinals>& minus_filter, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, QueryPlannerMetrics& metrics) const {
+    const PlannedTerm& term = plan.terms.front();
+    const PostingList& postings = *plus_postings[term.word_index];
+    const auto get_bound = [&](double term_freq) {
+        return scorer.ComputeTermScore(term_freq, postings.min_inv_document_length, term.inverse_document_freq);
+    };
+    std::vector<Document> found_documents;
+    std::priority_queue<double, std::vector<double>, std::greater<double>> top_relevances;
+    double threshold = -std::numeric_limits<double>::infinity();
+    bool is_complete = postings.impacts.size() == postings.ordinals.size();
+    size_t checked_count = 0;
+    for (const auto& [term_freq, ordinal] : postings.impacts) {
+        if (get_bound(term_freq) < threshold) {
+            is_complete = true;
+            break;
+        }
+        ++checked_count;
+        if (!IsDocumentAccepted(ordinal, removed_ordinals_[ordinal] || minus_filter.Contains(ordinal), document_predicate)) {
+            continue;
+        }
+        const double relevance = scorer.ComputeTermScore(term_freq, document_inv_word_counts_[ordinal], term.inverse_document_freq);
+        found_documents.emplace_back(ordinal_to_document_id_[ordinal], relevance, document_ratings_[ordinal]);
+        top_relevances.push(relevance);
+        if (top_relevances.size() > plan.top_count) {
+            top_relevances.pop();
+        }
+        if (top_relevances.size() == plan.top_count) {
+            threshold = top_relevances.top() - EPSILON;
+        }
+    }
+    metrics.scanned_postings += checked_count;
+    if (!is_complete && !(get_bound(postings.impacts.back().term_freq) < threshold)) {
+        return false;
+    }
+    metrics.pruned_documents += postings.ordinals.size() - checked_count;
+    metrics.scored_documents += found_documents.size();
+    for (const Document& document : found_documents) {
+        visit_document(document);
+    }
+    return true;
+}
+
+// передает каждый найденный документ в visit_document по возрастанию порядковых номеров
+// параллельная версия: порядковые номера делятся на отрезки, и в каждом отрезке списки всех слов обходятся
+// слово за словом в порядке запроса, как в последовательной версии, -- релевантность совпадает с ней до бита,
+// и выдача от политики не зависит; visit_document вызывается последовательно
+// показатели обхода каждый отрезок считает в своем элементе, и они складываются после обхода
+template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocument(const std::execution::parallel_policy&, const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document, size_t /*top_count*/) const {
+    QueryPlannerMetrics metrics;
+    // после пересечения списков документов остается слишком мало, чтобы распараллеливать их оценку
+    if (!query.required_words.empty()) {
+        ++metrics.conjunctive_queries;
+        query_planner_counters_.Add(metrics);
+        if constexpr (IsProfiledPredicate<DocumentPredicate>::value) {
+            document_predicate.RecordExecution(QueryStrategy::CONJUNCTIVE, metrics);
+        }
+        ForEachFoundDocumentConjunctive(query, scorer, document_predicate, visit_document);
+        return;
+    }
+    const auto plus_postings = FindPlusWordPostings(query);
+    size_t plus_postings_count = 0;
+    std::vector<double> inverse_document_freqs(query.plus_words.size(), 0.0);
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (plus_postings[i]) {
+            plus_postings_count += plus_postings[i]->ordinals.size();
+            inverse_document_freqs[i] = scorer.ComputeInverseDocumentFreq(plus_postings[i]->GetDocumentFreq()) * query.plus_word_weights[i];
+        }
+    }
+    const auto minus_filter = BuildMinusWordsFilter(query, plus_postings_count);
+
+    TRACE_SPAN(SCORING);
+    // отрезков в несколько раз больше, чем потоков, чтобы потоки догружались при неравномерных списках
+    constexpr int MIN_CHUNK_SIZE = 1024;
+    const int ordinal_count = static_cast<int>(ordinal_to_document_id_.size());
+    const int chunk_count = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) * 4;
+    const int chunk_size = std::max(MIN_CHUNK_SIZE, (ordinal_count + chunk_count - 1) / chunk_count);
+    std::vector<int> chunk_begins;
+    for (int begin = 0; begin < ordinal_count; begin += chunk_size) {
+        chunk_begins.push_back(begin);
+    }
+    std::vector<std::vector<Document>> chunk_documents(chunk_begins.size());
+    std::vector<uint64_t> chunk_scanned_postings(chunk_begins.size(), 0);
+    std::vector<size_t> chunk_indexes(chunk_begins.size());
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
     std::for_each(
         std::execution::par,
-        query.plus_words.begin(),
-        query.plus_words.end(),
-        [this, &document_predicate, &mt_document_to_relevance](std::string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                return;
+        chunk_indexes.begin(),
+        chunk_indexes.end(),
+        [&](size_t chunk) {
+            const int begin = chunk_begins[chunk];
+            const int end = std::min(begin + chunk_size, ordinal_count);
+            std::vector<double> relevances(end - begin, 0.0);
+            std::vector<bool> is_found(end - begin, false);
+            for (size_t i = 0; i < query.plus_words.size(); ++i) {
+                if (!plus_postings[i]) {
+                    continue;
+                }
+                const PostingList& postings = *plus_postings[i];
+                const auto add_relevances = [&](const auto* term_freqs) {
+                    const size_t first = AdvanceTo(postings.ordinals, 0, begin);
+                    size_t j = first;
+                    for (; j < postings.ordinals.size() && postings.ordinals[j] < end; ++j) {
+                        const int ordinal = postings.ordinals[j];
+                        relevances[ordinal - begin] += scorer.ComputeTermScore(DecodeTermFreq(term_freqs[j]), document_inv_word_counts_[ordinal], inverse_document_freqs[i]);
+                        is_found[ordinal - begin] = true;
+                    }
+                    chunk_scanned_postings[chunk] += j - first;
+                };
+                switch (postings.term_freqs.GetPrecision()) {
+                case TermFreqPrecision::FLOAT:
+                    add_relevances(postings.term_freqs.template GetData<float>());
+                    break;
+                case TermFreqPrecision::QUANTIZED_8:
+                    add_relevances(postings.term_freqs.template GetData<uint8_t>());
+                    break;
+                default:
+                    add_relevances(postings.term_freqs.template GetData<double>());
+                    break;
+                }
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    mt_document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+            typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+            for (int ordinal = begin; ordinal < end; ++ordinal) {
+                if (is_found[ordinal - begin]
+                    && IsDocumentAccepted(ordinal, removed_ordinals_[ordinal] || minus_scan.IsExcluded(ordinal), document_predicate)) {
+                    chunk_documents[chunk].emplace_back(ordinal_to_document_id_[ordinal], relevances[ordinal - begin], document_ratings_[ordinal]);
                 }
             }
         }
     );
-    std::map<int, double> document_to_relevance(mt_document_to_relevance.BuildOrdinaryMap());
-    std::for_each(
-    	std::execution::par,
-		query.minus_words.begin(),
-		query.minus_words.end(),
-		[this, &document_predicate, &document_to_relevance](std::string_view word){
-			if (word_to_document_freqs_.count(word) != 0) {
-				for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-					document_to_relevance.erase(document_id);
-				}
-			}
-    	}
-	);
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    // отрезки делят списки без перекрытий, поэтому суммы совпадают с последовательным обходом слово за словом
+    ++metrics.term_at_a_time_queries;
+    for (size_t chunk = 0; chunk < chunk_begins.size(); ++chunk) {
+        metrics.scanned_postings += chunk_scanned_postings[chunk];
+        metrics.scored_documents += chunk_documents[chunk].size();
     }
-    return matched_documents;
+    query_planner_counters_.Add(metrics);
+    if constexpr (IsProfiledPredicate<DocumentPredicate>::value) {
+        document_predicate.RecordExecution(QueryStrategy::TERM_AT_A_TIME, metrics);
+    }
+    for (const auto& documents : chunk_documents) {
+        for (const Document& document : documents) {
+            visit_document(document);
+        }
+    }
+}
+
+// передает в visit_document каждый найденный документ для запроса с обязательными словами
+// списки документов обязательных слов пересекаются от самого короткого к самому длинному, и только
+// оставшиеся документы проверяются на минус-слова и предикат и оцениваются; вклад всех плюс-слов
+// суммируется в том же порядке, что и в ForEachFoundDocument, поэтому релевантность совпадает
+template <typename Scorer, typename DocumentPredicate, typename DocumentVisitor>
+void SearchServer::ForEachFoundDocumentConjunctive(const Query& query, const Scorer& scorer, DocumentPredicate document_predicate, DocumentVisitor visit_document) const {
+    std::vector<int> candidates;
+    {
+        TRACE_SPAN(TERM_LOOKUP);
+        std::vector<const Ordinals*> required_lists;
+        for (const std::string_view word : query.required_words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            if (word_it == word_to_document_freqs_.end()) {
+                return;
+            }
+            required_lists.push_back(&word_it->second.ordinals);
+        }
+        candidates = IntersectPostings(required_lists);
+    }
+
+    const auto plus_postings = FindPlusWordPostings(query);
+    const auto minus_filter = BuildMinusWordsFilter(query, candidates.size());
+    TRACE_SPAN(SCORING);
+    {
+        TRACE_SPAN(FILTERING);
+        typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int ordinal) {
+            return !IsDocumentAccepted(ordinal, removed_ordinals_[ordinal] || minus_scan.IsExcluded(ordinal), document_predicate);
+        }), candidates.end());
+    }
+
+    std::vector<double> relevances(candidates.size(), 0.0);
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (!plus_postings[i]) {
+            continue;
+        }
+        const PostingList& postings = *plus_postings[i];
+        const double inverse_document_freq = scorer.ComputeInverseDocumentFreq(postings.GetDocumentFreq()) * query.plus_word_weights[i];
+        size_t position = 0;
+        for (size_t j = 0; j < candidates.size(); ++j) {
+            const int ordinal = candidates[j];
+            position = AdvanceTo(postings.ordinals, position, ordinal);
+            if (position == postings.ordinals.size()) {
+                break;
+            }
+            if (postings.ordinals[position] == ordinal) {
+                relevances[j] += scorer.ComputeTermScore(postings.term_freqs[position], document_inv_word_counts_[ordinal], inverse_document_freq);
+            }
+        }
+    }
+
+    for (size_t j = 0; j < candidates.size(); ++j) {
+        const int ordinal = candidates[j];
+        visit_document(Document(ordinal_to_document_id_[ordinal], relevances[j], document_ratings_[ordinal]));
+    }
+}
+
+// сопоставляет запрос с набором документов
+template <typename ExecutionPolicy>
+MatchedDocuments SearchServer::MatchDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    const auto query = ParseQuery(raw_query, true);
+    MatchedDocuments result;
+    std::vector<const PostingList*> word_postings;
+    for (const std::string_view word : query.plus_words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it != word_to_document_freqs_.end()) {
+            result.words.push_back(word_it->first);
+            word_postings.push_back(&word_it->second);
+        }
+    }
+    result.document_ids = document_ids;
+    result.statuses.reserve(document_ids.size());
+    result.blocks_per_document = (result.words.size() + 63) / 64;
+    result.word_bits.assign(document_ids.size() * result.blocks_per_document, 0);
+
+    // документы набора по возрастанию порядковых номеров: в таком порядке они сливаются со списками документов
+    std::vector<std::pair<int, size_t>> ordinal_to_index;
+    ordinal_to_index.reserve(document_ids.size());
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        const int ordinal = document_id_to_ordinal_.at(document_ids[index]);
+        ordinal_to_index.emplace_back(ordinal, index);
+        result.statuses.push_back(document_statuses_[ordinal]);
+    }
+    std::sort(ordinal_to_index.begin(), ordinal_to_index.end());
+
+    std::vector<const Ordinals*> required_lists;
+    for (const std::string_view word : query.required_words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            // обязательного слова нет ни в одном документе
+            return result;
+        }
+        required_lists.push_back(&word_it->second.ordinals);
+    }
+    const auto minus_filter = BuildMinusWordsFilter(query, ordinal_to_index.size());
+
+    constexpr size_t CHUNK_SIZE = 1024;
+    std::vector<size_t> chunk_begins;
+    for (size_t begin = 0; begin < ordinal_to_index.size(); begin += CHUNK_SIZE) {
+        chunk_begins.push_back(begin);
+    }
+    std::for_each(
+        policy,
+        chunk_begins.begin(),
+        chunk_begins.end(),
+        [&](size_t chunk_begin) {
+            const size_t chunk_end = std::min(chunk_begin + CHUNK_SIZE, ordinal_to_index.size());
+            // документы с минус-словом или без обязательного слова не совпадают с запросом
+            std::vector<bool> is_matched(chunk_end - chunk_begin, true);
+            typename ExclusionFilter<Ordinals>::Scan minus_scan(minus_filter);
+            std::vector<size_t> required_positions(required_lists.size(), 0);
+            for (size_t k = chunk_begin; k < chunk_end; ++k) {
+                const int ordinal = ordinal_to_index[k].first;
+                if (minus_scan.IsExcluded(ordinal)) {
+                    is_matched[k - chunk_begin] = false;
+                    continue;
+                }
+                for (size_t i = 0; i < required_lists.size(); ++i) {
+                    const Ordinals& ordinals = *required_lists[i];
+                    required_positions[i] = AdvanceTo(ordinals, required_positions[i], ordinal);
+                    if (required_positions[i] == ordinals.size() || ordinals[required_positions[i]] != ordinal) {
+                        is_matched[k - chunk_begin] = false;
+                        break;
+                    }
+                }
+            }
+            for (size_t word_index = 0; word_index < word_postings.size(); ++word_index) {
+                const Ordinals& ordinals = word_postings[word_index]->ordinals;
+                size_t position = 0;
+                for (size_t k = chunk_begin; k < chunk_end; ++k) {
+                    if (!is_matched[k - chunk_begin]) {
+                        continue;
+                    }
+                    const auto [ordinal, index] = ordinal_to_index[k];
+                    position = AdvanceTo(ordinals, position, ordinal);
+                    if (position == ordinals.size()) {
+                        break;
+                    }
+                    if (ordinals[position] == ordinal) {
+                        result.word_bits[index * result.blocks_per_document + word_index / 64] |= uint64_t{1} << (word_index % 64);
+                    }
+                }
+            }
+        }
+    );
+    return result;
 }
 
 // удаляет документ из поискового сервера по id
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
-    if (document_ids_.count(document_id) == 0) {
+    if (MarkDocumentRemoved(document_id) && NeedsCompaction()) {
+        Compact(policy);
+    }
+}
+
+// удаляет документы из поискового сервера по id; индекс уплотняется не более одного раза
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy, const std::vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        MarkDocumentRemoved(document_id);
+    }
+    if (NeedsCompaction()) {
+        Compact(policy);
+    }
+}
+
+// уплотняет индекс: новые номера документов сохраняют порядок старых, поэтому списки документов
+// остаются упорядоченными, и каждый список обрабатывается независимо от остальных
+// параллельно только переписываются элементы внутри уже выделенной памяти списков: память сервера выделяется
+// из общего ресурса, который может быть непотокобезопасным (monotonic_buffer_resource), поэтому освобождение
+// лишней памяти и перестроение таблиц частых слов выполняются затем последовательно
+template <typename ExecutionPolicy>
+void SearchServer::Compact(ExecutionPolicy&& policy) {
+    if (removed_count_ == 0) {
         return;
     }
-    std::map<std::string_view, double, std::less<>>& erase_map = document_id_to_word_freqs_.at(document_id);
-    std::vector<std::string_view> words(erase_map.size());
-    std::transform(
-        policy,
-        erase_map.begin(),
-        erase_map.end(),
-        words.begin(),
-        [](const auto item) { return item.first; }
-    );
+    std::vector<int> new_ordinals(ordinal_to_document_id_.size(), -1);
+    int live_count = 0;
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (!removed_ordinals_[ordinal]) {
+            new_ordinals[ordinal] = live_count++;
+        }
+    }
+    std::vector<PostingList*> posting_lists;
+    posting_lists.reserve(word_to_document_freqs_.size());
+    for (auto& [word, postings] : word_to_document_freqs_) {
+        posting_lists.push_back(&postings);
+    }
+    // новый размер каждого списка и размер его таблицы частого слова до уплотнения
+    std::vector<size_t> new_sizes(posting_lists.size());
+    std::vector<size_t> old_impact_counts(posting_lists.size());
+    std::vector<size_t> list_indexes(posting_lists.size());
+    std::iota(list_indexes.begin(), list_indexes.end(), 0);
     std::for_each(
         policy,
-        words.begin(),
-        words.end(),
-        [&](const auto& word) {
-            word_to_document_freqs_.at(word).erase(document_id);
+        list_indexes.begin(),
+        list_indexes.end(),
+        [this, &new_ordinals, &posting_lists, &new_sizes, &old_impact_counts](size_t index) {
+            PostingList* postings = posting_lists[index];
+            size_t size = 0;
+            // пределы вклада пересчитываются по оставшимся документам; блоков становится не больше,
+            // чем было, так что они пишутся в прежнюю память
+            postings->max_term_freq = 0.0;
+            postings->min_inv_document_length = std::numeric_limits<double>::max();
+            postings->block_max_term_freqs.clear();
+            postings->block_min_inv_document_lengths.clear();
+            for (size_t j = 0; j < postings->ordinals.size(); ++j) {
+                const int new_ordinal = new_ordinals[postings->ordinals[j]];
+                if (new_ordinal >= 0) {
+                    postings->UpdateScoreBounds(size, postings->term_freqs[j], document_inv_word_counts_[postings->ordinals[j]]);
+                    postings->ordinals[size] = new_ordinal;
+                    postings->term_freqs.Move(j, size);
+                    ++size;
+                }
+            }
+            // порядок таблицы частого слова при переходе к новым номерам не меняется
+            old_impact_counts[index] = postings->impacts.size();
+            size_t impact_count = 0;
+            for (const auto& impact : postings->impacts) {
+                if (new_ordinals[impact.ordinal] >= 0) {
+                    postings->impacts[impact_count++] = {impact.term_freq, new_ordinals[impact.ordinal]};
+                }
+            }
+            postings->impacts.resize(impact_count);
+            new_sizes[index] = size;
+            postings->removed_count = 0;
         }
     );
-    document_ids_.erase(document_id);
-    documents_.erase(document_id);
-    document_id_to_word_freqs_.erase(document_id);
+    for (size_t index = 0; index < posting_lists.size(); ++index) {
+        PostingList* postings = posting_lists[index];
+        const size_t size = new_sizes[index];
+        if (size < postings->ordinals.size()) {
+            postings->ordinals.resize(size);
+            postings->ordinals.shrink_to_fit();
+            postings->term_freqs.Resize(size);
+            postings->term_freqs.ShrinkToFit();
+            postings->block_max_term_freqs.shrink_to_fit();
+            postings->block_min_inv_document_lengths.shrink_to_fit();
+        }
+        const size_t impact_count = postings->impacts.size();
+        if (old_impact_counts[index] > 0 && impact_count < IMPACT_TABLE_SIZE / 2 && impact_count < size) {
+            postings->BuildImpacts();
+        }
+    }
+    CompactDocuments(new_ordinals);
 }
 
 void PrintMatchDocumentResult(int document_id, const std::vector<std::string_view> words, DocumentStatus status);
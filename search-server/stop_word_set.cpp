@@ -0,0 +1,36 @@
+#include "stop_word_set.h"
+
+using namespace std;
+
+// строит таблицу для различных непустых слов
+void StopWordSet::Build(vector<string> words) {
+    using namespace stop_words_detail;
+    const size_t word_count = words.size();
+    vector<uint64_t> word_hashes(word_count);
+    for (size_t word = 0; word < word_count; ++word) {
+        word_hashes[word] = HashWord(words[word]);
+    }
+    seeds_.resize(GetBucketCount(word_count));
+    vector<uint32_t> slot_words(word_count);
+    vector<uint32_t> bucket_starts(seeds_.size() + 1);
+    vector<uint32_t> bucket_words(word_count);
+    vector<uint32_t> bucket_order(seeds_.size());
+    BuildPerfectHash(word_hashes.data(), word_count, seeds_.data(), seeds_.size(), slot_words.data(),
+                     bucket_starts.data(), bucket_words.data(), bucket_order.data());
+    words_.resize(word_count);
+    hashes_.resize(word_count);
+    for (size_t slot = 0; slot < word_count; ++slot) {
+        words_[slot] = move(words[slot_words[slot]]);
+        hashes_[slot] = word_hashes[slot_words[slot]];
+    }
+}
+
+MemoryUsage StopWordSet::GetMemoryStats() const {
+    MemoryUsage usage = GetVectorMemoryUsage(words_);
+    for (const string& word : words_) {
+        usage += GetStringMemoryUsage(word);
+    }
+    usage += GetVectorMemoryUsage(hashes_);
+    usage += GetVectorMemoryUsage(seeds_);
+    return usage;
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "memory_usage.h"
+#include "string_processing.h"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// множество стоп-слов на минимальной совершенной хэш-функции: слово проверяется одним вычислением хэша,
+// сравнением 64-битного отпечатка (самого хэша) и, только если отпечаток совпал, сравнением строк
+// функция строится методом "hash and displace": слова раскладываются по корзинам, и для каждой корзины,
+// начиная с самых больших, подбирается затравка, при которой все ее слова попадают в свободные слоты;
+// слотов ровно столько, сколько слов
+// построение записано один раз на constexpr-функциях над массивами, поэтому для списков, известных
+// на этапе компиляции, таблица строится компилятором (StaticStopWordSet), а для остальных -- при создании
+// StopWordSet
+namespace stop_words_detail {
+
+inline constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+// финализатор splitmix64: перемешивает биты, чтобы соседние затравки давали независимые слоты
+constexpr uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+// FNV-1a с перемешиванием результата
+constexpr uint64_t HashWord(std::string_view word) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const char symbol : word) {
+        hash = (hash ^ static_cast<unsigned char>(symbol)) * 0x100000001B3ULL;
+    }
+    return Mix(hash);
+}
+
+constexpr size_t GetBucketCount(size_t word_count) {
+    return word_count / 2 + 1;
+}
+
+constexpr size_t GetBucket(uint64_t hash, size_t bucket_count) {
+    return (hash >> 32) % bucket_count;
+}
+
+constexpr size_t GetSlot(uint64_t hash, uint32_t seed, size_t slot_count) {
+    return Mix(hash + seed * 0x9E3779B97F4A7C15ULL) % slot_count;
+}
+
+// строит таблицу для word_count слов с хэшами word_hashes (хэши должны быть различны)
+// результат: seeds (bucket_count затравок) и slot_words (номер слова в каждом из word_count слотов)
+// bucket_starts (bucket_count + 1), bucket_words (word_count) и bucket_order (bucket_count) -- рабочие массивы
+constexpr void BuildPerfectHash(const uint64_t* word_hashes, size_t word_count, uint32_t* seeds, size_t bucket_count,
+                                uint32_t* slot_words, uint32_t* bucket_starts, uint32_t* bucket_words, uint32_t* bucket_order) {
+    // раскладка слов по корзинам подсчетом
+    for (size_t bucket = 0; bucket <= bucket_count; ++bucket) {
+        bucket_starts[bucket] = 0;
+    }
+    for (size_t word = 0; word < word_count; ++word) {
+        ++bucket_starts[GetBucket(word_hashes[word], bucket_count) + 1];
+    }
+    size_t max_bucket_size = 0;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        max_bucket_size = bucket_starts[bucket + 1] > max_bucket_size ? bucket_starts[bucket + 1] : max_bucket_size;
+        bucket_starts[bucket + 1] += bucket_starts[bucket];
+    }
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        bucket_order[bucket] = bucket_starts[bucket];
+    }
+    for (size_t word = 0; word < word_count; ++word) {
+        bucket_words[bucket_order[GetBucket(word_hashes[word], bucket_count)]++] = static_cast<uint32_t>(word);
+    }
+    // корзины по убыванию размера: большие корзины размещаются, пока свободных слотов много
+    size_t ordered = 0;
+    for (size_t size = max_bucket_size; size > 0; --size) {
+        for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+            if (bucket_starts[bucket + 1] - bucket_starts[bucket] == size) {
+                bucket_order[ordered++] = static_cast<uint32_t>(bucket);
+            }
+        }
+    }
+
+    for (size_t slot = 0; slot < word_count; ++slot) {
+        slot_words[slot] = EMPTY_SLOT;
+    }
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        seeds[bucket] = 0;
+    }
+    for (size_t i = 0; i < ordered; ++i) {
+        const size_t bucket = bucket_order[i];
+        const uint32_t begin = bucket_starts[bucket];
+        const uint32_t end = bucket_starts[bucket + 1];
+        // слова с одинаковым хэшем никакая затравка не разведет
+        for (uint32_t lhs = begin; lhs < end; ++lhs) {
+            for (uint32_t rhs = lhs + 1; rhs < end; ++rhs) {
+                if (word_hashes[bucket_words[lhs]] == word_hashes[bucket_words[rhs]]) {
+                    throw std::invalid_argument("Duplicate stop word");
+                }
+            }
+        }
+        for (uint32_t seed = 0;; ++seed) {
+            uint32_t placed = begin;
+            while (placed < end) {
+                const size_t slot = GetSlot(word_hashes[bucket_words[placed]], seed, word_count);
+                if (slot_words[slot] != EMPTY_SLOT) {
+                    break;
+                }
+                slot_words[slot] = bucket_words[placed++];
+            }
+            if (placed == end) {
+                seeds[bucket] = seed;
+                break;
+            }
+            // затравка не подошла: слоты, занятые словами этой корзины, освобождаются
+            for (uint32_t word = begin; word < placed; ++word) {
+                slot_words[GetSlot(word_hashes[bucket_words[word]], seed, word_count)] = EMPTY_SLOT;
+            }
+        }
+    }
+}
+
+}  // namespace stop_words_detail
+
+// множество стоп-слов, известное на этапе компиляции:
+//   constexpr auto STOP_WORDS = MakeStopWordSet("и"sv, "в"sv, "на"sv);
+//   static_assert(STOP_WORDS.Contains("и"sv));
+// слова должны быть непустыми и различными, иначе построение не скомпилируется
+template <size_t N>
+class StaticStopWordSet {
+public:
+    constexpr explicit StaticStopWordSet(const std::array<std::string_view, N>& words) {
+        using namespace stop_words_detail;
+        std::array<uint64_t, N> word_hashes{};
+        for (size_t word = 0; word < N; ++word) {
+            if (words[word].empty()) {
+                throw std::invalid_argument("Empty stop word");
+            }
+            word_hashes[word] = HashWord(words[word]);
+        }
+        std::array<uint32_t, N> slot_words{};
+        std::array<uint32_t, GetBucketCount(N) + 1> bucket_starts{};
+        std::array<uint32_t, N> bucket_words{};
+        std::array<uint32_t, GetBucketCount(N)> bucket_order{};
+        BuildPerfectHash(word_hashes.data(), N, seeds_.data(), seeds_.size(), slot_words.data(),
+                         bucket_starts.data(), bucket_words.data(), bucket_order.data());
+        for (size_t slot = 0; slot < N; ++slot) {
+            words_[slot] = words[slot_words[slot]];
+            hashes_[slot] = word_hashes[slot_words[slot]];
+        }
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        using namespace stop_words_detail;
+        if (N == 0) {
+            return false;
+        }
+        const uint64_t hash = HashWord(word);
+        const size_t slot = GetSlot(hash, seeds_[GetBucket(hash, seeds_.size())], N);
+        return hashes_[slot] == hash && words_[slot] == word;
+    }
+
+    constexpr size_t size() const {
+        return N;
+    }
+
+    // слова перечисляются в порядке слотов
+    constexpr auto begin() const {
+        return words_.begin();
+    }
+
+    constexpr auto end() const {
+        return words_.end();
+    }
+
+private:
+    friend class StopWordSet;
+
+    std::array<std::string_view, N> words_{};
+    std::array<uint64_t, N> hashes_{};
+    std::array<uint32_t, stop_words_detail::GetBucketCount(N)> seeds_{};
+};
+
+template <typename... Words>
+constexpr StaticStopWordSet<sizeof...(Words)> MakeStopWordSet(Words... words) {
+    return StaticStopWordSet<sizeof...(Words)>({std::string_view(words)...});
+}
+
+// множество стоп-слов, заданное при выполнении; пустые слова и повторы отбрасываются
+class StopWordSet {
+public:
+    StopWordSet() = default;
+
+    template <typename StringContainer>
+    explicit StopWordSet(const StringContainer& words);
+
+    // таблица, построенная при компиляции, копируется без перестроения
+    template <size_t N>
+    explicit StopWordSet(const StaticStopWordSet<N>& words);
+
+    bool Contains(std::string_view word) const {
+        using namespace stop_words_detail;
+        if (words_.empty()) {
+            return false;
+        }
+        const uint64_t hash = HashWord(word);
+        const size_t slot = GetSlot(hash, seeds_[GetBucket(hash, seeds_.size())], words_.size());
+        return hashes_[slot] == hash && words_[slot] == word;
+    }
+
+    size_t size() const {
+        return words_.size();
+    }
+
+    // слова перечисляются в порядке слотов
+    std::vector<std::string>::const_iterator begin() const {
+        return words_.begin();
+    }
+
+    std::vector<std::string>::const_iterator end() const {
+        return words_.end();
+    }
+
+    // слова, отпечатки и затравки; сам объект множества не учитывается
+    MemoryUsage GetMemoryStats() const;
+
+private:
+    void Build(std::vector<std::string> words);
+
+    std::vector<std::string> words_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> seeds_;
+};
+
+template <typename StringContainer>
+StopWordSet::StopWordSet(const StringContainer& words) {
+    const auto unique_words = MakeUniqueNonEmptyStrings(words);
+    Build(std::vector<std::string>(unique_words.begin(), unique_words.end()));
+}
+
+template <size_t N>
+StopWordSet::StopWordSet(const StaticStopWordSet<N>& words)
+    : words_(words.words_.begin(), words.words_.end())
+    , hashes_(words.hashes_.begin(), words.hashes_.end())
+    , seeds_(words.seeds_.begin(), words.seeds_.end()) {
+}
@@ -10,7 +10,7 @@ std::vector<std::string_view> SplitIntoWords(std::string_view text);
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> result;
-    for (const auto str : strings) {
+    for (const auto& str : strings) {
         if (!str.empty()) {
             result.emplace(std::string(str));
         }
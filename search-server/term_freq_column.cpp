@@ -0,0 +1,190 @@
+#include "term_freq_column.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+using namespace std;
+
+string_view GetTermFreqPrecisionName(TermFreqPrecision precision) {
+    switch (precision) {
+    case TermFreqPrecision::DOUBLE:
+        return "DOUBLE"sv;
+    case TermFreqPrecision::FLOAT:
+        return "FLOAT"sv;
+    case TermFreqPrecision::QUANTIZED_8:
+        return "QUANTIZED_8"sv;
+    }
+    return "UNKNOWN"sv;
+}
+
+namespace term_freq_detail {
+
+// шаг шкалы -- 1/16 удвоения, наибольший уровень равен 1 (частота не бывает больше 1)
+const int QUANTIZED_LEVELS_PER_OCTAVE = 16;
+const int QUANTIZED_MAX_LEVEL = 255;
+
+const array<double, 256> QUANTIZED_TERM_FREQS = [] {
+    array<double, 256> term_freqs{};
+    for (int level = 0; level <= QUANTIZED_MAX_LEVEL; ++level) {
+        term_freqs[level] = exp2(static_cast<double>(level - QUANTIZED_MAX_LEVEL) / QUANTIZED_LEVELS_PER_OCTAVE);
+    }
+    return term_freqs;
+}();
+
+// округление в логарифмической шкале: до ближайшего уровня отношение частоты не больше 2^(1/32)
+uint8_t QuantizeTermFreq(double term_freq) {
+    if (!(term_freq > 0.0)) {
+        return 0;
+    }
+    const long level = lround(QUANTIZED_MAX_LEVEL + QUANTIZED_LEVELS_PER_OCTAVE * log2(term_freq));
+    return static_cast<uint8_t>(clamp(level, 0L, static_cast<long>(QUANTIZED_MAX_LEVEL)));
+}
+
+}  // namespace term_freq_detail
+
+namespace {
+
+template <typename TermFreq>
+TermFreq EncodeTermFreq(double term_freq) {
+    if constexpr (is_same_v<TermFreq, uint8_t>) {
+        return term_freq_detail::QuantizeTermFreq(term_freq);
+    } else {
+        return static_cast<TermFreq>(term_freq);
+    }
+}
+
+template <typename Values, typename Allocator>
+Values CopyValues(const Values& values, const Allocator& allocator) {
+    return visit([&allocator](const auto& typed_values) {
+        return Values(in_place_type<decay_t<decltype(typed_values)>>, typed_values, allocator);
+    }, values);
+}
+
+template <typename Values, typename Allocator>
+Values MoveValues(Values&& values, const Allocator& allocator) {
+    return visit([&allocator](auto& typed_values) {
+        return Values(in_place_type<decay_t<decltype(typed_values)>>, move(typed_values), allocator);
+    }, values);
+}
+
+}  // namespace
+
+TermFreqColumn::TermFreqColumn(const allocator_type& allocator)
+    : values_(in_place_index<0>, allocator)
+{
+}
+
+TermFreqColumn::TermFreqColumn(TermFreqPrecision precision, const allocator_type& allocator)
+    : values_(in_place_index<0>, allocator)
+{
+    Reset(precision);
+}
+
+TermFreqColumn::TermFreqColumn(const TermFreqColumn& other, const allocator_type& allocator)
+    : values_(CopyValues(other.values_, allocator))
+{
+}
+
+TermFreqColumn::TermFreqColumn(TermFreqColumn&& other, const allocator_type& allocator)
+    : values_(MoveValues(move(other.values_), allocator))
+{
+}
+
+TermFreqPrecision TermFreqColumn::GetPrecision() const {
+    switch (values_.index()) {
+    case 1:
+        return TermFreqPrecision::FLOAT;
+    case 2:
+        return TermFreqPrecision::QUANTIZED_8;
+    default:
+        return TermFreqPrecision::DOUBLE;
+    }
+}
+
+void TermFreqColumn::Reset(TermFreqPrecision precision) {
+    pmr::memory_resource* resource = Visit([](const auto& values) {
+        return values.get_allocator().resource();
+    });
+    switch (precision) {
+    case TermFreqPrecision::FLOAT:
+        values_.emplace<1>(resource);
+        break;
+    case TermFreqPrecision::QUANTIZED_8:
+        values_.emplace<2>(resource);
+        break;
+    default:
+        values_.emplace<0>(resource);
+        break;
+    }
+}
+
+size_t TermFreqColumn::size() const {
+    return Visit([](const auto& values) {
+        return values.size();
+    });
+}
+
+bool TermFreqColumn::empty() const {
+    return size() == 0;
+}
+
+void TermFreqColumn::Set(size_t position, double term_freq) {
+    Visit([position, term_freq](auto& values) {
+        values[position] = EncodeTermFreq<typename decay_t<decltype(values)>::value_type>(term_freq);
+    });
+}
+
+void TermFreqColumn::PushBack(double term_freq) {
+    Visit([term_freq](auto& values) {
+        values.push_back(EncodeTermFreq<typename decay_t<decltype(values)>::value_type>(term_freq));
+    });
+}
+
+void TermFreqColumn::Insert(size_t position, double term_freq) {
+    Visit([position, term_freq](auto& values) {
+        values.insert(values.begin() + position, EncodeTermFreq<typename decay_t<decltype(values)>::value_type>(term_freq));
+    });
+}
+
+void TermFreqColumn::Erase(size_t position) {
+    Visit([position](auto& values) {
+        values.erase(values.begin() + position);
+    });
+}
+
+void TermFreqColumn::Move(size_t from, size_t to) {
+    Visit([from, to](auto& values) {
+        values[to] = values[from];
+    });
+}
+
+void TermFreqColumn::Reserve(size_t size) {
+    Visit([size](auto& values) {
+        values.reserve(size);
+    });
+}
+
+void TermFreqColumn::Resize(size_t size) {
+    Visit([size](auto& values) {
+        values.resize(size);
+    });
+}
+
+void TermFreqColumn::ShrinkToFit() {
+    Visit([](auto& values) {
+        values.shrink_to_fit();
+    });
+}
+
+size_t TermFreqColumn::GetMemoryUsage() const {
+    return Visit([](const auto& values) {
+        return values.capacity() * sizeof(typename decay_t<decltype(values)>::value_type);
+    });
+}
+
+MemoryUsage TermFreqColumn::GetMemoryStats() const {
+    return Visit([](const auto& values) {
+        return GetVectorMemoryUsage(values);
+    });
+}
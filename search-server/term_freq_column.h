@@ -0,0 +1,133 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// представление частот слов в списках документов
+// ошибка ранжирования: при любом представлении частота хранится с относительной погрешностью не больше delta,
+// а функции ранжирования из scorer.h меняют вклад слова не сильнее, чем его частоту (TF-IDF -- пропорционально,
+// BM25 -- tf / (tf + c) -- еще слабее); поэтому релевантность документа отличается от точной не больше чем
+// в (1 + delta) раз, и два документа сохраняют взаимный порядок, если их точные релевантности различаются
+// больше чем в (1 + delta)^2 раз; пределы вклада и таблицы частых слов строятся по хранимым частотам,
+// так что отсечение при поиске остается точным относительно хранимых частот
+enum class TermFreqPrecision {
+    // 8 байт на частоту, точные значения; по умолчанию
+    DOUBLE,
+    // 4 байта, delta = 2^-24 (около 6e-8): порядок меняется только у документов, почти равных по релевантности
+    FLOAT,
+    // 1 байт: частота округляется до ближайшего уровня логарифмической шкалы 2^((q - 255) / 16), q = 0..255,
+    // -- 16 уровней на каждое удвоение частоты от 1 до 2^-15.94; delta = 2^(1/32) - 1 (около 2.2%),
+    // порядок сохраняется при разнице релевантностей больше 4.4%; частоты меньше 2^-15.94 (слово, встреченное
+    // один раз в документе длиннее 62 тысяч слов) округляются до наименьшего уровня
+    QUANTIZED_8,
+};
+
+std::string_view GetTermFreqPrecisionName(TermFreqPrecision precision);
+
+namespace term_freq_detail {
+
+// значения уровней 8-битной шкалы
+extern const std::array<double, 256> QUANTIZED_TERM_FREQS;
+
+uint8_t QuantizeTermFreq(double term_freq);
+
+}  // namespace term_freq_detail
+
+// перевод хранимого значения в частоту; поиск выбирает перегрузку по типу хранения во время компиляции
+inline double DecodeTermFreq(double term_freq) {
+    return term_freq;
+}
+
+inline double DecodeTermFreq(float term_freq) {
+    return term_freq;
+}
+
+inline double DecodeTermFreq(uint8_t term_freq) {
+    return term_freq_detail::QUANTIZED_TERM_FREQS[term_freq];
+}
+
+// частоты слова в документах списка в одном из представлений TermFreqPrecision
+// значения читаются уже переведенными в double, а циклы поиска обращаются к массиву нужного типа напрямую (GetData)
+// поддерживает uses-allocator construction, как и список документов, в котором лежит
+class TermFreqColumn {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    explicit TermFreqColumn(const allocator_type& allocator = {});
+    TermFreqColumn(TermFreqPrecision precision, const allocator_type& allocator = {});
+    TermFreqColumn(const TermFreqColumn& other, const allocator_type& allocator);
+    TermFreqColumn(TermFreqColumn&& other, const allocator_type& allocator);
+
+    TermFreqPrecision GetPrecision() const;
+    // очищает столбец и меняет представление
+    void Reset(TermFreqPrecision precision);
+
+    size_t size() const;
+    bool empty() const;
+
+    double operator[](size_t position) const;
+
+    // значения в представлении TermFreq; TermFreq должен соответствовать GetPrecision()
+    template <typename TermFreq>
+    const TermFreq* GetData() const {
+        return std::get<std::pmr::vector<TermFreq>>(values_).data();
+    }
+
+    void Set(size_t position, double term_freq);
+    void PushBack(double term_freq);
+    void Insert(size_t position, double term_freq);
+    void Erase(size_t position);
+    // переносит значение на другое место, не перекодируя его (уплотнение индекса)
+    void Move(size_t from, size_t to);
+    void Reserve(size_t size);
+    void Resize(size_t size);
+    void ShrinkToFit();
+
+    // байты, выделенные под значения
+    size_t GetMemoryUsage() const;
+    // то же с разделением на значения и незанятую емкость с заголовком блока
+    MemoryUsage GetMemoryStats() const;
+
+private:
+    using Values = std::variant<std::pmr::vector<double>, std::pmr::vector<float>, std::pmr::vector<uint8_t>>;
+
+    // вызывает function для массива текущего представления
+    template <typename Function>
+    decltype(auto) Visit(Function function) const {
+        switch (values_.index()) {
+        case 1:
+            return function(*std::get_if<1>(&values_));
+        case 2:
+            return function(*std::get_if<2>(&values_));
+        default:
+            return function(*std::get_if<0>(&values_));
+        }
+    }
+
+    template <typename Function>
+    decltype(auto) Visit(Function function) {
+        switch (values_.index()) {
+        case 1:
+            return function(*std::get_if<1>(&values_));
+        case 2:
+            return function(*std::get_if<2>(&values_));
+        default:
+            return function(*std::get_if<0>(&values_));
+        }
+    }
+
+    Values values_;
+};
+
+inline double TermFreqColumn::operator[](size_t position) const {
+    return Visit([position](const auto& values) {
+        return DecodeTermFreq(values[position]);
+    });
+}
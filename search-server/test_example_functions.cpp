@@ -1,5 +1,11 @@
 #include "test_example_functions.h"
 
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
 using namespace std;
 
 // проверка на истинность
@@ -230,6 +236,1646 @@ void TestRemoveDocument() {
     ASSERT_EQUAL_HINT(search_result.size(), 4, "4 documents should be found"s);
 }
 
+// тест проверяет нечеткий поиск по словам с опечатками
+void TestFuzzySearch() {
+    SearchServer server("и в на"s);
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(3, "cat with a long tail"s, DocumentStatus::ACTUAL, {1});
+
+    // без нечеткого поиска слово с опечаткой ничего не находит
+    ASSERT_HINT(server.FindTopDocuments("пушыстый"s).empty(), "Fuzzy search must be disabled by default"s);
+
+    server.SetFuzzySearch(1, 0.5);
+    auto search_result = server.FindTopDocuments("пушыстый"s);
+    ASSERT_EQUAL_HINT(search_result.size(), 1, "Word with a typo must be found"s);
+    ASSERT_EQUAL(search_result[0].id, 1);
+
+    // вклад слова, найденного с одной правкой, умножается на штраф
+    const double exact_relevance = server.FindTopDocuments("пушистый"s)[0].relevance;
+    ASSERT_HINT(abs(search_result[0].relevance - exact_relevance * 0.5) < EPSILON, "Fuzzy penalty must be applied"s);
+
+    // двух правок недостаточно при максимальном расстоянии 1
+    ASSERT(server.FindTopDocuments("tayl"s).size() == 1);
+    ASSERT(server.FindTopDocuments("taiil"s).size() == 1);
+    ASSERT(server.FindTopDocuments("teyl"s).empty());
+    server.SetFuzzySearch(2, 0.5);
+    ASSERT(server.FindTopDocuments("teyl"s).size() == 1);
+
+    server.SetFuzzySearch(0, 1.0);
+    ASSERT(server.FindTopDocuments("tayl"s).empty());
+
+    // найденные слова и их веса совпадают с перебором словаря; символы сравниваются целиком, а не по байтам
+    const auto distance = [](const string& lhs, const string& rhs) {
+        const u32string a = DecodeUtf8String(lhs);
+        const u32string b = DecodeUtf8String(rhs);
+        vector<int> row(b.size() + 1);
+        iota(row.begin(), row.end(), 0);
+        for (size_t i = 1; i <= a.size(); ++i) {
+            int diagonal = row[0];
+            row[0] = static_cast<int>(i);
+            for (size_t j = 1; j <= b.size(); ++j) {
+                const int above = row[j];
+                row[j] = min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1)});
+                diagonal = above;
+            }
+        }
+        return row.back();
+    };
+    const vector<string> letters = {"a"s, "b"s, "c"s, "к"s, "ё"s};
+    // слово словаря и число документов с ним
+    map<string, int> dictionary;
+    for (int i = 0; dictionary.size() < 300; ++i) {
+        string word;
+        for (int value = i * 7919 % 100003, length = 1 + i % 6; length > 0; --length, value /= 5) {
+            word += letters[value % 5];
+        }
+        dictionary[word] = 1;
+    }
+    SearchServer dictionary_server(""s);
+    int document_id = 0;
+    for (const auto& [word, document_count] : dictionary) {
+        dictionary_server.AddDocument(document_id++, word, DocumentStatus::ACTUAL, {1});
+    }
+    // частые слова предпочитаются при равном числе правок
+    for (const string& word : {"ab"s, "кк"s, "ёc"s}) {
+        dictionary_server.AddDocument(document_id++, word + " "s + word, DocumentStatus::ACTUAL, {1});
+        ++dictionary[word];
+    }
+    const auto check_fuzzy_words = [&](const SearchServer& server, int max_distance) {
+        for (const string& query : {"a"s, "abc"s, "кёк"s, "bakёc"s, "cccccc"s, "aкaкaкaк"s, "x"s}) {
+            QueryProfile profile;
+            server.FindTopDocuments(query, profile);
+            map<string, double> found;
+            for (const TermProfile& term : profile.plus_terms) {
+                found[term.word] = term.weight;
+            }
+            // само слово и FUZZY_EXPANSION_LIMIT ближайших слов, среди них -- более частых, затем меньших
+            map<string, double> expected;
+            vector<tuple<int, int, string>> candidates;
+            for (const auto& [word, document_count] : dictionary) {
+                if (const int word_distance = distance(query, word); word_distance == 0) {
+                    expected[word] = 1.0;
+                } else if (word_distance <= max_distance) {
+                    candidates.emplace_back(word_distance, -document_count, word);
+                }
+            }
+            sort(candidates.begin(), candidates.end());
+            for (size_t i = 0; i < min(candidates.size(), FUZZY_EXPANSION_LIMIT); ++i) {
+                expected[get<2>(candidates[i])] = pow(0.5, get<0>(candidates[i]));
+            }
+            ASSERT_HINT(found == expected, query);
+        }
+    };
+    dictionary_server.SetFuzzySearch(1, 0.5);
+    check_fuzzy_words(dictionary_server, 1);
+    dictionary_server.SetFuzzySearch(2, 0.5);
+    check_fuzzy_words(dictionary_server, 2);
+    // слова, добавленные и удаленные после включения нечеткого поиска, учитываются
+    for (const string& word : {"ёёёёёёёё"s, "abcc"s, "кёкк"s, "aкaкaкa"s}) {
+        dictionary_server.AddDocument(document_id++, word, DocumentStatus::ACTUAL, {1});
+        ++dictionary[word];
+    }
+    check_fuzzy_words(dictionary_server, 2);
+    for (int id = 0; id < 150; ++id) {
+        const string word((*dictionary_server.GetWordFrequencies(id).begin()).first);
+        dictionary_server.RemoveDocument(id);
+        if (--dictionary[word] == 0) {
+            dictionary.erase(word);
+        }
+    }
+    check_fuzzy_words(dictionary_server, 2);
+    // копия сервера ищет по своему словарю
+    const SearchServer server_copy(dictionary_server);
+    check_fuzzy_words(server_copy, 2);
+}
+
+// тест проверяет ранжирование по BM25, передаваемое параметром шаблона
+void TestBm25Ranking() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+
+    // все документы состоят из 4 слов, поэтому нормировка по длине равна 1
+    const double k1 = Bm25Scorer::K1;
+    const double idf_fluffy = log(1.0 + (3 - 1 + 0.5) / (1 + 0.5));
+    const double idf_cat = log(1.0 + (3 - 2 + 0.5) / (2 + 0.5));
+    const double expected_relevance_1 = idf_fluffy * (k1 + 1.0) * 2 / (2 + k1) + idf_cat;
+    const double expected_relevance_0 = idf_cat;
+
+    const auto search_result = server.FindTopDocuments<Bm25Scorer>("пушистый кот"s);
+    ASSERT_EQUAL(search_result.size(), 2);
+    ASSERT_EQUAL(search_result[0].id, 1);
+    ASSERT_EQUAL(search_result[1].id, 0);
+    ASSERT_HINT(abs(search_result[0].relevance - expected_relevance_1) < EPSILON, "BM25 relevance calculation error"s);
+    ASSERT_HINT(abs(search_result[1].relevance - expected_relevance_0) < EPSILON, "BM25 relevance calculation error"s);
+
+    // параллельная версия должна давать тот же результат
+    const auto par_search_result = server.FindTopDocuments<Bm25Scorer>(std::execution::par, "пушистый кот"s);
+    ASSERT_EQUAL(par_search_result.size(), 2);
+    ASSERT_HINT(abs(par_search_result[0].relevance - expected_relevance_1) < EPSILON, "BM25 relevance calculation error"s);
+
+    // по умолчанию используется TF-IDF
+    ASSERT_HINT(abs(server.FindTopDocuments("пушистый"s)[0].relevance - 0.5 * log(3.0)) < EPSILON, "TF-IDF must be the default"s);
+}
+
+// тест проверяет, что внутренняя нумерация документов не влияет на внешний интерфейс
+void TestDocumentIdsAfterRemoval() {
+    SearchServer server(""s);
+    server.AddDocument(5, "пушистый кот"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(1, "ухоженный пёс"s, DocumentStatus::BANNED, {2});
+    server.AddDocument(3, "пушистый пёс"s, DocumentStatus::ACTUAL, {3});
+
+    // документы перебираются по возрастанию id, а не в порядке добавления
+    ASSERT_HINT(vector<int>(server.begin(), server.end()) == vector<int>({1, 3, 5}), "Documents must be iterated by id"s);
+
+    server.RemoveDocument(1);
+    ASSERT(vector<int>(server.begin(), server.end()) == vector<int>({3, 5}));
+    ASSERT(server.GetWordFrequencies(1).empty());
+    ASSERT(server.FindTopDocuments("ухоженный"s, DocumentStatus::BANNED).empty());
+
+    // id удаленного документа можно использовать повторно
+    server.AddDocument(1, "ухоженный кот"s, DocumentStatus::ACTUAL, {7});
+    ASSERT(vector<int>(server.begin(), server.end()) == vector<int>({1, 3, 5}));
+    const auto search_result = server.FindTopDocuments("ухоженный"s);
+    ASSERT_EQUAL(search_result.size(), 1);
+    ASSERT_EQUAL(search_result[0].id, 1);
+    ASSERT_EQUAL(search_result[0].rating, 7);
+    const auto [words, status] = server.MatchDocument("ухоженный пёс"s, 1);
+    ASSERT_EQUAL(words.size(), 1);
+    ASSERT(status == DocumentStatus::ACTUAL);
+}
+
+// тест проверяет, что индексы сервера размещаются в переданном ресурсе памяти
+void TestMemoryResource() {
+    // ресурс, подсчитывающий объем выделенной через него памяти
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        size_t allocated_bytes = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            allocated_bytes += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    CountingResource counting_resource;
+    std::pmr::monotonic_buffer_resource arena(&counting_resource);
+    {
+        SearchServer server("и в на"s, &arena);
+        ASSERT_EQUAL(counting_resource.allocated_bytes, 0);
+        server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+        server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+        ASSERT_HINT(counting_resource.allocated_bytes > 0, "Index must be allocated from the given resource"s);
+        const auto search_result = server.FindTopDocuments("пушистый пёс"s);
+        ASSERT_EQUAL(search_result.size(), 2);
+        server.RemoveDocument(1);
+        ASSERT_EQUAL(server.FindTopDocuments("пушистый пёс"s).size(), 1);
+    }
+}
+
+// тест проверяет поиск с обязательными словами (+слово)
+void TestRequiredWords() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+
+    // необязательные слова только влияют на релевантность, релевантность совпадает с обычным поиском
+    auto search_result = server.FindTopDocuments("+кот хвост пёс"s);
+    ASSERT_EQUAL(search_result.size(), 2);
+    ASSERT_EQUAL(search_result[0].id, 1);
+    ASSERT_EQUAL(search_result[1].id, 0);
+    const auto or_search_result = server.FindTopDocuments("кот хвост пёс"s);
+    ASSERT_EQUAL(or_search_result[0].id, 1);
+    ASSERT_EQUAL_HINT(search_result[0].relevance, or_search_result[0].relevance, "Relevance must not depend on query mode"s);
+
+    ASSERT_EQUAL(server.FindTopDocuments("+кот +хвост"s).size(), 1);
+    ASSERT_EQUAL(server.FindTopDocuments("+кот -хвост"s).size(), 1);
+    ASSERT(server.FindTopDocuments("+кот +платипус"s).empty());
+
+    const auto [words, status] = server.MatchDocument("+хвост кот"s, 0);
+    ASSERT_HINT(words.empty(), "Document without a required word must not match"s);
+
+    try {
+        server.FindTopDocuments("+-кот"s);
+        ASSERT_HINT(false, "Invalid required word must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // длинные списки документов: пересечение через galloping search
+    SearchServer big_server(""s);
+    for (int id = 0; id < 1000; ++id) {
+        string text = "a"s;
+        if (id % 2 == 0) {
+            text += " b"s;
+        }
+        if (id % 3 == 0) {
+            text += " c"s;
+        }
+        big_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    int found_count = 0;
+    for (const auto& document : big_server.FindTopDocuments("+b +c a"s, [&found_count](int, DocumentStatus, int) {
+        ++found_count;
+        return true;
+    })) {
+        ASSERT_EQUAL(document.id % 6, 0);
+    }
+    ASSERT_EQUAL_HINT(found_count, 167, "Intersection must contain exactly the multiples of 6"s);
+    const auto seq_result = big_server.FindTopDocuments(std::execution::seq, "+b +c"s);
+    const auto par_result = big_server.FindTopDocuments(std::execution::par, "+b +c"s);
+    ASSERT_EQUAL(seq_result.size(), par_result.size());
+    for (size_t i = 0; i < seq_result.size(); ++i) {
+        ASSERT_EQUAL(seq_result[i].id, par_result[i].id);
+    }
+}
+
+void TestMinusWordsExclusion() {
+    SearchServer server(""s);
+    for (int id = 0; id < 2000; ++id) {
+        string text = "a"s;
+        // плотное минус-слово (битовая карта)
+        if (id % 3 == 0) {
+            text += " dense"s;
+        }
+        // редкое минус-слово (упорядоченный массив)
+        if (id % 500 == 1) {
+            text += " sparse"s;
+        }
+        // минус-слово длиннее списка плюс-слова (проверка курсором без копирования)
+        if (id % 10 != 7) {
+            text += " common"s;
+        }
+        if (id % 100 == 7 || id % 100 == 8) {
+            text += " rare"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+
+    // исключенные документы не доходят даже до предиката
+    int checked_count = 0;
+    const auto dense_result = server.FindTopDocuments("a -dense -sparse"s, [&checked_count](int document_id, DocumentStatus, int) {
+        ASSERT_HINT(document_id % 3 != 0 && document_id % 500 != 1, "Excluded documents must not reach the predicate"s);
+        ++checked_count;
+        return true;
+    });
+    ASSERT_EQUAL(checked_count, 2000 - 667 - 3);
+    ASSERT_EQUAL(dense_result.size(), MAX_RESULT_DOCUMENT_COUNT);
+
+    const auto lazy_result = server.FindTopDocuments("rare -common"s);
+    ASSERT_EQUAL(lazy_result.size(), MAX_RESULT_DOCUMENT_COUNT);
+    for (const auto& document : lazy_result) {
+        ASSERT_EQUAL(document.id % 100, 7);
+    }
+
+    for (const string& query : {"a -dense -sparse"s, "rare -common -dense"s, "+rare a -common"s}) {
+        const auto seq_result = server.FindTopDocuments(std::execution::seq, query);
+        const auto par_result = server.FindTopDocuments(std::execution::par, query);
+        ASSERT_EQUAL(seq_result.size(), par_result.size());
+        for (size_t i = 0; i < seq_result.size(); ++i) {
+            ASSERT_EQUAL(seq_result[i].id, par_result[i].id);
+        }
+    }
+}
+
+void TestSearchAfterPagination() {
+    SearchServer server(""s);
+    for (int id = 0; id < 100; ++id) {
+        // много документов с одинаковой релевантностью и рейтингом: порядок между ними задает id
+        string text = "a"s;
+        for (int i = 0; i < id % 4; ++i) {
+            text += " b"s;
+        }
+        server.AddDocument(id * 3, text, DocumentStatus::ACTUAL, {id % 5});
+    }
+    server.AddDocument(1000, "c"s, DocumentStatus::ACTUAL, {1});
+
+    const DocumentPage whole_page = server.FindTopDocuments("a b"s, SearchCursor(), 1000);
+    ASSERT_EQUAL(whole_page.documents.size(), 100);
+    for (size_t i = 1; i < whole_page.documents.size(); ++i) {
+        ASSERT_HINT(IsRankedBefore(whole_page.documents[i - 1], whole_page.documents[i]), "Page must be sorted"s);
+    }
+    // первая страница совпадает с обычной выдачей
+    const auto top_documents = server.FindTopDocuments("a b"s);
+    for (size_t i = 0; i < top_documents.size(); ++i) {
+        ASSERT_EQUAL(top_documents[i].relevance, whole_page.documents[i].relevance);
+        ASSERT_EQUAL(top_documents[i].rating, whole_page.documents[i].rating);
+    }
+
+    for (const size_t page_size : {1, 7, 100}) {
+        vector<int> seq_ids;
+        vector<int> par_ids;
+        SearchCursor seq_cursor;
+        SearchCursor par_cursor;
+        while (true) {
+            const DocumentPage seq_page = server.FindTopDocuments("a b"s, seq_cursor, page_size);
+            const DocumentPage par_page = server.FindTopDocuments(std::execution::par, "a b"s, par_cursor, page_size);
+            ASSERT(seq_page.documents.size() <= page_size);
+            ASSERT_EQUAL(seq_page.documents.size(), par_page.documents.size());
+            if (seq_page.documents.empty()) {
+                break;
+            }
+            for (size_t i = 0; i < seq_page.documents.size(); ++i) {
+                seq_ids.push_back(seq_page.documents[i].id);
+                par_ids.push_back(par_page.documents[i].id);
+            }
+            seq_cursor = seq_page.next_cursor;
+            par_cursor = par_page.next_cursor;
+        }
+        ASSERT_EQUAL(seq_ids.size(), 100);
+        ASSERT(seq_ids == par_ids);
+        for (size_t i = 0; i < seq_ids.size(); ++i) {
+            ASSERT_EQUAL_HINT(seq_ids[i], whole_page.documents[i].id, "Pages must neither overlap nor skip documents"s);
+        }
+    }
+
+    ASSERT(server.FindTopDocuments("a b"s, SearchCursor(), 10, DocumentStatus::BANNED).documents.empty());
+    try {
+        server.FindTopDocuments("a"s, SearchCursor(), 0);
+        ASSERT_HINT(false, "Zero page size must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestMatchDocumentsBatch() {
+    SearchServer server("and"s);
+    // больше 64 слов в запросе и больше одной части набора при параллельной обработке
+    vector<string> words;
+    for (int i = 0; i < 80; ++i) {
+        words.push_back("w"s + to_string(i));
+    }
+    for (int id = 0; id < 3000; ++id) {
+        string text = "and"s;
+        for (int i = 0; i < 80; ++i) {
+            if ((id + i) % (i % 7 + 2) == 0) {
+                text += " "s + words[i];
+            }
+        }
+        server.AddDocument(id * 2, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id});
+    }
+    string wide_query;
+    for (const string& word : words) {
+        wide_query += word + " "s;
+    }
+    wide_query += "missing"s;
+
+    vector<int> document_ids(server.begin(), server.end());
+    // порядок и повторы id в наборе сохраняются в результате
+    reverse(document_ids.begin(), document_ids.end());
+    document_ids.push_back(document_ids.front());
+
+    for (const string& query : {wide_query, "w1 w2 -w3"s, "+w5 w6 w7 and"s, "+missing w1"s}) {
+        const auto seq_result = server.MatchDocuments(std::execution::seq, query, document_ids);
+        const auto par_result = server.MatchDocuments(std::execution::par, query, document_ids);
+        ASSERT_EQUAL(seq_result.document_ids.size(), document_ids.size());
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto [words, status] = server.MatchDocument(query, document_ids[i]);
+            const auto [par_words, par_status] = server.MatchDocument(std::execution::par, query, document_ids[i]);
+            ASSERT(words == par_words);
+            ASSERT_HINT(seq_result.GetMatchedWords(i) == words, "Batch matching must agree with MatchDocument"s);
+            ASSERT(par_result.GetMatchedWords(i) == words);
+            ASSERT(seq_result.statuses[i] == status);
+            ASSERT(par_result.statuses[i] == status);
+        }
+    }
+    const auto wide_result = server.MatchDocuments(wide_query, {0});
+    ASSERT_EQUAL(wide_result.words.size(), 80);
+    ASSERT_EQUAL(wide_result.blocks_per_document, 2);
+    ASSERT(wide_result.HasWord(0, 0));
+
+    try {
+        server.MatchDocuments("w1"s, {1});
+        ASSERT_HINT(false, "Unknown document id must be rejected"s);
+    } catch (const out_of_range&) {
+    }
+}
+
+void TestTombstoneRemoval() {
+    vector<string> texts;
+    for (int id = 0; id < 200; ++id) {
+        string text = "w"s + to_string(id % 7);
+        for (int i = 2; i < 20; i += 3) {
+            if (id % i == 0) {
+                text += " x"s + to_string(i);
+            }
+        }
+        texts.push_back(text + " only"s + to_string(id));
+    }
+    SearchServer server(""s);
+    for (int id = 0; id < 200; ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 10});
+    }
+    const vector<string> queries = {"w1 x2 x5"s, "x8 x11 -w3"s, "+x2 x14"s, "only5 only7 w0"s};
+
+    // результаты и IDF должны совпадать с сервером, в который удаленные документы не добавлялись
+    const auto check_equal_to_rebuilt = [&](const SearchServer& server, const set<int>& removed_ids) {
+        SearchServer rebuilt(""s);
+        for (int id = 0; id < 200; ++id) {
+            if (removed_ids.count(id) == 0) {
+                rebuilt.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 10});
+            }
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), rebuilt.GetDocumentCount());
+        for (const string& query : queries) {
+            for (const bool bm25 : {false, true}) {
+                const auto documents = bm25
+                    ? server.FindTopDocuments<Bm25Scorer>(query, SearchCursor(), 1000).documents
+                    : server.FindTopDocuments(std::execution::par, query, SearchCursor(), 1000).documents;
+                const auto expected = bm25
+                    ? rebuilt.FindTopDocuments<Bm25Scorer>(query, SearchCursor(), 1000).documents
+                    : rebuilt.FindTopDocuments(query, SearchCursor(), 1000).documents;
+                ASSERT_EQUAL(documents.size(), expected.size());
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    ASSERT_EQUAL(documents[i].id, expected[i].id);
+                    ASSERT_HINT(abs(documents[i].relevance - expected[i].relevance) < EPSILON, "IDF must not count removed documents"s);
+                }
+            }
+        }
+    };
+
+    // меньше порога: документы только отмечены удаленными
+    set<int> removed_ids = {0, 5, 7, 10, 42, 199};
+    for (const int id : removed_ids) {
+        server.RemoveDocument(id);
+    }
+    check_equal_to_rebuilt(server, removed_ids);
+    ASSERT(server.FindTopDocuments("only5"s).empty());
+    ASSERT(server.GetWordFrequencies(5).empty());
+
+    // пакетное удаление выше порога запускает уплотнение
+    vector<int> batch;
+    for (int id = 1; id < 200; id += 3) {
+        batch.push_back(id);
+        removed_ids.insert(id);
+    }
+    batch.push_back(1000);
+    server.RemoveDocuments(std::execution::par, batch);
+    check_equal_to_rebuilt(server, removed_ids);
+    vector<int> expected_ids;
+    for (int id = 0; id < 200; ++id) {
+        if (removed_ids.count(id) == 0) {
+            expected_ids.push_back(id);
+        }
+    }
+    ASSERT(vector<int>(server.begin(), server.end()) == expected_ids);
+    ASSERT_EQUAL(server.GetWordFrequencies(3).size(), 2);
+
+    // после уплотнения документы можно добавлять заново, в том числе с прежними id
+    server.AddDocument(5, texts[5], DocumentStatus::ACTUAL, {5});
+    removed_ids.erase(5);
+    server.RemoveDocument(8);
+    removed_ids.insert(8);
+    server.Compact();
+    check_equal_to_rebuilt(server, removed_ids);
+    const auto matched = server.MatchDocuments("only5 w5"s, {5, 3});
+    ASSERT(matched.GetMatchedWords(0) == vector<string_view>({"only5"sv, "w5"sv}));
+    ASSERT(matched.GetMatchedWords(1).empty());
+
+    // параллельное уплотнение выделяет память из ресурса сервера только в вызывающем потоке,
+    // поэтому ресурс может быть непотокобезопасным
+    class ThreadCheckingResource : public std::pmr::memory_resource {
+    public:
+        thread::id owner = this_thread::get_id();
+        atomic<size_t> foreign_calls = 0;
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            Check();
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            Check();
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+        void Check() {
+            if (this_thread::get_id() != owner) {
+                ++foreign_calls;
+            }
+        }
+    };
+    ThreadCheckingResource resource;
+    {
+        SearchServer checked_server(""s, &resource);
+        for (int id = 0; id < 200; ++id) {
+            checked_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 10});
+        }
+        checked_server.RemoveDocuments(std::execution::par, batch);
+        ASSERT_EQUAL(checked_server.GetDocumentCount(), 200 - batch.size() + 1);
+    }
+    ASSERT_EQUAL(resource.foreign_calls.load(), 0);
+}
+
+void TestUpdateDocument() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+
+    server.UpdateDocumentMetadata(1, DocumentStatus::BANNED, {10});
+    ASSERT_EQUAL(server.FindTopDocuments("пушистый кот"s).size(), 1);
+    const auto banned_result = server.FindTopDocuments("пушистый кот"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned_result.size(), 1);
+    ASSERT_EQUAL(banned_result[0].id, 1);
+    ASSERT_EQUAL(banned_result[0].rating, 10);
+    ASSERT(get<1>(server.MatchDocument("кот"s, 1)) == DocumentStatus::BANNED);
+
+    // слово "ошейник" пропадает из словаря, "пёс" появляется во втором документе, "кот" меняет частоту
+    server.UpdateDocument(0, "белый кот и белый пёс"s);
+    SearchServer rebuilt("и в на"s);
+    rebuilt.AddDocument(0, "белый кот и белый пёс"s, DocumentStatus::ACTUAL, {8, -3});
+    rebuilt.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::BANNED, {10});
+    rebuilt.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    for (const string& query : {"белый пёс"s, "кот -хвост"s, "ошейник"s, "+пёс глаза"s}) {
+        const auto result = server.FindTopDocuments(query, SearchCursor(), 10, [](int, DocumentStatus, int) { return true; });
+        const auto expected = rebuilt.FindTopDocuments(query, SearchCursor(), 10, [](int, DocumentStatus, int) { return true; });
+        ASSERT_EQUAL(result.documents.size(), expected.documents.size());
+        for (size_t i = 0; i < result.documents.size(); ++i) {
+            ASSERT_EQUAL(result.documents[i].id, expected.documents[i].id);
+            ASSERT_EQUAL_HINT(result.documents[i].relevance, expected.documents[i].relevance, "Updated document must be scored as a freshly added one"s);
+        }
+    }
+    ASSERT(server.FindTopDocuments("ошейник"s).empty());
+    const auto& word_freqs = server.GetWordFrequencies(0);
+    ASSERT_EQUAL(word_freqs.size(), 3);
+    ASSERT_EQUAL(word_freqs.at("белый"s), 0.5);
+    ASSERT(get<0>(server.MatchDocument("ошейник пёс"s, 0)) == vector<string_view>({"пёс"sv}));
+
+    // некорректный текст не меняет документ
+    try {
+        server.UpdateDocument(0, "белый \x12кот"s);
+        ASSERT_HINT(false, "Invalid text must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetWordFrequencies(0).size(), 3);
+    try {
+        server.UpdateDocumentMetadata(5, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "Unknown document must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestQueryProtocol() {
+    SearchServer server("и в на"s);
+    QueryProtocol protocol(server);
+    ASSERT_EQUAL(protocol.Execute("ADD 1 ACTUAL 8,-3 белый кот и модный ошейник"s), "OK"s);
+    ASSERT_EQUAL(protocol.Execute("ADD 2 BANNED - пушистый кот пушистый хвост"s), "OK"s);
+    ASSERT_EQUAL(protocol.Execute("COUNT"s), "OK 2"s);
+    ASSERT_EQUAL(protocol.Execute("SEARCH кот"s), "OK 1 1 0 2"s);
+    ASSERT_EQUAL(protocol.Execute("MATCH 2 пушистый -ошейник"s), "OK BANNED пушистый"s);
+    ASSERT_EQUAL(protocol.Execute("MATCH 1 пушистый -ошейник"s), "OK ACTUAL"s);
+    ASSERT_EQUAL(protocol.Execute("REMOVE 1"s), "OK"s);
+    ASSERT_EQUAL(protocol.Execute("SEARCH кот"s), "OK 0"s);
+    ASSERT_EQUAL(protocol.Execute("COUNT"s), "OK 1"s);
+
+    // ошибки разбора и ошибки сервера возвращаются клиенту, а не прерывают обработку
+    for (const string& request : {"UNKNOWN"s, "ADD x ACTUAL 1 кот"s, "ADD 3 NEW 1 кот"s, "ADD 2 ACTUAL 1 кот"s,
+                                  "REMOVE"s, "MATCH 7 кот"s, "SEARCH кот -"s}) {
+        ASSERT_HINT(protocol.Execute(request).rfind("ERR "s, 0) == 0, request);
+    }
+    ASSERT_EQUAL(protocol.Execute("COUNT"s), "OK 1"s);
+    // неизвестный документ -- ошибка протокола, а не сообщение контейнера
+    ASSERT_EQUAL(protocol.Execute("MATCH 7 кот"s), "ERR Unknown document id"s);
+    ASSERT_EQUAL(protocol.Execute("MATCH 1 кот"s), "ERR Unknown document id"s);
+
+    ASSERT(QueryProtocol::IsWriteRequest("ADD 1 ACTUAL - кот"sv));
+    ASSERT(QueryProtocol::IsWriteRequest("REMOVE 1"sv));
+    ASSERT(!QueryProtocol::IsWriteRequest("SEARCH ADD"sv));
+    ASSERT(!QueryProtocol::IsWriteRequest("COUNT"sv));
+}
+
+void TestCorpusLoader() {
+    const vector<string> texts = {"белый кот и модный ошейник"s, "пушистый кот пушистый хвост"s,
+                                  "ухоженный пёс выразительные глаза"s, "ухоженный скворец евгений"s};
+    SearchServer expected("и в на"s);
+    expected.AddDocument(3, texts[0], DocumentStatus::ACTUAL, {8, -3});
+    expected.AddDocument(1, texts[1], DocumentStatus::BANNED, {});
+    expected.AddDocument(7, texts[2], DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    expected.AddDocument(2, texts[3], DocumentStatus::IRRELEVANT, {9});
+    const auto check_equal_to_expected = [&](const SearchServer& server) {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+        for (const int document_id : expected) {
+            ASSERT(server.GetWordFrequencies(document_id) == expected.GetWordFrequencies(document_id));
+        }
+        for (const string& query : {"кот"s, "ухоженный пёс"s, "пушистый -хвост"s}) {
+            const auto result = server.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; });
+            const auto expected_result = expected.FindTopDocuments(query, [](int, DocumentStatus, int) { return true; });
+            ASSERT_EQUAL(result.size(), expected_result.size());
+            for (size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL(result[i].id, expected_result[i].id);
+                ASSERT_EQUAL(result[i].rating, expected_result[i].rating);
+                ASSERT_EQUAL(result[i].relevance, expected_result[i].relevance);
+            }
+            ASSERT(get<1>(server.MatchDocument(query, 1)) == DocumentStatus::BANNED);
+        }
+    };
+
+    // маленькие части и короткая очередь: строки распределяются между несколькими потоками разбора,
+    // а документы все равно добавляются в порядке следования в корпусе
+    CorpusLoadOptions options;
+    options.parser_count = 3;
+    options.chunk_size = 16;
+    options.max_queued_chunks = 2;
+    const string tsv = "3\tACTUAL\t8,-3\t"s + texts[0] + "\r\n1\tBANNED\t\t"s + texts[1] + "\n\n7\tACTUAL\t5,-12,2,1\t"s
+        + texts[2] + "\n2\tIRRELEVANT\t9\t"s + texts[3];
+    {
+        SearchServer server("и в на"s);
+        const CorpusLoadStats stats = LoadCorpus(server, tsv, options);
+        ASSERT_EQUAL(stats.document_count, 4);
+        ASSERT_EQUAL(stats.byte_count, tsv.size());
+        check_equal_to_expected(server);
+    }
+
+    // escape-последовательности JSON раскрываются, неизвестные поля пропускаются
+    const string jsonl = R"({"id": 3, "ratings": [8, -3], "text": "белый кот и модный ошейник"}
+{"text": "пушистый \u043a\u043e\u0442 пушистый хвост", "status": "BANNED", "id": 1, "source": {"tags": ["a", 1]}}
+{ "id" : 7 , "status" : "ACTUAL" , "ratings" : [5,-12,2,1] , "text" : "ухоженный пёс выразительные глаза" }
+{"id": 2, "status": "IRRELEVANT", "ratings": [9], "text": "ухоженный скворец евгений", "draft": false}
+)"s;
+    options.format = CorpusFormat::JSONL;
+    {
+        SearchServer server("и в на"s);
+        ASSERT_EQUAL(LoadCorpus(server, jsonl, options).document_count, 4);
+        check_equal_to_expected(server);
+    }
+
+    // ошибка сообщает номер строки, документы до нее остаются добавленными -- и когда строки в разных частях,
+    // и когда ошибочная строка в одной части с ними (размер части по умолчанию)
+    options.format = CorpusFormat::TSV;
+    for (const CorpusLoadOptions& error_options : {options, CorpusLoadOptions{}}) {
+        for (const string& corpus : {"3\tACTUAL\t1\tкот\n1\tACTUAL\t1\tпёс\n\n5\tACTUAL\t1\n"s,
+                                     "3\tACTUAL\t1\tкот\n1\tACTUAL\t1\tпёс\n\n3\tACTUAL\t1\tскворец\n"s,
+                                     "3\tACTUAL\t1\tкот\n1\tACTUAL\t1\tпёс\n\n5\tNEW\t1\tскворец\n"s}) {
+            SearchServer server("и в на"s);
+            try {
+                LoadCorpus(server, corpus, error_options);
+                ASSERT_HINT(false, "Invalid corpus must be rejected"s);
+            } catch (const invalid_argument& e) {
+                ASSERT_HINT(string(e.what()).find("line 4"s) != string::npos, e.what());
+            }
+            ASSERT_EQUAL(server.GetDocumentCount(), 2);
+            ASSERT_EQUAL(get<0>(server.MatchDocument("кот"s, 3)).size(), 1);
+            ASSERT_EQUAL(get<0>(server.MatchDocument("пёс"s, 1)).size(), 1);
+        }
+    }
+
+    const string path = (filesystem::temp_directory_path() / "search_server_test_corpus.jsonl"s).string();
+    {
+        ofstream file(path, ios::binary);
+        file << jsonl;
+    }
+    ASSERT(GetCorpusFormat(path) == CorpusFormat::JSONL);
+    ASSERT(GetCorpusFormat("corpus.tsv"s) == CorpusFormat::TSV);
+    SearchServer server("и в на"s);
+    const CorpusLoadStats stats = LoadCorpusFile(server, path, 2);
+    remove(path.c_str());
+    ASSERT_EQUAL(stats.byte_count, jsonl.size());
+    check_equal_to_expected(server);
+}
+
+void TestStopWordSet() {
+    // таблица для списка, известного при компиляции, строится компилятором
+    constexpr auto static_stop_words = MakeStopWordSet("и"sv, "в"sv, "на"sv, "с"sv);
+    static_assert(static_stop_words.Contains("на"sv));
+    static_assert(!static_stop_words.Contains("над"sv));
+    static_assert(!static_stop_words.Contains(""sv));
+    constexpr auto no_stop_words = MakeStopWordSet();
+    static_assert(!no_stop_words.Contains("и"sv));
+
+    SearchServer server(static_stop_words);
+    server.AddDocument(0, "кот на окне и с бантом"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.GetWordFrequencies(0).size(), 3);
+    ASSERT(server.FindTopDocuments("на"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("кот на"s).size(), 1);
+
+    // повторы и пустые слова отбрасываются
+    const StopWordSet runtime_stop_words(vector<string>{"и"s, ""s, "в"s, "и"s});
+    ASSERT_EQUAL(runtime_stop_words.size(), 2);
+    ASSERT(runtime_stop_words.Contains("и"sv) && runtime_stop_words.Contains("в"sv));
+    ASSERT(!runtime_stop_words.Contains(""sv) && !runtime_stop_words.Contains("на"sv));
+    ASSERT(!StopWordSet().Contains("и"sv));
+
+    // в большом списке находятся все слова и только они
+    vector<string> words;
+    for (int i = 0; i < 5000; ++i) {
+        words.push_back("w"s + to_string(i));
+    }
+    const StopWordSet many_stop_words(words);
+    ASSERT_EQUAL(many_stop_words.size(), words.size());
+    for (const string& word : words) {
+        ASSERT_HINT(many_stop_words.Contains(word), word);
+        ASSERT_HINT(!many_stop_words.Contains(word + "x"s), word);
+    }
+    const StopWordSet copied_stop_words(static_stop_words);
+    for (const string_view word : static_stop_words) {
+        ASSERT(copied_stop_words.Contains(word));
+    }
+    ASSERT(!copied_stop_words.Contains("над"sv));
+}
+
+void TestQueryPlanner() {
+    // "кот" есть почти во всех документах, остальные слова -- в немногих
+    SearchServer server("и"s);
+    for (int id = 0; id < 300; ++id) {
+        string text = id % 50 == 0 ? "пес"s : "кот"s;
+        for (int i = 0; i < id % 7; ++i) {
+            text += " кот"s;
+        }
+        if (id % 3 == 0) {
+            text += " пушистый"s;
+        }
+        if (id % 11 == 0) {
+            text += " скворец скворец"s;
+        }
+        if (id % 13 == 0) {
+            text += " ошейник"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 5});
+    }
+    server.RemoveDocument(33);
+
+    const vector<string> queries = {"кот скворец"s, "кот пушистый скворец ошейник"s, "кот пушистый -ошейник"s, "пес кот"s, "скворец"s, "кот"s};
+    const auto find_all = [&server](const string& query) {
+        vector<pair<double, int>> results;
+        for (const Document& document : server.FindTopDocuments(query)) {
+            results.emplace_back(document.relevance, document.rating);
+        }
+        for (const Document& document : server.FindTopDocuments<Bm25Scorer>(query)) {
+            results.emplace_back(document.relevance, document.rating);
+        }
+        for (const Document& document : server.FindTopDocuments(query, SearchCursor(), 1000).documents) {
+            results.emplace_back(document.relevance, document.id);
+        }
+        return results;
+    };
+    vector<vector<pair<double, int>>> expected;
+    for (const string& query : queries) {
+        expected.push_back(find_all(query));
+    }
+    // выдача не зависит от стратегии; документы, чья релевантность отличается меньше чем на EPSILON,
+    // равноценны, и при равном рейтинге любой из них может оказаться в выдаче
+    const auto is_same_ranking = [](const vector<pair<double, int>>& lhs, const vector<pair<double, int>>& rhs) {
+        return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const pair<double, int>& lhs, const pair<double, int>& rhs) {
+            return abs(lhs.first - rhs.first) < EPSILON && lhs.second == rhs.second;
+        });
+    };
+    for (const QueryStrategy strategy : {QueryStrategy::TERM_AT_A_TIME, QueryStrategy::DOCUMENT_AT_A_TIME, QueryStrategy::MAX_SCORE, QueryStrategy::BLOCK_MAX_WAND}) {
+        server.SetQueryStrategy(strategy);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT_HINT(is_same_ranking(find_all(queries[i]), expected[i]), string(GetQueryStrategyName(strategy)) + ": "s + queries[i]);
+        }
+    }
+
+    // частое слово откладывается и не порождает кандидатов
+    const QueryPlannerMetrics before = server.GetQueryPlannerMetrics();
+    server.SetQueryStrategy(QueryStrategy::MAX_SCORE);
+    ASSERT_EQUAL(server.FindTopDocuments("кот скворец"s).size(), MAX_RESULT_DOCUMENT_COUNT);
+    const QueryPlannerMetrics after = server.GetQueryPlannerMetrics();
+    ASSERT_EQUAL(after.max_score_queries - before.max_score_queries, 1);
+    ASSERT_EQUAL(after.deferred_terms - before.deferred_terms, 1);
+    ASSERT(after.pruned_documents + after.scored_documents - before.pruned_documents - before.scored_documents < 250);
+
+    const QueryPlan plan = server.PlanQuery("кот скворец пингвин"s);
+    ASSERT(plan.strategy == QueryStrategy::MAX_SCORE);
+    ASSERT_EQUAL(plan.terms.size(), 2);
+    ASSERT_EQUAL(plan.terms[0].word, "кот"sv);
+    ASSERT(plan.terms[0].max_score < plan.terms[1].max_score);
+    ASSERT_EQUAL(plan.expected_deferred_count, 1);
+    ASSERT(server.PlanQuery("кот скворец"s, 0).strategy == QueryStrategy::DOCUMENT_AT_A_TIME);
+    ASSERT(server.PlanQuery("+кот скворец"s).strategy == QueryStrategy::CONJUNCTIVE);
+
+    // по пределам блоков пропускаются целые блоки: после первых документов со словом "кот" ни один
+    // из следующих уже не войдет в выдачу
+    {
+        SearchServer blocks_server(""s);
+        for (int id = 0; id < 20 * static_cast<int>(SCORE_BLOCK_SIZE); ++id) {
+            blocks_server.AddDocument(id, id < 10 ? "кот"s : "кот пес пес пес"s, DocumentStatus::ACTUAL, {1});
+        }
+        blocks_server.AddDocument(10000, "пес"s, DocumentStatus::ACTUAL, {1});
+        const auto documents = blocks_server.FindTopDocuments("кот"s);
+        ASSERT_EQUAL(documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        ASSERT(documents.back().id < 10);
+        const QueryPlannerMetrics metrics = blocks_server.GetQueryPlannerMetrics();
+        ASSERT_EQUAL(metrics.block_max_wand_queries, 1);
+        ASSERT(metrics.skipped_blocks > 0);
+        ASSERT(metrics.scanned_postings < 2 * SCORE_BLOCK_SIZE);
+
+        // пределы блоков обновляются вместе с документами
+        blocks_server.UpdateDocument(1000, "кот"s);
+        blocks_server.UpdateDocumentMetadata(1000, DocumentStatus::ACTUAL, {5});
+        blocks_server.UpdateDocument(10000, "кот"s);
+        blocks_server.UpdateDocumentMetadata(10000, DocumentStatus::ACTUAL, {4});
+        const auto updated_documents = blocks_server.FindTopDocuments("кот"s);
+        ASSERT_EQUAL(updated_documents[0].id, 1000);
+        ASSERT_EQUAL(updated_documents[1].id, 10000);
+    }
+
+    // показатели запросов из разных потоков складываются, а копия сервера получает накопленные значения
+    {
+        const QueryPlannerMetrics before_threads = server.GetQueryPlannerMetrics();
+        const uint64_t thread_count = 4;
+        const uint64_t queries_per_thread = 50;
+        vector<thread> threads;
+        for (uint64_t i = 0; i < thread_count; ++i) {
+            threads.emplace_back([&server] {
+                for (uint64_t query = 0; query < queries_per_thread; ++query) {
+                    server.FindTopDocuments("кот скворец"s);
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        const QueryPlannerMetrics after_threads = server.GetQueryPlannerMetrics();
+        ASSERT_EQUAL(after_threads.max_score_queries - before_threads.max_score_queries, thread_count * queries_per_thread);
+        ASSERT_EQUAL(after_threads.deferred_terms - before_threads.deferred_terms, thread_count * queries_per_thread);
+        const SearchServer copy = server;
+        ASSERT_EQUAL(copy.GetQueryPlannerMetrics().max_score_queries, after_threads.max_score_queries);
+        ASSERT_EQUAL(copy.GetQueryPlannerMetrics().scored_documents, after_threads.scored_documents);
+    }
+
+    // без принудительной стратегии выбирается более дешевая
+    server.SetQueryStrategy(nullopt);
+    ASSERT(server.PlanQuery("кот"s).strategy == QueryStrategy::BLOCK_MAX_WAND);
+    const QueryPlan auto_plan = server.PlanQuery("кот пушистый"s, 0);
+    ASSERT(auto_plan.strategy == (auto_plan.term_at_a_time_cost < auto_plan.document_at_a_time_cost
+        ? QueryStrategy::TERM_AT_A_TIME : QueryStrategy::DOCUMENT_AT_A_TIME));
+
+    try {
+        server.SetQueryStrategy(QueryStrategy::CONJUNCTIVE);
+        ASSERT_HINT(false, "conjunctive strategy can't be forced"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestImpactOrdering() {
+    SearchServer server(""s);
+    server.SetImpactOrdering(100);
+    int next_id = 0;
+    const auto add_document = [&server, &next_id](int word_count, int rating) {
+        string text = "кот"s;
+        for (int i = 0; i < word_count; ++i) {
+            text += " слово"s + to_string(i);
+        }
+        server.AddDocument(next_id, text, next_id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {rating});
+        ++next_id;
+    };
+    for (int i = 0; i < 500; ++i) {
+        add_document(1 + (i * 37) % 29, i % 7);
+    }
+    server.AddDocument(next_id++, "пес"s, DocumentStatus::ACTUAL, {1});
+
+    const auto find = [&server](const string& query, optional<QueryStrategy> strategy) {
+        server.SetQueryStrategy(strategy);
+        vector<pair<double, int>> result;
+        for (const Document& document : server.FindTopDocuments(query)) {
+            result.emplace_back(document.relevance, document.rating);
+        }
+        for (const Document& document : server.FindTopDocuments<Bm25Scorer>(query, DocumentStatus::BANNED)) {
+            result.emplace_back(document.relevance, document.rating);
+        }
+        server.SetQueryStrategy(nullopt);
+        return result;
+    };
+    // документы с равной релевантностью и рейтингом равноценны, поэтому сравниваются только они
+    const auto check = [&find](const string& hint) {
+        for (const string& query : {"кот"s, "кот -слово3"s, "слово5"s}) {
+            const auto expected = find(query, QueryStrategy::TERM_AT_A_TIME);
+            const auto result = find(query, QueryStrategy::IMPACT_ORDERED);
+            ASSERT_HINT(equal(result.begin(), result.end(), expected.begin(), expected.end(), [](const pair<double, int>& lhs, const pair<double, int>& rhs) {
+                return abs(lhs.first - rhs.first) < EPSILON && lhs.second == rhs.second;
+            }), hint + ": "s + query);
+        }
+    };
+
+    ASSERT(server.PlanQuery("кот"s).strategy == QueryStrategy::IMPACT_ORDERED);
+    ASSERT(server.PlanQuery("кот"s, 0).strategy != QueryStrategy::IMPACT_ORDERED);
+    ASSERT(server.PlanQuery("кот слово1"s).strategy != QueryStrategy::IMPACT_ORDERED);
+    const QueryPlannerMetrics before = server.GetQueryPlannerMetrics();
+    const auto documents = server.FindTopDocuments("кот"s);
+    ASSERT_EQUAL(documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    const QueryPlannerMetrics after = server.GetQueryPlannerMetrics();
+    ASSERT_EQUAL(after.impact_ordered_queries - before.impact_ordered_queries, 1);
+    ASSERT(after.scanned_postings - before.scanned_postings <= IMPACT_TABLE_SIZE);
+    check("added"s);
+
+    // таблица поддерживается при изменении документов
+    for (int i = 0; i < 100; ++i) {
+        add_document(i % 3, 9);
+    }
+    check("added more"s);
+    for (int id = 0; id < next_id; id += 3) {
+        server.RemoveDocument(id);
+    }
+    check("removed"s);
+    for (int id = 1; id < next_id; id += 3) {
+        server.UpdateDocument(id, id % 2 == 0 ? "кот"s : "пес слово5"s);
+    }
+    check("updated"s);
+    server.Compact();
+    check("compacted"s);
+
+    server.SetImpactOrdering(0);
+    ASSERT(server.PlanQuery("кот"s).strategy == QueryStrategy::BLOCK_MAX_WAND);
+}
+
+void TestTermFreqPrecision() {
+    // погрешность 8-битной шкалы не больше половины шага, 2^(1/32)
+    const double max_ratio = exp2(1.0 / 32) + 1e-12;
+    for (double term_freq = 1.0; term_freq > 1e-4; term_freq *= 0.937) {
+        const double decoded = DecodeTermFreq(term_freq_detail::QuantizeTermFreq(term_freq));
+        ASSERT_HINT(decoded / term_freq <= max_ratio && term_freq / decoded <= max_ratio, to_string(term_freq));
+    }
+
+    SearchServer server(""s);
+    int next_id = 0;
+    const auto add_document = [&server, &next_id](int word_count, int rating) {
+        string text = "кот"s;
+        for (int i = 0; i < word_count; ++i) {
+            text += i % 4 == 0 ? " кот"s : " слово"s + to_string(i % 13);
+        }
+        server.AddDocument(next_id++, text, DocumentStatus::ACTUAL, {rating});
+    };
+    for (int i = 0; i < 300; ++i) {
+        add_document(1 + (i * 37) % 41, i % 5);
+    }
+    const SearchServer exact_server(server);
+    ASSERT(server.GetTermFreqPrecision() == TermFreqPrecision::DOUBLE);
+
+    // "кот" есть во всех документах, его IDF равен нулю
+    const vector<string> queries = {"слово3"s, "слово1 слово2"s, "кот слово5 -слово7"s};
+    // релевантность каждого найденного документа отличается от точной не больше чем в max_error раз
+    const auto check = [&server, &queries](const SearchServer& exact, double max_error, const string& hint) {
+        for (const string& query : queries) {
+            const auto documents = server.FindTopDocuments(query);
+            ASSERT_EQUAL_HINT(documents.size(), MAX_RESULT_DOCUMENT_COUNT, hint + ": "s + query);
+            for (const Document& document : documents) {
+                const auto exact_documents = exact.FindTopDocuments(query, [&document](int document_id, DocumentStatus, int) {
+                    return document_id == document.id;
+                });
+                ASSERT_EQUAL_HINT(exact_documents.size(), 1u, hint + ": "s + query);
+                const double ratio = document.relevance / exact_documents[0].relevance;
+                ASSERT_HINT(ratio <= max_error && 1.0 / ratio <= max_error, hint + ": "s + query);
+            }
+            // все стратегии ранжируют по одним и тем же хранимым частотам
+            vector<pair<double, int>> expected;
+            for (const QueryStrategy strategy : {QueryStrategy::TERM_AT_A_TIME, QueryStrategy::MAX_SCORE, QueryStrategy::BLOCK_MAX_WAND}) {
+                server.SetQueryStrategy(strategy);
+                vector<pair<double, int>> result;
+                for (const Document& document : server.FindTopDocuments(query)) {
+                    result.emplace_back(document.relevance, document.rating);
+                }
+                if (expected.empty()) {
+                    expected = result;
+                }
+                ASSERT_HINT(equal(result.begin(), result.end(), expected.begin(), expected.end(), [](const pair<double, int>& lhs, const pair<double, int>& rhs) {
+                    return abs(lhs.first - rhs.first) < EPSILON && lhs.second == rhs.second;
+                }), hint + ": "s + query);
+            }
+            server.SetQueryStrategy(nullopt);
+        }
+    };
+
+    server.SetTermFreqPrecision(TermFreqPrecision::FLOAT);
+    ASSERT_EQUAL(server.GetTermFreqMemoryUsage() * 2, SearchServer(exact_server).GetTermFreqMemoryUsage());
+    check(exact_server, 1.0 + 1e-6, "float"s);
+    server.SetTermFreqPrecision(TermFreqPrecision::QUANTIZED_8);
+    ASSERT_EQUAL(server.GetTermFreqMemoryUsage() * 8, SearchServer(exact_server).GetTermFreqMemoryUsage());
+    check(exact_server, max_ratio, "quantized"s);
+
+    // документы, добавленные и измененные при сжатых частотах, после возврата к DOUBLE оцениваются точно
+    SearchServer updated_server(exact_server);
+    for (int i = 0; i < 50; ++i) {
+        const string text = "кот слово"s + to_string(i % 13) + " слово1"s;
+        server.AddDocument(next_id, text, DocumentStatus::ACTUAL, {i % 5});
+        updated_server.AddDocument(next_id, text, DocumentStatus::ACTUAL, {i % 5});
+        server.UpdateDocument(i * 3, "слово2 кот слово2"s);
+        updated_server.UpdateDocument(i * 3, "слово2 кот слово2"s);
+        ++next_id;
+    }
+    check(updated_server, max_ratio, "quantized updated"s);
+    server.SetTermFreqPrecision(TermFreqPrecision::DOUBLE);
+    for (const string& query : queries) {
+        const auto documents = server.FindTopDocuments(query);
+        const auto exact_documents = updated_server.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(documents.size(), exact_documents.size(), query);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL_HINT(documents[i].relevance, exact_documents[i].relevance, query);
+        }
+    }
+}
+
+void TestRankingKey() {
+    // релевантность округляется до шага EPSILON, затем документы упорядочиваются по рейтингу и id
+    ASSERT(MakeRankingKey(Document(1, 0.5, 1)) < MakeRankingKey(Document(0, 0.4, 9)));
+    ASSERT(MakeRankingKey(Document(1, 0.5, 2)) < MakeRankingKey(Document(0, 0.5 + EPSILON * 0.1, 1)));
+    ASSERT(MakeRankingKey(Document(0, 0.5, -3)) < MakeRankingKey(Document(1, 0.5, -3)));
+    ASSERT(MakeRankingKey(Document(5, 0.5, -3)) < MakeRankingKey(Document(1, 0.5, -4)));
+    ASSERT(!(MakeRankingKey(Document(1, 0.5, 1)) < MakeRankingKey(Document(1, 0.5, 1))));
+
+    // поразрядная сортировка больших наборов дает тот же порядок, что и сортировка сравнением
+    vector<Document> documents;
+    for (int i = 0; i < 3000; ++i) {
+        documents.emplace_back((i * 7919) % 3001, (i % 37) * 0.01 + (i % 3) * EPSILON * 0.2, i % 5 - 2);
+    }
+    vector<Document> expected = documents;
+    sort(expected.begin(), expected.end(), IsRankedBefore);
+    for (const size_t size : {size_t{10}, documents.size()}) {
+        vector<Document> sorted(documents.begin(), documents.begin() + size);
+        vector<Document> expected_sorted = sorted;
+        sort(expected_sorted.begin(), expected_sorted.end(), IsRankedBefore);
+        SortByRanking(sorted);
+        ASSERT_EQUAL(sorted.size(), size);
+        for (size_t i = 0; i < size; ++i) {
+            ASSERT_EQUAL_HINT(sorted[i].id, expected_sorted[i].id, "sort of "s + to_string(size));
+        }
+    }
+    vector<Document> top = documents;
+    SelectTopRanked(top, 7);
+    ASSERT_EQUAL(top.size(), 7u);
+    for (size_t i = 0; i < top.size(); ++i) {
+        ASSERT_EQUAL(top[i].id, expected[i].id);
+    }
+
+    // при равной релевантности и рейтинге выдача одинакова при любой политике и любой стратегии
+    SearchServer server(""s);
+    for (int id = 40; id > 0; --id) {
+        server.AddDocument(id * 3, id % 2 == 0 ? "белый кот"s : "белый пес"s, DocumentStatus::ACTUAL, {id % 3});
+    }
+    const auto expected_documents = server.FindTopDocuments(execution::seq, "белый кот"s);
+    ASSERT_EQUAL(expected_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    ASSERT_EQUAL(expected_documents[0].id, 6);
+    const auto check = [&server, &expected_documents](const vector<Document>& documents, const string& hint) {
+        ASSERT_EQUAL_HINT(documents.size(), expected_documents.size(), hint);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL_HINT(documents[i].id, expected_documents[i].id, hint);
+            ASSERT_EQUAL_HINT(documents[i].relevance, expected_documents[i].relevance, hint);
+        }
+    };
+    check(server.FindTopDocuments(execution::par, "белый кот"s), "par"s);
+    for (const QueryStrategy strategy : {QueryStrategy::TERM_AT_A_TIME, QueryStrategy::DOCUMENT_AT_A_TIME, QueryStrategy::MAX_SCORE, QueryStrategy::BLOCK_MAX_WAND}) {
+        server.SetQueryStrategy(strategy);
+        check(server.FindTopDocuments("белый кот"s), string(GetQueryStrategyName(strategy)));
+    }
+}
+
+void TestBatchQueries() {
+    SearchServer server("и в на"s);
+    // документов на несколько отрезков QUERY_BATCH_CHUNK_SIZE: на следующих отрезках у запросов уже есть порог,
+    // и частые слова становятся неосновными
+    for (int id = 0; id < 3000; ++id) {
+        string text = "w"s + to_string(id % 7);
+        for (int i = 2; i < 30; ++i) {
+            if (id % i == 0) {
+                text += " x"s + to_string(i);
+            }
+        }
+        text += id % 3 == 0 ? " и кот"s : " пес"s;
+        server.AddDocument(id, text, id % 50 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 10 - 3});
+    }
+    for (int id = 0; id < 3000; id += 17) {
+        server.RemoveDocument(id);
+    }
+
+    // больше QUERY_BATCH_SIZE запросов, чтобы они разбились на несколько групп; среди них запросы
+    // с минус-словами, обязательными словами, стоп-словами и словами, которых нет в индексе
+    vector<string> queries;
+    for (size_t i = 0; i < QUERY_BATCH_SIZE + 100; ++i) {
+        string query = "x"s + to_string(2 + i % 28) + " w"s + to_string(i % 7);
+        if (i % 5 == 0) {
+            query += " -x"s + to_string(2 + i % 3);
+        }
+        if (i % 11 == 0) {
+            query = "+кот "s + query;
+        }
+        if (i % 13 == 0) {
+            query += " и платипус"s;
+        }
+        queries.push_back(query);
+    }
+    queries.push_back("-кот пес"s);
+    queries.push_back("платипус"s);
+    // одно и то же слово на разных местах в разных запросах одной группы
+    queries.insert(queries.begin() + 1, {"w3 x4 x5"s, "x5 w3"s, "x4 x5 w3 пес"s});
+
+    // пакетное выполнение дает ту же выдачу, что и выполнение каждого запроса отдельно; релевантность -- в пределах
+    // EPSILON, потому что вклады слов складываются в другом порядке
+    const auto check = [&server, &queries](const vector<vector<Document>>& results, const auto& find, const string& hint) {
+        ASSERT_EQUAL_HINT(results.size(), queries.size(), hint);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const vector<Document> expected = find(queries[i]);
+            ASSERT_EQUAL_HINT(results[i].size(), expected.size(), hint + ": "s + queries[i]);
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL_HINT(results[i][j].id, expected[j].id, hint + ": "s + queries[i]);
+                ASSERT_HINT(abs(results[i][j].relevance - expected[j].relevance) < EPSILON, hint + ": "s + queries[i]);
+            }
+        }
+    };
+    const auto find = [&server](const string& query) {
+        return server.FindTopDocuments(query);
+    };
+    check(server.FindTopDocumentsBatch(queries), find, "seq"s);
+    check(ProcessQueriesBatched(server, queries), find, "par"s);
+    check(server.FindTopDocumentsBatch<Bm25Scorer>(execution::par, queries), [&server](const string& query) {
+        return server.FindTopDocuments<Bm25Scorer>(query);
+    }, "BM25"s);
+    server.SetTermFreqPrecision(TermFreqPrecision::QUANTIZED_8);
+    check(server.FindTopDocumentsBatch(execution::par, queries), find, "QUANTIZED_8"s);
+
+    try {
+        server.FindTopDocumentsBatch({"кот"s, "кот --пес"s});
+        ASSERT_HINT(false, "invalid query in a batch must throw"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestQueryTrace() {
+    // погрешность корзины не больше 1/16 значения, корзины идут подряд без пропусков
+    for (uint64_t value : {uint64_t{0}, uint64_t{15}, uint64_t{16}, uint64_t{17}, uint64_t{1000}, uint64_t{123456789}, UINT64_MAX}) {
+        const size_t index = LatencyHistogram::GetBucketIndex(value);
+        ASSERT_HINT(LatencyHistogram::GetBucketLowerBound(index) <= value && value <= LatencyHistogram::GetBucketUpperBound(index), to_string(value));
+        ASSERT_HINT(LatencyHistogram::GetBucketUpperBound(index) - LatencyHistogram::GetBucketLowerBound(index) <= value / 16, to_string(value));
+    }
+    for (size_t index = 1; index < LatencyHistogram::BUCKET_COUNT; ++index) {
+        ASSERT_EQUAL(LatencyHistogram::GetBucketLowerBound(index), LatencyHistogram::GetBucketUpperBound(index - 1) + 1);
+    }
+
+    LatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.Record(value * 1000);
+    }
+    LatencySnapshot latency;
+    latency.Add(histogram, 0);
+    ASSERT_EQUAL(latency.GetCount(), 1000u);
+    ASSERT_EQUAL(latency.GetMax(), 1'000'000u);
+    ASSERT_EQUAL(latency.GetPercentile(100), 1'000'000u);
+    ASSERT_EQUAL(latency.GetCountAtMost(1023), 1u);
+    for (const double percentile : {50.0, 90.0, 99.0}) {
+        const double expected = percentile * 10'000;
+        ASSERT_HINT(abs(latency.GetPercentile(percentile) - expected) <= expected / 16, to_string(percentile));
+    }
+
+    SearchServer server(""s);
+    server.AddDocument(1, "белый кот"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "черный пес"s, DocumentStatus::ACTUAL, {2});
+    ResetTraceHistograms();
+    server.FindTopDocuments("кот -пес"s);
+    server.FindTopDocuments(execution::par, "пес"s);
+    server.FindTopDocuments("+белый кот"s);
+    // гистограммы завершившегося потока остаются в снимке
+    thread([&server] {
+        server.FindTopDocuments("белый"s, SearchCursor(), 1);
+    }).join();
+
+    const TraceSnapshot snapshot = TakeTraceSnapshot();
+    const uint64_t expected_count = TRACING_ENABLED ? 4 : 0;
+    ASSERT_EQUAL(snapshot[TraceStage::QUERY].GetCount(), expected_count);
+    ASSERT_EQUAL(snapshot[TraceStage::PARSE].GetCount(), expected_count);
+    ASSERT_EQUAL(snapshot[TraceStage::SCORING].GetCount(), expected_count);
+    ASSERT_EQUAL(snapshot[TraceStage::TOP_K].GetCount(), expected_count);
+    // отдельный проход проверки есть только у пересечения обязательных слов
+    ASSERT_EQUAL(snapshot[TraceStage::FILTERING].GetCount(), TRACING_ENABLED ? 1u : 0u);
+    // собственное время запроса -- его длительность без вложенных этапов
+    const LatencySnapshot& query_latency = snapshot[TraceStage::QUERY];
+    uint64_t nested_sum = 0;
+    for (const TraceStage stage : {TraceStage::PARSE, TraceStage::TERM_LOOKUP, TraceStage::MINUS_EXCLUSION, TraceStage::SCORING, TraceStage::TOP_K}) {
+        nested_sum += snapshot[stage].GetSum();
+    }
+    ASSERT_EQUAL(query_latency.GetSelfSum() + nested_sum, query_latency.GetSum());
+
+    ostringstream prometheus;
+    WritePrometheusMetrics(prometheus, snapshot);
+    ASSERT(prometheus.str().find("# TYPE search_server_stage_duration_seconds histogram\n"s) != string::npos);
+    ASSERT(prometheus.str().find("search_server_stage_duration_seconds_count{stage=\"QUERY\"} "s + to_string(expected_count) + "\n"s) != string::npos);
+    ASSERT(prometheus.str().find("search_server_stage_duration_seconds_bucket{stage=\"TOP_K\",le=\"+Inf\"} "s + to_string(expected_count) + "\n"s) != string::npos);
+    ostringstream text;
+    PrintTraceSnapshot(text, snapshot);
+    ASSERT(text.str().find("\n    FILTERING: "s) != string::npos);
+
+    ResetTraceHistograms();
+    ASSERT_EQUAL(TakeTraceSnapshot()[TraceStage::QUERY].GetCount(), 0u);
+}
+
+void TestQueryProfile() {
+    SearchServer server("и в"s);
+    server.AddDocument(1, "пушистый кот и пушистый хвост"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(2, "ухоженный пес выразительные глаза"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(3, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {5});
+    server.AddDocument(4, "пушистый пес"s, DocumentStatus::BANNED, {1});
+    server.AddDocument(5, "кот скворец"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(6, "пушистый кот"s, DocumentStatus::ACTUAL, {2});
+    server.RemoveDocument(6);
+
+    // документ за документом проверяются все документы из списков плюс-слов: 1, 2, 3, 4, 5 и удаленный 6
+    server.SetQueryStrategy(QueryStrategy::DOCUMENT_AT_A_TIME);
+    QueryProfile profile;
+    const string query = "пушистый ухоженный кот -ошейник"s;
+    const auto documents = server.FindTopDocuments(query, profile);
+    const auto expected = server.FindTopDocuments(query);
+    ASSERT_EQUAL(documents.size(), expected.size());
+    ASSERT(profile.strategy == QueryStrategy::DOCUMENT_AT_A_TIME);
+    // плюс-слова -- в порядке разобранного запроса
+    ASSERT_EQUAL(profile.plus_terms.size(), 3u);
+    ASSERT_EQUAL(profile.plus_terms[1].word, "пушистый"s);
+    ASSERT_EQUAL(profile.plus_terms[1].posting_count, 3u);
+    ASSERT_EQUAL(profile.minus_terms.size(), 1u);
+    ASSERT_EQUAL(profile.minus_terms[0].posting_count, 1u);
+    ASSERT_EQUAL(profile.excluded_documents, 2u);
+    ASSERT_EQUAL(profile.predicate_calls, 4u);
+    ASSERT_EQUAL(profile.rejected_documents, 1u);
+    ASSERT_EQUAL(profile.found_document_count, 3u);
+    ASSERT_EQUAL(profile.metrics.scored_documents, 3u);
+    if (TRACING_ENABLED) {
+        const auto query_duration = profile.stage_durations[static_cast<size_t>(TraceStage::QUERY)];
+        ASSERT(query_duration.count() > 0);
+        ASSERT(query_duration >= profile.stage_durations[static_cast<size_t>(TraceStage::SCORING)]);
+    }
+
+    // вклады слов в порядке запроса складываются в релевантность до бита при любой стратегии и политике
+    const auto check_explanations = [](const vector<Document>& documents, const QueryProfile& profile, const string& hint) {
+        ASSERT_EQUAL_HINT(profile.explanations.size(), documents.size(), hint);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const DocumentExplanation& explanation = profile.explanations[i];
+            ASSERT_EQUAL_HINT(explanation.document_id, documents[i].id, hint);
+            double relevance = 0.0;
+            for (const TermContribution& contribution : explanation.contributions) {
+                relevance += contribution.score;
+            }
+            ASSERT_EQUAL_HINT(relevance, documents[i].relevance, hint);
+        }
+    };
+    check_explanations(documents, profile, "DOCUMENT_AT_A_TIME"s);
+    ASSERT_EQUAL(profile.explanations[0].document_id, 1);
+    ASSERT_EQUAL(profile.explanations[0].contributions.size(), 2u);
+    ASSERT_EQUAL(profile.explanations[0].contributions[1].word, "пушистый"s);
+    ASSERT_EQUAL(profile.explanations[0].contributions[1].term_freq, 0.5);
+
+    server.SetTermFreqPrecision(TermFreqPrecision::QUANTIZED_8);
+    for (const QueryStrategy strategy : {QueryStrategy::MAX_SCORE, QueryStrategy::BLOCK_MAX_WAND}) {
+        server.SetQueryStrategy(strategy);
+        const auto strategy_documents = server.FindTopDocuments<Bm25Scorer>(execution::seq, query, profile);
+        ASSERT(profile.strategy == strategy);
+        check_explanations(strategy_documents, profile, string(GetQueryStrategyName(strategy)));
+    }
+    server.SetQueryStrategy(nullopt);
+    const auto par_documents = server.FindTopDocuments(execution::par, query, [](int document_id, DocumentStatus, int) {
+        return document_id != 2;
+    }, profile);
+    check_explanations(par_documents, profile, "par"s);
+    ASSERT_EQUAL(profile.rejected_documents, 1u);
+    // параллельный обход считает те же показатели, что и последовательный обход слово за словом
+    const QueryPlannerMetrics par_metrics = profile.metrics;
+    ASSERT(profile.strategy == QueryStrategy::TERM_AT_A_TIME);
+    server.SetQueryStrategy(QueryStrategy::TERM_AT_A_TIME);
+    server.FindTopDocuments(execution::seq, query, [](int document_id, DocumentStatus, int) {
+        return document_id != 2;
+    }, profile);
+    server.SetQueryStrategy(nullopt);
+    ASSERT_EQUAL(par_metrics.term_at_a_time_queries, 1u);
+    ASSERT(par_metrics.scanned_postings > 0);
+    ASSERT_EQUAL(par_metrics.scanned_postings, profile.metrics.scanned_postings);
+    ASSERT_EQUAL(par_metrics.scored_documents, profile.metrics.scored_documents);
+
+    const auto conjunctive_documents = server.FindTopDocuments("+кот пушистый"s, profile);
+    ASSERT(profile.strategy == QueryStrategy::CONJUNCTIVE);
+    ASSERT_EQUAL(profile.required_words.size(), 1u);
+    ASSERT_EQUAL(profile.required_words[0], "кот"s);
+    check_explanations(conjunctive_documents, profile, "CONJUNCTIVE"s);
+}
+
+void TestMemoryStats() {
+    SearchServer server("и в на"s);
+    const auto check_total = [](const MemoryStats& stats) {
+        const MemoryUsage total = stats.GetTotal();
+        ASSERT_EQUAL(total.payload_bytes, stats.dictionary.payload_bytes + stats.postings.payload_bytes + stats.forward_index.payload_bytes
+            + stats.document_metadata.payload_bytes + stats.stop_words.payload_bytes);
+        ASSERT_EQUAL(total.GetTotalBytes(), total.payload_bytes + total.overhead_bytes);
+    };
+    const MemoryStats empty_stats = server.GetMemoryStats();
+    check_total(empty_stats);
+    ASSERT(empty_stats.stop_words.payload_bytes > 0);
+    ASSERT_EQUAL(empty_stats.dictionary.GetTotalBytes(), 0u);
+    ASSERT_EQUAL(empty_stats.postings.GetTotalBytes(), 0u);
+    ASSERT_EQUAL(empty_stats.forward_index.GetTotalBytes(), 0u);
+
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, "кот и пес w"s + to_string(id % 10) + " u"s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    const MemoryStats stats = server.GetMemoryStats();
+    check_total(stats);
+    // прямой индекс: смещение и число слов документа и по номеру и частоте на слово документа
+    size_t entry_count = 0;
+    for (const int document_id : server) {
+        entry_count += server.GetWordFrequencies(document_id).size();
+    }
+    ASSERT_EQUAL(entry_count, 400u);
+    ASSERT_EQUAL(stats.forward_index.payload_bytes, 100 * (sizeof(size_t) + sizeof(uint32_t)) + entry_count * (sizeof(int) + sizeof(double)));
+    ASSERT(stats.document_metadata.payload_bytes > 100 * (sizeof(int) * 3 + sizeof(double)));
+    // кот, пес, w0..w9 и u0..u99: короткие слова целиком лежат в объектах строк; на каждое слово -- элемент
+    // таблиц слов и их списков документов по номерам
+    ASSERT_EQUAL(stats.dictionary.payload_bytes, 112 * (sizeof(pmr::string) + sizeof(string_view) + sizeof(void*)));
+    ASSERT(stats.postings.payload_bytes > entry_count * (sizeof(int) + sizeof(double)));
+
+    SearchServer long_word_server(server);
+    const MemoryStats copy_stats = long_word_server.GetMemoryStats();
+    ASSERT_EQUAL(copy_stats.dictionary.payload_bytes, stats.dictionary.payload_bytes);
+    ASSERT_EQUAL(copy_stats.postings.payload_bytes, stats.postings.payload_bytes);
+    ASSERT_HINT(copy_stats.postings.overhead_bytes <= stats.postings.overhead_bytes, "Copy must not have more spare capacity"s);
+    // длинное слово хранится вне объекта строки
+    const string long_word(40, 'x');
+    long_word_server.AddDocument(100, long_word, DocumentStatus::ACTUAL, {});
+    ASSERT_EQUAL(long_word_server.GetMemoryStats().dictionary.payload_bytes - copy_stats.dictionary.payload_bytes,
+                 sizeof(pmr::string) + sizeof(string_view) + sizeof(void*) + long_word.size());
+
+    // 8-битные частоты: байт вместо восьми на каждый элемент списков документов
+    SearchServer quantized_server(server);
+    quantized_server.SetTermFreqPrecision(TermFreqPrecision::QUANTIZED_8);
+    ASSERT_EQUAL(stats.postings.payload_bytes - quantized_server.GetMemoryStats().postings.payload_bytes, entry_count * (sizeof(double) - 1));
+
+    // бюджет: документы отклоняются, не меняя сервер, пока удаление с уплотнением не освободит место
+    SearchServer budget_server(server);
+    budget_server.SetMemoryBudget(budget_server.GetMemoryStats().GetTotal().GetTotalBytes() + 20'000);
+    ASSERT_EQUAL(budget_server.GetMemoryBudget(), budget_server.GetMemoryStats().GetTotal().GetTotalBytes() + 20'000);
+    int next_id = 100;
+    bool is_rejected = false;
+    while (!is_rejected) {
+        const int document_count = budget_server.GetDocumentCount();
+        try {
+            budget_server.AddDocument(next_id, "кот w"s + to_string(next_id) + " v"s + to_string(next_id), DocumentStatus::ACTUAL, {});
+            ++next_id;
+        } catch (const length_error&) {
+            is_rejected = true;
+            ASSERT_EQUAL(budget_server.GetDocumentCount(), document_count);
+        }
+        ASSERT_HINT(next_id < 1000, "Memory budget must reject documents"s);
+    }
+    ASSERT(next_id > 100);
+    try {
+        budget_server.UpdateDocument(0, "кот w0 v1 v2 v3 v4 v5 v6 v7 v8 v9"s);
+        ASSERT_HINT(false, "Update over memory budget must be rejected"s);
+    } catch (const length_error&) {
+    }
+    ASSERT_EQUAL(budget_server.GetWordFrequencies(0).size(), 4u);
+    // 20% удаленных документов не запускают уплотнение сами, его запускает бюджет
+    vector<int> removed_ids;
+    for (int id = 0; id < budget_server.GetDocumentCount() / 5; ++id) {
+        removed_ids.push_back(id);
+    }
+    budget_server.RemoveDocuments(removed_ids);
+    const size_t removed_total = budget_server.GetMemoryStats().GetTotal().GetTotalBytes();
+    budget_server.AddDocument(next_id, "кот w"s + to_string(next_id), DocumentStatus::ACTUAL, {});
+    ASSERT(budget_server.GetMemoryStats().GetTotal().GetTotalBytes() < removed_total);
+    ASSERT_EQUAL(budget_server.FindTopDocuments("w"s + to_string(next_id)).size(), 1u);
+    budget_server.SetMemoryBudget(0);
+    budget_server.AddDocument(next_id + 1, "кот"s, DocumentStatus::ACTUAL, {});
+}
+
+void TestForwardIndex() {
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(3, "хвост кот пушистый пушистый"s, DocumentStatus::BANNED, {9});
+
+    const auto word_freqs = server.GetWordFrequencies(1);
+    ASSERT_EQUAL(word_freqs.size(), 3u);
+    ASSERT_EQUAL(word_freqs.count("пушистый"s), 1u);
+    ASSERT_EQUAL(word_freqs.count("белый"s), 0u);
+    ASSERT(word_freqs.find("белый"s) == word_freqs.end());
+    ASSERT_EQUAL((*word_freqs.find("хвост"s)).second, 0.25);
+    try {
+        word_freqs.at("белый"s);
+        ASSERT_HINT(false, "Missing word must throw"s);
+    } catch (const out_of_range&) {
+    }
+    // слова перечисляются в порядке номеров, поэтому одинаковые документы перечисляются одинаково
+    ASSERT(word_freqs == server.GetWordFrequencies(3));
+    ASSERT(equal(word_freqs.begin(), word_freqs.end(), server.GetWordFrequencies(3).begin()));
+    ASSERT(word_freqs != server.GetWordFrequencies(0));
+    ASSERT(server.GetWordFrequencies(100).empty());
+    // слово, которого нет в словаре, и каждое слово документа по его частоте
+    ASSERT_EQUAL(word_freqs.count("жираф"s), 0u);
+    ASSERT_EQUAL(server.GetWordFrequencies(100).count("кот"s), 0u);
+    for (const auto& [word, term_freq] : server.GetWordFrequencies(2)) {
+        ASSERT_EQUAL(server.GetWordFrequencies(2).at(word), term_freq);
+    }
+    // у другого сервера слова получают другие номера, но одинаковые документы равны
+    {
+        SearchServer reordered("и в на"s);
+        reordered.AddDocument(3, "хвост кот пушистый пушистый"s, DocumentStatus::ACTUAL, {9});
+        reordered.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, {8});
+        ASSERT(reordered.GetWordFrequencies(3) == word_freqs);
+        ASSERT(reordered.GetWordFrequencies(0) == server.GetWordFrequencies(0));
+        ASSERT(reordered.GetWordFrequencies(0) != word_freqs);
+    }
+
+    // повторные изменения оставляют в прямом индексе прежние слова, пока он не уплотнится
+    for (int i = 0; i < 100; ++i) {
+        server.UpdateDocument(2, "пёс глаза w"s + to_string(i) + (i % 2 == 0 ? " длинный хвост пса"s : ""s));
+        const auto updated_freqs = server.GetWordFrequencies(2);
+        ASSERT_EQUAL(updated_freqs.size(), i % 2 == 0 ? 6u : 3u);
+        ASSERT_EQUAL(updated_freqs.count("w"s + to_string(i)), 1u);
+        ASSERT_EQUAL(updated_freqs.count("выразительные"s), 0u);
+    }
+    // без уплотнения добавились бы 300 элементов
+    ASSERT(server.GetMemoryStats().forward_index.GetTotalBytes() < 100 * (sizeof(int) + sizeof(double)));
+    ASSERT_EQUAL(server.GetWordFrequencies(1).size(), 3u);
+
+    // сервер без прямого индекса отвечает так же
+    SearchServer without_index(server);
+    without_index.SetForwardIndex(false);
+    ASSERT(!without_index.HasForwardIndex());
+    ASSERT_EQUAL(without_index.GetMemoryStats().forward_index.GetTotalBytes(), 0u);
+    try {
+        without_index.GetWordFrequencies(1);
+        ASSERT_HINT(false, "Word frequencies require the forward index"s);
+    } catch (const logic_error&) {
+    }
+    for (SearchServer* target : {&server, &without_index}) {
+        target->UpdateDocument(0, "белый кот и модный хвост"s);
+        target->RemoveDocument(3);
+        target->AddDocument(4, "модный пёс"s, DocumentStatus::ACTUAL, {1});
+    }
+    for (const string& query : {"кот хвост"s, "пушистый -белый"s, "модный +пёс"s, "w99 глаза"s}) {
+        for (const int document_id : server) {
+            ASSERT(server.MatchDocument(query, document_id) == without_index.MatchDocument(query, document_id));
+            ASSERT(server.MatchDocument(execution::par, query, document_id) == without_index.MatchDocument(execution::par, query, document_id));
+        }
+        const auto expected = server.FindTopDocuments(query);
+        const auto result = without_index.FindTopDocuments(query);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+            ASSERT_EQUAL(result[i].relevance, expected[i].relevance);
+        }
+    }
+    without_index.Compact();
+    ASSERT(without_index.FindTopDocuments("ошейник"s).empty());
+    // включение строит индекс по спискам документов
+    without_index.SetForwardIndex(true);
+    for (const int document_id : server) {
+        ASSERT(server.GetWordFrequencies(document_id) == without_index.GetWordFrequencies(document_id));
+    }
+
+    // слова копии ссылаются на ее собственный словарь
+    auto original = make_unique<SearchServer>(server);
+    const SearchServer copy(*original);
+    original.reset();
+    ASSERT(copy.GetWordFrequencies(1) == server.GetWordFrequencies(1));
+    ASSERT_EQUAL(copy.GetWordFrequencies(0).at("хвост"s), 0.25);
+}
+
+void TestDiskIndex() {
+    SearchServer server("и в на"s);
+    // частые слова занимают несколько блоков на диске
+    for (int id = 0; id < 1000; ++id) {
+        string text = "кот"s;
+        if (id % 2 == 0) {
+            text += " и пушистый"s;
+        }
+        if (id % 3 == 0) {
+            text += " хвост хвост"s;
+        }
+        if (id % 7 == 0) {
+            text += " ошейник"s;
+        }
+        text += " w"s + to_string(id % 50);
+        const DocumentStatus status = id % 11 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id * 2, text, status, {id % 13, 1});
+    }
+    for (int id = 0; id < 100; ++id) {
+        server.RemoveDocument(id * 6);
+    }
+    const string path = (filesystem::temp_directory_path() / "search_server_test.index"s).string();
+    server.WriteDiskIndex(path);
+
+    DiskSearchOptions options;
+    options.cache_bytes = 4 * DISK_POSTING_BLOCK_SIZE * (sizeof(double) + sizeof(int));
+    options.prefetch_blocks = 2;
+    const DiskSearchServer disk_server(path, options);
+    ASSERT_EQUAL(disk_server.GetDocumentCount(), server.GetDocumentCount());
+    const auto check_equal = [](const vector<Document>& result, const vector<Document>& expected) {
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+            ASSERT_EQUAL(result[i].rating, expected[i].rating);
+            ASSERT_EQUAL(result[i].relevance, expected[i].relevance);
+        }
+    };
+    for (const string& query : {"кот"s, "пушистый хвост"s, "хвост -пушистый"s, "+ошейник пушистый w7"s, "+хвост +ошейник -w3"s,
+                                "кот и на"s, "белый"s, "+белый кот"s, "w1 w2 w3 -кот"s}) {
+        check_equal(disk_server.FindTopDocuments(query), server.FindTopDocuments(query));
+        check_equal(disk_server.FindTopDocuments(query, DocumentStatus::BANNED), server.FindTopDocuments(query, DocumentStatus::BANNED));
+        check_equal(disk_server.FindTopDocuments<Bm25Scorer>(query), server.FindTopDocuments<Bm25Scorer>(query));
+        const auto predicate = [](int document_id, DocumentStatus, int rating) {
+            return document_id % 3 == 0 && rating > 5;
+        };
+        check_equal(disk_server.FindTopDocuments(query, predicate), server.FindTopDocuments(query, predicate));
+    }
+    try {
+        disk_server.FindTopDocuments("кот --хвост"s);
+        ASSERT_HINT(false, "Invalid query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // кэш меньше списков: блоки вытесняются и читаются с упреждением, но память кэша не растет
+    const PostingCacheStats stats = disk_server.GetCacheStats();
+    ASSERT(stats.misses > 0 && stats.hits > 0);
+    ASSERT(stats.evictions > 0);
+    ASSERT(stats.prefetched_blocks > 0 && stats.prefetch_hits > 0);
+    ASSERT(stats.read_count <= stats.misses);
+    ASSERT_EQUAL(stats.read_bytes % (sizeof(double) + sizeof(int)), 0u);
+    const MemoryStats memory_stats = disk_server.GetMemoryStats();
+    ASSERT(memory_stats.postings.payload_bytes <= options.cache_bytes);
+    ASSERT_EQUAL(memory_stats.forward_index.GetTotalBytes(), 0u);
+    ASSERT(memory_stats.dictionary.payload_bytes > 0);
+
+    // повторный запрос с прогретым большим кэшем не читает диск
+    DiskSearchServer warm_server(path);
+    warm_server.FindTopDocuments("кот пушистый"s);
+    const size_t read_count = warm_server.GetCacheStats().read_count;
+    warm_server.FindTopDocuments("кот пушистый"s);
+    ASSERT_EQUAL(warm_server.GetCacheStats().read_count, read_count);
+    ASSERT(warm_server.GetCacheStats().GetHitRate() > 0.0);
+    warm_server.ClearCache();
+    ASSERT_EQUAL(warm_server.GetCacheStats().hits, 0u);
+    ASSERT_EQUAL(warm_server.GetMemoryStats().postings.payload_bytes, 0u);
+
+    // потоки читают блоки одновременно и ждут блоков, которые читают другие потоки; выдача не меняется
+    {
+        const DiskSearchServer shared_server(path, options);
+        const vector<string> queries = {"кот"s, "пушистый хвост"s, "+хвост +ошейник -w3"s, "w1 w2 w3 -кот"s, "кот ошейник"s};
+        vector<vector<Document>> expected;
+        for (const string& query : queries) {
+            expected.push_back(server.FindTopDocuments(query));
+        }
+        vector<thread> threads;
+        for (size_t i = 0; i < 4; ++i) {
+            threads.emplace_back([&, i] {
+                for (size_t round = 0; round < 20; ++round) {
+                    const size_t query = (i + round) % queries.size();
+                    check_equal(shared_server.FindTopDocuments(queries[query]), expected[query]);
+                }
+            });
+        }
+        for (thread& worker : threads) {
+            worker.join();
+        }
+    }
+
+    // порядковые номера в словаре и в блоках проверяются: испорченный индекс не читает чужую память
+    {
+        SearchServer small_server(""s);
+        small_server.AddDocument(1, "кот"s, DocumentStatus::ACTUAL, {1});
+        small_server.AddDocument(2, "кот пёс"s, DocumentStatus::ACTUAL, {1});
+        const auto write_int = [&path](streamoff position, int value) {
+            fstream file(path, ios::binary | ios::in | ios::out);
+            file.seekp(position, position < 0 ? ios::end : ios::beg);
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+        // последний номер блока слова "пёс" -- перед смещением сведений и сигнатурой в конце файла
+        small_server.WriteDiskIndex(path);
+        write_int(-20, 2);
+        try {
+            DiskSearchServer broken_server(path);
+            ASSERT_HINT(false, "Block ordinal beyond document count must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+        // номера первого блока слова "кот" -- после заголовка и двух частот
+        small_server.WriteDiskIndex(path);
+        write_int(16 + 2 * sizeof(double), 5);
+        const DiskSearchServer broken_server(path);
+        ASSERT_EQUAL(broken_server.FindTopDocuments("пёс"s).size(), 1u);
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            try {
+                broken_server.FindTopDocuments("кот"s);
+                ASSERT_HINT(false, "Broken posting block must be rejected"s);
+            } catch (const invalid_argument&) {
+            }
+        }
+    }
+
+    {
+        ofstream broken(path, ios::binary | ios::trunc);
+        broken << "not an index"s;
+    }
+    try {
+        DiskSearchServer broken_server(path);
+        ASSERT_HINT(false, "Broken index must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    filesystem::remove(path);
+}
+
 // точка входа для запуска тестов
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -243,5 +1889,28 @@ void TestSearchServer() {
     RUN_TEST(TestRequestQueue1);
     RUN_TEST(TestGetWordFrequencies);
     RUN_TEST(TestRemoveDocument);
+    RUN_TEST(TestFuzzySearch);
+    RUN_TEST(TestBm25Ranking);
+    RUN_TEST(TestDocumentIdsAfterRemoval);
+    RUN_TEST(TestMemoryResource);
+    RUN_TEST(TestRequiredWords);
+    RUN_TEST(TestMinusWordsExclusion);
+    RUN_TEST(TestSearchAfterPagination);
+    RUN_TEST(TestMatchDocumentsBatch);
+    RUN_TEST(TestTombstoneRemoval);
+    RUN_TEST(TestUpdateDocument);
+    RUN_TEST(TestQueryProtocol);
+    RUN_TEST(TestCorpusLoader);
+    RUN_TEST(TestStopWordSet);
+    RUN_TEST(TestQueryPlanner);
+    RUN_TEST(TestImpactOrdering);
+    RUN_TEST(TestTermFreqPrecision);
+    RUN_TEST(TestRankingKey);
+    RUN_TEST(TestBatchQueries);
+    RUN_TEST(TestQueryTrace);
+    RUN_TEST(TestQueryProfile);
+    RUN_TEST(TestMemoryStats);
+    RUN_TEST(TestForwardIndex);
+    RUN_TEST(TestDiskIndex);
     cout << "Search server testing finished"s << endl << endl;
 }
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "corpus_loader.h"
+#include "disk_index.h"
 #include "search_server.h"
 #include "process_queries.h"
+#include "query_protocol.h"
+#include "query_trace.h"
 #include "request_queue.h"
 
 #include <iostream>
@@ -53,6 +57,29 @@ void TestPagination();
 void TestRequestQueue1();
 void TestGetWordFrequencies();
 void TestRemoveDocument();
+void TestFuzzySearch();
+void TestBm25Ranking();
+void TestDocumentIdsAfterRemoval();
+void TestMemoryResource();
+void TestRequiredWords();
+void TestMinusWordsExclusion();
+void TestSearchAfterPagination();
+void TestMatchDocumentsBatch();
+void TestTombstoneRemoval();
+void TestUpdateDocument();
+void TestQueryProtocol();
+void TestCorpusLoader();
+void TestStopWordSet();
+void TestQueryPlanner();
+void TestImpactOrdering();
+void TestTermFreqPrecision();
+void TestRankingKey();
+void TestBatchQueries();
+void TestQueryTrace();
+void TestQueryProfile();
+void TestMemoryStats();
+void TestForwardIndex();
+void TestDiskIndex();
 
 // точка входа
 void TestSearchServer();
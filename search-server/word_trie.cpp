@@ -0,0 +1,170 @@
+#include "word_trie.h"
+
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace std;
+
+WordTrie::WordTrie(bool is_reversed)
+    : is_reversed_(is_reversed) {
+}
+
+void WordTrie::Build(const vector<pair<string_view, int>>& words) {
+    vector<pair<u32string, int>> symbol_words;
+    symbol_words.reserve(words.size());
+    for (const auto& [word, word_id] : words) {
+        symbol_words.emplace_back(GetSymbols(word), word_id);
+    }
+    Build(move(symbol_words));
+}
+
+// слова упорядочиваются по символам, поэтому слова с общим префиксом образуют отрезок: дети узла -- это
+// отрезки слов с одинаковым следующим символом; дети каждого узла добавляются разом, а узлы обходятся в глубину,
+// поэтому поддерево узла ложится в массив сразу за детьми его левых братьев
+void WordTrie::Build(vector<pair<u32string, int>> words) {
+    Clear();
+    // для правильного UTF-8 порядок байтов совпадает с порядком символов, и упорядоченный словарь
+    // сортировать не нужно
+    if (!is_sorted(words.begin(), words.end())) {
+        sort(words.begin(), words.end());
+    }
+    word_count_ = words.size();
+    // узел, отрезок его слов и длина его префикса
+    struct PendingNode {
+        uint32_t node;
+        size_t begin;
+        size_t end;
+        size_t depth;
+    };
+    nodes_.push_back(Node{});
+    vector<PendingNode> pending = {{0, 0, words.size(), 0}};
+    while (!pending.empty()) {
+        const PendingNode current = pending.back();
+        pending.pop_back();
+        size_t begin = current.begin;
+        // слово, равное префиксу, идет первым в отрезке
+        if (begin < current.end && words[begin].first.size() == current.depth) {
+            nodes_[current.node].word_id = words[begin].second;
+            ++begin;
+        }
+        nodes_[current.node].first_child = static_cast<uint32_t>(nodes_.size());
+        while (begin < current.end) {
+            const char32_t label = words[begin].first[current.depth];
+            size_t end = begin + 1;
+            while (end < current.end && words[end].first[current.depth] == label) {
+                ++end;
+            }
+            pending.push_back({static_cast<uint32_t>(nodes_.size()), begin, end, current.depth + 1});
+            nodes_.push_back(Node{label, -1, 0, 0});
+            begin = end;
+        }
+        nodes_[current.node].child_count = static_cast<uint32_t>(nodes_.size()) - nodes_[current.node].first_child;
+        // первым обходится первый ребенок
+        reverse(pending.end() - nodes_[current.node].child_count, pending.end());
+    }
+}
+
+void WordTrie::Clear() {
+    nodes_.clear();
+    word_count_ = 0;
+    stale_count_ = 0;
+}
+
+void WordTrie::Insert(const string_view word, int word_id) {
+    if (nodes_.empty()) {
+        nodes_.push_back(Node{});
+    }
+    uint32_t node = 0;
+    for (const char32_t symbol : GetSymbols(word)) {
+        if (const uint32_t child = FindChild(node, symbol); child != NO_NODE) {
+            node = child;
+            continue;
+        }
+        const uint32_t first_child = nodes_[node].first_child;
+        const uint32_t child_count = nodes_[node].child_count;
+        const uint32_t position = static_cast<uint32_t>(partition_point(nodes_.begin() + first_child, nodes_.begin() + first_child + child_count, [symbol](const Node& child) {
+            return child.label < symbol;
+        }) - nodes_.begin()) - first_child;
+        if (child_count == 0 || first_child + child_count != nodes_.size()) {
+            // дети переносятся в конец массива, где за ними есть место для нового ребенка
+            const uint32_t new_first_child = static_cast<uint32_t>(nodes_.size());
+            for (uint32_t i = 0; i < child_count; ++i) {
+                nodes_.push_back(nodes_[first_child + i]);
+            }
+            nodes_[node].first_child = new_first_child;
+            stale_count_ += child_count;
+        }
+        // дети детей не переносятся, поэтому ссылки на них остаются верными
+        const auto child_it = nodes_.insert(nodes_.begin() + nodes_[node].first_child + position, Node{symbol, -1, 0, 0});
+        ++nodes_[node].child_count;
+        node = static_cast<uint32_t>(child_it - nodes_.begin());
+    }
+    if (nodes_[node].word_id < 0) {
+        ++word_count_;
+    }
+    nodes_[node].word_id = word_id;
+    if (stale_count_ > nodes_.size() / 2) {
+        Rebuild();
+    }
+}
+
+void WordTrie::Erase(const string_view word) {
+    uint32_t node = nodes_.empty() ? NO_NODE : 0;
+    for (const char32_t symbol : GetSymbols(word)) {
+        if (node == NO_NODE) {
+            break;
+        }
+        node = FindChild(node, symbol);
+    }
+    if (node == NO_NODE || nodes_[node].word_id < 0) {
+        return;
+    }
+    nodes_[node].word_id = -1;
+    --word_count_;
+    ++stale_count_;
+    if (stale_count_ > nodes_.size() / 2) {
+        Rebuild();
+    }
+}
+
+u32string WordTrie::GetSymbols(const string_view word) const {
+    u32string symbols = DecodeUtf8String(word);
+    if (is_reversed_) {
+        reverse(symbols.begin(), symbols.end());
+    }
+    return symbols;
+}
+
+uint32_t WordTrie::FindChild(uint32_t node, char32_t label) const {
+    const auto begin = nodes_.begin() + nodes_[node].first_child;
+    const auto end = begin + nodes_[node].child_count;
+    const auto it = partition_point(begin, end, [label](const Node& child) {
+        return child.label < label;
+    });
+    return it != end && it->label == label ? static_cast<uint32_t>(it - nodes_.begin()) : NO_NODE;
+}
+
+// оставшиеся слова перекладываются в новое дерево без пустых узлов; обход в глубину от первого ребенка
+// выдает слова уже упорядоченными
+void WordTrie::Rebuild() {
+    vector<pair<u32string, int>> words;
+    words.reserve(word_count_);
+    vector<pair<uint32_t, u32string>> pending = {{0, u32string()}};
+    while (!pending.empty()) {
+        const auto [node, symbols] = move(pending.back());
+        pending.pop_back();
+        if (nodes_[node].word_id >= 0) {
+            words.emplace_back(symbols, nodes_[node].word_id);
+        }
+        for (uint32_t child = nodes_[node].first_child + nodes_[node].child_count; child-- > nodes_[node].first_child;) {
+            pending.emplace_back(child, symbols + nodes_[child].label);
+        }
+    }
+    Build(move(words));
+}
+
+MemoryUsage WordTrie::GetMemoryStats() const {
+    return GetVectorMemoryUsage(nodes_);
+}
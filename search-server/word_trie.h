@@ -0,0 +1,100 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// префиксное дерево слов по символам Unicode, уложенное в массив: дети каждого узла идут подряд по возрастанию
+// символов, а после построения поддерево каждого узла занимает отрезок массива, так что обход поддерева
+// читает соседнюю память
+// дерево хранит не сами слова, а их номера, выданные вызывающим (например, номера слов словаря)
+class WordTrie {
+public:
+    // is_reversed -- дерево строится по символам слов от конца к началу
+    explicit WordTrie(bool is_reversed = false);
+
+    // words -- слова без повторов в любом порядке и их номера, неотрицательные
+    void Build(const std::vector<std::pair<std::string_view, int>>& words);
+    void Clear();
+
+    // добавляет слово: дети узла, получившего нового ребенка, переносятся в конец массива, а прежнее место
+    // остается пустым; когда пустых узлов становится много, дерево перестраивается
+    void Insert(std::string_view word, int word_id);
+    // убирает слово, если оно есть в дереве; узлы слова остаются до перестроения
+    void Erase(std::string_view word);
+
+    // обходит слова, которые принимает автомат (см. LevenshteinAutomaton), и для каждого вызывает
+    // callback(word_id, state) с состоянием автомата после слова; поддерево, из которого автомат не может дойти
+    // до допускающего состояния, пропускается целиком -- за один переход по символу его корня
+    // если из состояния дальше ведут только символы исходного слова, дети узла не перебираются, а ищутся
+    // по этим символам двоичным поиском
+    template <typename Automaton, typename Callback>
+    void FindMatches(Automaton& automaton, Callback callback) const;
+
+    MemoryUsage GetMemoryStats() const;
+
+private:
+    // поля узла лежат вместе: обход читает их для каждого ребенка
+    struct Node {
+        // символ, по которому в узел ведет ребро; у корня не используется
+        char32_t label = 0;
+        // номер слова, которое кончается в узле, или -1
+        int word_id = -1;
+        // дети узла: child_count узлов начиная с first_child
+        uint32_t first_child = 0;
+        uint32_t child_count = 0;
+    };
+
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+    std::u32string GetSymbols(std::string_view word) const;
+    void Build(std::vector<std::pair<std::u32string, int>> words);
+    // ребенок узла node по символу label или NO_NODE
+    uint32_t FindChild(uint32_t node, char32_t label) const;
+    void Rebuild();
+
+    bool is_reversed_;
+    std::vector<Node> nodes_;
+    size_t word_count_ = 0;
+    // узлы, оставшиеся от перенесенных детей, и узлы убранных слов: их обход и память тратятся впустую
+    size_t stale_count_ = 0;
+};
+
+template <typename Automaton, typename Callback>
+void WordTrie::FindMatches(Automaton& automaton, Callback callback) const {
+    if (nodes_.empty()) {
+        return;
+    }
+    const auto& alphabet = automaton.GetAlphabet();
+    // узлы, которые еще предстоит обойти, с состояниями автомата после их префиксов
+    std::vector<std::pair<uint32_t, typename Automaton::State>> pending = {{0, automaton.Start()}};
+    const auto visit = [&](uint32_t child, typename Automaton::State state) {
+        const auto next_state = automaton.Step(state, nodes_[child].label);
+        if (automaton.CanMatch(next_state)) {
+            pending.emplace_back(child, next_state);
+        }
+    };
+    while (!pending.empty()) {
+        const auto [node, state] = pending.back();
+        pending.pop_back();
+        const Node& current = nodes_[node];
+        if (current.word_id >= 0 && automaton.IsMatch(state)) {
+            callback(current.word_id, state);
+        }
+        if (current.child_count > alphabet.size() && !automaton.CanMatchOtherSymbols(state)) {
+            for (const char32_t symbol : alphabet) {
+                if (const uint32_t child = FindChild(node, symbol); child != NO_NODE) {
+                    visit(child, state);
+                }
+            }
+        } else {
+            for (uint32_t child = current.first_child; child < current.first_child + current.child_count; ++child) {
+                visit(child, state);
+            }
+        }
+    }
+}